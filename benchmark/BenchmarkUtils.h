@@ -0,0 +1,73 @@
+//===- BenchmarkUtils.h - Shared benchmark driver helpers -------*- C++ -*-===//
+//
+// Declares the pieces the benchmark drivers have in common: the setup of LLVM
+// and the command line, the -repeat option, and the timing of the runs.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef CIRCT_BENCHMARK_BENCHMARKUTILS_H
+#define CIRCT_BENCHMARK_BENCHMARKUTILS_H
+
+#include "circt/Support/LLVM.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/InitLLVM.h"
+#include <algorithm>
+#include <chrono>
+
+namespace circt {
+namespace benchmark {
+
+/// Sets up LLVM and parses the command line of a benchmark.  It has to live as
+/// long as the main function, like InitLLVM.
+class InitBenchmark {
+public:
+  InitBenchmark(int &argc, char **&argv, StringRef overview)
+      : initLLVM(argc, argv) {
+    llvm::cl::ParseCommandLineOptions(argc, argv, overview);
+  }
+
+private:
+  llvm::InitLLVM initLLVM;
+};
+
+/// The -repeat option of a benchmark, the number of timed runs of which the
+/// best time is reported.
+class RepeatOption : public llvm::cl::opt<unsigned> {
+public:
+  explicit RepeatOption(unsigned defaultValue)
+      : llvm::cl::opt<unsigned>(
+            "repeat",
+            llvm::cl::desc("number of timed runs, the best time is reported"),
+            llvm::cl::init(defaultValue)) {}
+};
+
+/// Return the wall time of calling `fn` in seconds, or None if it returned
+/// false.
+template <typename FnT>
+Optional<double> timeRun(FnT &&fn) {
+  auto start = std::chrono::steady_clock::now();
+  if (!fn())
+    return None;
+  std::chrono::duration<double> time = std::chrono::steady_clock::now() - start;
+  return time.count();
+}
+
+/// Call `fn` with the index of each of the given number of runs, at least one,
+/// and return the best wall time in seconds, or None if a run returned false.
+template <typename FnT>
+Optional<double> timeBestRun(unsigned numRepeats, FnT &&fn) {
+  double best = 0;
+  for (unsigned i = 0, e = std::max(numRepeats, 1u); i != e; ++i) {
+    auto time = timeRun([&] { return fn(i); });
+    if (!time)
+      return None;
+    if (i == 0 || *time < best)
+      best = *time;
+  }
+  return best;
+}
+
+} // namespace benchmark
+} // namespace circt
+
+#endif // CIRCT_BENCHMARK_BENCHMARKUTILS_H
@@ -0,0 +1,120 @@
+//===- verilog-mux-bench.cpp - Verilog emitter mux tree benchmark ---------===//
+//
+// Generates modules with long chains of single-use muxes, which the Verilog
+// emitter inlines into a single expression unless it exceeds the expression
+// limits of the emitter options.  The modules are emitted with the default
+// limits and with the given ones, and the time and the length of the longest
+// emitted line are reported.
+//
+// Usage:
+//   verilog-mux-bench [--modules=100] [--chain=2000] [--repeat=3]
+//                     [--max-expr-size=0] [--max-expr-depth=0]
+//
+//===----------------------------------------------------------------------===//
+
+#include "BenchmarkUtils.h"
+#include "circt/Dialect/FIRRTL/Dialect.h"
+#include "circt/EmitVerilog.h"
+#include "circt/FIRParser.h"
+#include "mlir/IR/MLIRContext.h"
+#include "mlir/IR/Module.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace llvm;
+using namespace circt;
+
+static cl::opt<unsigned> numModules("modules",
+                                    cl::desc("number of generated modules"),
+                                    cl::init(100));
+static cl::opt<unsigned>
+    chainLength("chain", cl::desc("number of muxes in the chain of a module"),
+                cl::init(2000));
+static benchmark::RepeatOption numRepeats(3);
+static cl::opt<unsigned>
+    maxExprSize("max-expr-size",
+                cl::desc("expression size limit to compare the default "
+                         "limits with, or 0 for no limit"),
+                cl::init(0));
+static cl::opt<unsigned>
+    maxExprDepth("max-expr-depth",
+                 cl::desc("expression depth limit to compare the default "
+                          "limits with, or 0 for no limit"),
+                 cl::init(0));
+
+/// Generate modules with a chain of muxes.  The parser drops the `_T_n` names
+/// of the nodes, so the chain is a single expression.
+static std::string generateCircuit() {
+  unsigned modules = numModules, chain = chainLength;
+  std::string result;
+  raw_string_ostream os(result);
+  os << "circuit M0 :\n";
+  for (unsigned m = 0; m < modules; ++m) {
+    os << "  module M" << m << " :\n"
+       << "    input sel : UInt<4>\n"
+       << "    input in : UInt<8>\n"
+       << "    output out : UInt<8>\n\n"
+       << "    node _T_0 = mux(bits(sel, 0, 0), in, UInt<8>(0))\n";
+    for (unsigned n = 1; n < chain; ++n)
+      os << "    node _T_" << n << " = mux(bits(sel, " << n % 4 << ", "
+         << n % 4 << "), UInt<8>(" << n % 256 << "), _T_" << n - 1 << ")\n";
+    os << "    out <= _T_" << chain - 1 << "\n\n";
+  }
+  return os.str();
+}
+
+/// Return the length of the longest line of the text.
+static size_t getLongestLine(StringRef text) {
+  size_t longest = 0;
+  while (!text.empty()) {
+    auto line = text.split('\n');
+    longest = std::max(longest, line.first.size());
+    text = line.second;
+  }
+  return longest;
+}
+
+int main(int argc, char **argv) {
+  benchmark::InitBenchmark init(argc, argv,
+                                "Verilog emitter mux tree benchmark\n");
+
+  mlir::MLIRContext context;
+  context.loadDialect<firrtl::FIRRTLDialect>();
+
+  SourceMgr sourceMgr;
+  sourceMgr.AddNewSourceBuffer(
+      MemoryBuffer::getMemBufferCopy(generateCircuit(), "bench.fir"), SMLoc());
+  auto module = parseFIRFile(sourceMgr, &context, FIRParserOptions());
+  if (!module)
+    return 1;
+
+  // Emit the modules with the specified options, reporting the best time.
+  auto run = [&](StringRef name, VerilogEmitterOptions options) {
+    std::string verilog;
+    auto best = benchmark::timeBestRun(numRepeats, [&](unsigned) {
+      verilog.clear();
+      raw_string_ostream os(verilog);
+      if (failed(emitVerilog(module.get(), os, options)))
+        return false;
+      os.flush();
+      return true;
+    });
+    if (!best)
+      return false;
+    outs() << name << format("%.3f", *best) << " s, "
+           << format("%.1f", verilog.size() / 1e6) << " MB, longest line "
+           << getLongestLine(verilog) << " bytes\n";
+    return true;
+  };
+
+  VerilogEmitterOptions limited;
+  limited.maxExpressionSize = maxExprSize;
+  limited.maxExpressionDepth = maxExprDepth;
+  if (!run("default limits: ", VerilogEmitterOptions()) ||
+      !run("given limits:   ", limited))
+    return 1;
+  return 0;
+}
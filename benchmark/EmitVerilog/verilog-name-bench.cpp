@@ -0,0 +1,78 @@
+//===- verilog-name-bench.cpp - Verilog emitter naming benchmark ----------===//
+//
+// Generates a module in which every node is used more than once, such that the
+// Verilog emitter has to declare a wire for each of them.  The parser drops the
+// `_T_n` names of the nodes, so all wires are named `_T` and have to be
+// uniqued by the emitter.  The module is parsed once and then emitted to a
+// null stream, which mostly measures the naming of the wires.
+//
+// Usage:
+//   verilog-name-bench [--nodes=1000000] [--repeat=3]
+//
+//===----------------------------------------------------------------------===//
+
+#include "BenchmarkUtils.h"
+#include "circt/Dialect/FIRRTL/Dialect.h"
+#include "circt/EmitVerilog.h"
+#include "circt/FIRParser.h"
+#include "mlir/IR/MLIRContext.h"
+#include "mlir/IR/Module.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace llvm;
+using namespace circt;
+
+static cl::opt<unsigned> numNodes("nodes",
+                                  cl::desc("number of generated nodes"),
+                                  cl::init(1000000));
+static benchmark::RepeatOption numRepeats(3);
+
+/// Generate a module with a chain of nodes that each use the previous one
+/// twice.
+static std::string generateCircuit() {
+  unsigned nodes = numNodes;
+  std::string result;
+  raw_string_ostream os(result);
+  os << "circuit Top :\n"
+     << "  module Top :\n"
+     << "    input in : UInt<8>\n"
+     << "    output out : UInt<8>\n\n"
+     << "    node _T_0 = xor(in, in)\n";
+  for (unsigned n = 1; n < nodes; ++n)
+    os << "    node _T_" << n << " = xor(_T_" << n - 1 << ", _T_" << n - 1
+       << ")\n";
+  os << "    out <= xor(_T_" << nodes - 1 << ", _T_" << nodes - 1 << ")\n";
+  return os.str();
+}
+
+int main(int argc, char **argv) {
+  benchmark::InitBenchmark init(argc, argv,
+                                "Verilog emitter naming benchmark\n");
+
+  mlir::MLIRContext context;
+  context.loadDialect<firrtl::FIRRTLDialect>();
+
+  SourceMgr sourceMgr;
+  sourceMgr.AddNewSourceBuffer(
+      MemoryBuffer::getMemBufferCopy(generateCircuit(), "bench.fir"), SMLoc());
+  auto module = parseFIRFile(sourceMgr, &context, FIRParserOptions());
+  if (!module)
+    return 1;
+
+  auto best = benchmark::timeBestRun(numRepeats, [&](unsigned) {
+    raw_null_ostream os;
+    return succeeded(emitVerilog(module.get(), os));
+  });
+  if (!best)
+    return 1;
+
+  unsigned nodes = numNodes;
+  outs() << "wires: " << nodes << '\n'
+         << "emit:  " << format("%.3f", *best) << " s, "
+         << format("%.2f", nodes / *best / 1e6) << " Mwires/s\n";
+  return 0;
+}
@@ -0,0 +1,110 @@
+//===- verilog-rtl-bench.cpp - Verilog emitter RTL module benchmark -------===//
+//
+// Generates RTL modules whose bodies are made of SV always, ifdef, if and
+// fwrite statements, which the Verilog emitter streams out in place.  The
+// emission throughput is reported next to the bandwidth of copying the emitted
+// Verilog with memcpy, which is the bound the emitter is measured against.
+//
+// Usage:
+//   verilog-rtl-bench [--modules=200] [--statements=500] [--repeat=3]
+//
+//===----------------------------------------------------------------------===//
+
+#include "BenchmarkUtils.h"
+#include "circt/Dialect/RTL/Dialect.h"
+#include "circt/Dialect/SV/Dialect.h"
+#include "circt/EmitVerilog.h"
+#include "mlir/IR/MLIRContext.h"
+#include "mlir/IR/Module.h"
+#include "mlir/Parser.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/raw_ostream.h"
+#include <cstring>
+#include <vector>
+
+using namespace llvm;
+using namespace circt;
+
+static cl::opt<unsigned> numModules("modules",
+                                    cl::desc("number of generated modules"),
+                                    cl::init(200));
+static cl::opt<unsigned>
+    numStatements("statements",
+                  cl::desc("number of always blocks in a module"),
+                  cl::init(500));
+static benchmark::RepeatOption numRepeats(3);
+
+/// Generate RTL modules with a printf-like always block per statement, the
+/// way the lowering to RTL spells out FIRRTL printfs.
+static std::string generateModules() {
+  unsigned modules = numModules, statements = numStatements;
+  std::string result;
+  raw_string_ostream os(result);
+  for (unsigned m = 0; m < modules; ++m) {
+    os << "rtl.module @M" << m
+       << "(%clock: i1, %en: i1, %a: i8, %b: i8) -> (i8 {rtl.name = \"out\"}) "
+          "{\n";
+    for (unsigned n = 0; n < statements; ++n)
+      os << "  sv.alwaysat_posedge %clock {\n"
+         << "    sv.ifdef \"!SYNTHESIS\" {\n"
+         << "      %cond" << n << " = sv.textual_value \"PRINTF_COND_\" : i1\n"
+         << "      %en" << n << " = rtl.and %cond" << n << ", %en : i1\n"
+         << "      sv.if %en" << n << " {\n"
+         << "        %sum" << n << " = rtl.add %a, %b : i8\n"
+         << "        sv.fwrite \"statement " << n << ": %x\\n\"(%sum" << n
+         << ") : i8\n"
+         << "      }\n"
+         << "    }\n"
+         << "  }\n";
+    os << "  %out = rtl.xor %a, %b : i8\n"
+       << "  rtl.output %out : i8\n"
+       << "}\n";
+  }
+  return os.str();
+}
+
+int main(int argc, char **argv) {
+  benchmark::InitBenchmark init(argc, argv,
+                                "Verilog emitter RTL module benchmark\n");
+
+  mlir::MLIRContext context;
+  context.loadDialect<rtl::RTLDialect, sv::SVDialect>();
+
+  auto module = mlir::parseSourceString(generateModules(), &context);
+  if (!module)
+    return 1;
+
+  // Emit the modules, reporting the best time.
+  std::string verilog;
+  auto emitTime = benchmark::timeBestRun(numRepeats, [&](unsigned) {
+    verilog.clear();
+    raw_string_ostream os(verilog);
+    if (failed(emitVerilog(module.get(), os)))
+      return false;
+    os.flush();
+    return true;
+  });
+  if (!emitTime)
+    return 1;
+
+  // Copy the emitted Verilog to buffers that were not touched before, like the
+  // emitter writes to its output, reporting the best time.
+  std::vector<std::unique_ptr<char[]>> copies;
+  for (unsigned i = 0, e = std::max(unsigned(numRepeats), 1u); i != e; ++i)
+    copies.emplace_back(new char[verilog.size()]);
+  double copyTime = *benchmark::timeBestRun(numRepeats, [&](unsigned i) {
+    std::memcpy(copies[i].get(), verilog.data(), verilog.size());
+    return true;
+  });
+
+  double megabytes = verilog.size() / 1e6;
+  outs() << "emit:   " << format("%.3f", *emitTime) << " s, "
+         << format("%.1f", megabytes) << " MB, "
+         << format("%.1f", megabytes / *emitTime) << " MB/s\n"
+         << "memcpy: " << format("%.3f", copyTime) << " s, "
+         << format("%.1f", megabytes / copyTime) << " MB/s\n"
+         << "emit is " << format("%.1f", *emitTime / copyTime)
+         << "x slower than memcpy\n";
+  return 0;
+}
@@ -0,0 +1,151 @@
+//===- fir-lexer-bench.cpp - .fir lexer micro-benchmark -------------------===//
+//
+// Generates a large synthetic .fir corpus in memory and measures how fast the
+// FIRLexer turns it into tokens.  Every token's indentation is queried like the
+// parser does, once through the lexer-recorded value and once by scanning back
+// to the start of the line, which is how indentation used to be computed.  The
+// line and column of every token are computed once through the lexer and once
+// through the source manager.
+//
+// Usage:
+//   fir-lexer-bench [--modules=20000] [--stmts=50] [--repeat=5]
+//
+//===----------------------------------------------------------------------===//
+
+#include "BenchmarkUtils.h"
+#include "FIRLexer.h"
+#include "mlir/IR/MLIRContext.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace llvm;
+using namespace circt;
+using namespace firrtl;
+
+static cl::opt<unsigned> numModules("modules",
+                                    cl::desc("number of generated modules"),
+                                    cl::init(20000));
+static cl::opt<unsigned>
+    numStmts("stmts", cl::desc("number of statements per generated module"),
+             cl::init(50));
+static benchmark::RepeatOption numRepeats(5);
+
+/// Generate a circuit in the style of Chisel output, with locators on most
+/// statements and a few comments.
+static std::string generateCorpus() {
+  std::string result;
+  raw_string_ostream os(result);
+  os << "circuit Top :\n";
+  for (unsigned m = 0; m < numModules; ++m) {
+    os << "  module M" << m << " : @[Generated.scala " << m << ":3]\n"
+       << "    input clock : Clock\n"
+       << "    input io : { flip in : UInt<32>, out : UInt<32>}\n\n";
+    for (unsigned s = 0; s < numStmts; ++s) {
+      if (s % 10 == 0)
+        os << "    ; statement group " << s << "\n";
+      os << "    node _T_" << s << " = add(io.in, UInt<32>(\"h" << s
+         << "\")) @[Generated.scala " << s + 10 << ":" << s % 80 << "]\n";
+      if (s % 5 == 0)
+        os << "    when _T_" << s << " : @[Generated.scala " << s << ":7]\n"
+           << "      io.out <= _T_" << s << " @[Generated.scala " << s
+           << ":9]\n";
+    }
+    os << "    io.out <= io.in\n\n";
+  }
+  return os.str();
+}
+
+/// Keeps the compiler from dropping the indentation queries.
+static volatile size_t indentChecksum;
+
+/// Compute the indentation of a token by scanning backwards from it.
+static Optional<unsigned> scanIndentation(StringRef buffer,
+                                          const FIRToken &tok) {
+  const char *ptr = tok.getSpelling().data();
+  unsigned indent = 0;
+  while (ptr != buffer.begin() &&
+         (ptr[-1] == ' ' || ptr[-1] == '\t' || ptr[-1] == ','))
+    --ptr, ++indent;
+  if (ptr != buffer.begin() && ptr[-1] != '\n' && ptr[-1] != '\r')
+    return None;
+  return indent;
+}
+
+int main(int argc, char **argv) {
+  benchmark::InitBenchmark init(argc, argv, ".fir lexer micro-benchmark\n");
+
+  std::string corpus = generateCorpus();
+  SourceMgr sourceMgr;
+  sourceMgr.AddNewSourceBuffer(
+      MemoryBuffer::getMemBuffer(corpus, "corpus.fir"), SMLoc());
+  StringRef buffer = sourceMgr.getMemoryBuffer(1)->getBuffer();
+  mlir::MLIRContext context;
+
+  // Lex the whole corpus and visit every token, returning the best wall time
+  // in seconds and the number of tokens.
+  using Visitor = llvm::function_ref<size_t(FIRLexer &, const FIRToken &)>;
+  auto run = [&](Visitor visit, size_t &numTokens) {
+    return *benchmark::timeBestRun(numRepeats, [&](unsigned) {
+      FIRLexer lexer(sourceMgr, &context);
+      size_t count = 0, checksum = 0;
+      while (true) {
+        FIRToken tok = lexer.lexToken();
+        checksum += visit(lexer, tok);
+        ++count;
+        if (tok.isAny(FIRToken::eof, FIRToken::error))
+          break;
+      }
+      numTokens = count;
+      indentChecksum = checksum;
+      return true;
+    });
+  };
+
+  size_t numTokens = 0;
+  double recorded = run(
+      [](FIRLexer &, const FIRToken &tok) -> size_t {
+        auto indent = tok.getIndentation();
+        return indent ? *indent : 1;
+      },
+      numTokens);
+  double scanned = run(
+      [&](FIRLexer &, const FIRToken &tok) -> size_t {
+        auto indent = scanIndentation(buffer, tok);
+        return indent ? *indent : 1;
+      },
+      numTokens);
+  double lexerLoc = run(
+      [](FIRLexer &lexer, const FIRToken &tok) -> size_t {
+        auto loc = lexer.translateLocation(tok.getLoc())
+                       .cast<mlir::FileLineColLoc>();
+        return loc.getLine() + loc.getColumn();
+      },
+      numTokens);
+  double sourceMgrLoc = run(
+      [&](FIRLexer &, const FIRToken &tok) -> size_t {
+        auto lineAndColumn = sourceMgr.getLineAndColumn(tok.getLoc());
+        auto loc = mlir::FileLineColLoc::get("corpus.fir", lineAndColumn.first,
+                                             lineAndColumn.second, &context)
+                       .cast<mlir::FileLineColLoc>();
+        return loc.getLine() + loc.getColumn();
+      },
+      numTokens);
+  double megabytes = corpus.size() / 1e6;
+
+  auto report = [&](StringRef name, double time) {
+    outs() << name << format("%.3f", time) << " s, "
+           << format("%.1f", numTokens / time / 1e6) << " Mtok/s, "
+           << format("%.1f", megabytes / time) << " MB/s\n";
+  };
+
+  outs() << "corpus:               " << format("%.1f", megabytes) << " MB, "
+         << numTokens << " tokens\n";
+  report("recorded indent:      ", recorded);
+  report("scanned indent:       ", scanned);
+  report("lexer locations:      ", lexerLoc);
+  report("source mgr locations: ", sourceMgrLoc);
+  return 0;
+}
@@ -0,0 +1,484 @@
+//===- firtool-bench.cpp - firtool pipeline benchmark ---------------------===//
+//
+// Generates a synthetic circuit of the given shape and runs it through the
+// phases of the firtool pipeline in process: parse, canonicalize, lower to RTL
+// and emit Verilog.  The passes are the ones firtool runs, built by
+// buildFirtoolPassPipeline.  The wall time, the throughput and the peak RSS
+// growth of each phase are reported.  The peak RSS growth is how far the phase
+// raised the peak resident set size of the process, so the memory a phase
+// needs on top of what the earlier phases left behind.  It is 0 for a phase
+// that stays below an earlier peak.  The throughput of the emitter is measured
+// on the Verilog it produces, the throughput of the other phases on the .fir
+// input.
+//
+// The parsed circuit is also written to a binary FIRRTL cache in memory, and
+// the load-cache phase reads it back into a fresh context.  Its throughput is
+// measured on the .fir input as well, such that it compares directly with the
+// parse phase.
+//
+// The generator is deterministic for a given shape, scale and seed.  The shapes
+// are:
+//   hierarchy  a wide and deep tree of instances
+//   bundles    a chain of instances with nested bundle and vector ports
+//   registers  many registers with resets, printfs and stops
+//   muxes      deep trees of single-use muxes, inlined into one expression
+//   memories   large memories with several readers and a writer
+//
+// Usage:
+//   firtool-bench --shape=registers [--scale=1] [--seed=1]
+//                 [--disable-threading] [--o=<file.fir>]
+//
+//===----------------------------------------------------------------------===//
+
+#include "BenchmarkUtils.h"
+#include "circt/Dialect/FIRRTL/Dialect.h"
+#include "circt/Dialect/RTL/Dialect.h"
+#include "circt/Dialect/SV/Dialect.h"
+#include "circt/EmitVerilog.h"
+#include "circt/FIRParser.h"
+#include "circt/FIRRTLCache.h"
+#include "circt/FirtoolPipeline.h"
+#include "mlir/IR/MLIRContext.h"
+#include "mlir/IR/Module.h"
+#include "mlir/Pass/PassManager.h"
+#include "mlir/Support/FileUtilities.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/ToolOutputFile.h"
+#include "llvm/Support/raw_ostream.h"
+
+#if LLVM_ON_UNIX
+#include <sys/resource.h>
+#endif
+
+using namespace llvm;
+using namespace circt;
+
+namespace {
+enum class Shape { Hierarchy, Bundles, Registers, Muxes, Memories };
+} // end anonymous namespace
+
+static cl::opt<Shape> shape(
+    "shape", cl::desc("shape of the generated circuit"), cl::Required,
+    cl::values(clEnumValN(Shape::Hierarchy, "hierarchy",
+                          "wide and deep instance hierarchy"),
+               clEnumValN(Shape::Bundles, "bundles",
+                          "nested bundle and vector ports"),
+               clEnumValN(Shape::Registers, "registers",
+                          "registers with printf and stop"),
+               clEnumValN(Shape::Muxes, "muxes", "deep mux trees"),
+               clEnumValN(Shape::Memories, "memories", "large memories")));
+static cl::opt<unsigned>
+    scale("scale", cl::desc("factor applied to the number of modules"),
+          cl::init(1));
+static cl::opt<unsigned> seed("seed",
+                              cl::desc("seed of the generated constants"),
+                              cl::init(1));
+static cl::opt<bool>
+    disableThreading("disable-threading",
+                     cl::desc("run the passes and the emitter on one thread"),
+                     cl::init(false));
+static cl::opt<std::string>
+    corpusFilename("o", cl::desc("also write the generated .fir to this file"),
+                   cl::value_desc("filename"), cl::init(""));
+
+//===----------------------------------------------------------------------===//
+// Circuit Generator
+//===----------------------------------------------------------------------===//
+
+namespace {
+/// A small pseudo random number generator whose sequence only depends on the
+/// seed, unlike the distributions of the standard library.
+class Random {
+public:
+  explicit Random(uint64_t seed) : state(seed) {}
+
+  /// Return the next number of the sequence, using splitmix64.
+  uint64_t next() {
+    uint64_t z = (state += 0x9e3779b97f4a7c15);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    return z ^ (z >> 31);
+  }
+
+  /// Return a number in [0, bound).
+  uint64_t next(uint64_t bound) { return next() % bound; }
+
+private:
+  uint64_t state;
+};
+} // end anonymous namespace
+
+/// A tree of modules `H<level>_<i>`, where each module instantiates all the
+/// modules of the next level and xors their outputs.
+static void generateHierarchy(raw_ostream &os, Random &random) {
+  unsigned levels = 8, width = 32 * scale;
+  os << "circuit H0_0 :\n";
+  for (unsigned level = 0; level != levels; ++level) {
+    unsigned numModules = level == 0 ? 1 : width;
+    bool isLeaf = level == levels - 1;
+    for (unsigned m = 0; m != numModules; ++m) {
+      os << "  module H" << level << '_' << m << " :\n"
+         << "    input clock : Clock\n"
+         << "    input in : UInt<16>\n"
+         << "    output out : UInt<16>\n\n";
+      if (isLeaf) {
+        os << "    out <= xor(in, UInt<16>(" << random.next(1 << 16)
+           << "))\n\n";
+        continue;
+      }
+      for (unsigned c = 0; c != width; ++c)
+        os << "    inst c" << c << " of H" << level + 1 << '_' << c << "\n"
+           << "    c" << c << ".clock <= clock\n"
+           << "    c" << c << ".in <= xor(in, UInt<16>("
+           << random.next(1 << 16) << "))\n";
+      os << "    node acc_0 = c0.out\n";
+      for (unsigned c = 1; c != width; ++c)
+        os << "    node acc_" << c << " = xor(acc_" << c - 1 << ", c" << c
+           << ".out)\n";
+      os << "    out <= acc_" << width - 1 << "\n\n";
+    }
+  }
+}
+
+/// A chain of instances that pass a bundle with flipped fields, nested bundles
+/// and vectors through a wire.
+static void generateBundles(raw_ostream &os) {
+  unsigned numModules = 200 * scale;
+  const char *type = "{ valid : UInt<1>, flip ready : UInt<1>, bits : "
+                     "{ addr : UInt<32>, data : UInt<8>[8], "
+                     "meta : { id : UInt<4>, user : UInt<12> }[2] } }";
+  os << "circuit Top :\n";
+  for (unsigned m = 0; m != numModules; ++m) {
+    os << "  module B" << m << " :\n"
+       << "    input in : " << type << "\n"
+       << "    output out : " << type << "\n\n"
+       << "    wire w : " << type << "\n"
+       << "    w <= in\n"
+       << "    out <= w\n\n";
+  }
+  os << "  module Top :\n"
+     << "    input in : " << type << "\n"
+     << "    output out : " << type << "\n\n";
+  for (unsigned m = 0; m != numModules; ++m) {
+    os << "    inst b" << m << " of B" << m << "\n";
+    if (m == 0)
+      os << "    b0.in <= in\n";
+    else
+      os << "    b" << m << ".in <= b" << m - 1 << ".out\n";
+  }
+  os << "    out <= b" << numModules - 1 << ".out\n";
+}
+
+/// Modules with a chain of registers, some of which are printed or stop the
+/// simulation.
+static void generateRegisters(raw_ostream &os, Random &random) {
+  unsigned numModules = 200 * scale, numRegs = 64;
+  os << "circuit Top :\n";
+  for (unsigned m = 0; m != numModules; ++m) {
+    os << "  module R" << m << " :\n"
+       << "    input clock : Clock\n"
+       << "    input reset : UInt<1>\n"
+       << "    input in : UInt<32>\n"
+       << "    output out : UInt<32>\n\n";
+    for (unsigned r = 0; r != numRegs; ++r) {
+      std::string prev = r == 0 ? "in" : "r" + std::to_string(r - 1);
+      os << "    reg r" << r << " : UInt<32>, clock with :\n"
+         << "      reset => (reset, UInt<32>(" << random.next(1u << 31)
+         << ")) @[Registers.scala " << r + 1 << ":11]\n"
+         << "    r" << r << " <= xor(" << prev << ", UInt<32>("
+         << random.next(1u << 31) << "))\n";
+      if (r % 4 == 0)
+        os << "    printf(clock, eq(r" << r << ", UInt<32>("
+           << random.next(1u << 31) << ")), \"r" << r << " = %x\\n\", r" << r
+           << ") @[Registers.scala " << r + 1 << ":13]\n";
+      if (r % 16 == 0)
+        os << "    stop(clock, and(reset, eq(r" << r
+           << ", UInt<32>(0))), 1) @[Registers.scala " << r + 1 << ":15]\n";
+    }
+    os << "    out <= r" << numRegs - 1 << "\n\n";
+  }
+  os << "  module Top :\n"
+     << "    input clock : Clock\n"
+     << "    input reset : UInt<1>\n"
+     << "    input in : UInt<32>\n"
+     << "    output out : UInt<32>\n\n";
+  for (unsigned m = 0; m != numModules; ++m) {
+    std::string prev = m == 0 ? "in" : "r" + std::to_string(m - 1) + ".out";
+    os << "    inst r" << m << " of R" << m << "\n"
+       << "    r" << m << ".clock <= clock\n"
+       << "    r" << m << ".reset <= reset\n"
+       << "    r" << m << ".in <= " << prev << "\n";
+  }
+  os << "    out <= r" << numModules - 1 << ".out\n";
+}
+
+/// Modules with a balanced tree of muxes over their inputs.  The parser drops
+/// the `_T` names of the nodes, so each tree is a single expression.
+static void generateMuxes(raw_ostream &os, Random &random) {
+  unsigned numModules = 100 * scale, depth = 10, numInputs = 16;
+  os << "circuit Top :\n";
+  for (unsigned m = 0; m != numModules; ++m) {
+    os << "  module M" << m << " :\n"
+       << "    input sel : UInt<" << depth << ">\n";
+    for (unsigned i = 0; i != numInputs; ++i)
+      os << "    input in" << i << " : UInt<8>\n";
+    os << "    output out : UInt<8>\n\n";
+
+    // Level 0 holds the leaves, the root is the only node of the last level.
+    for (unsigned level = 1; level <= depth; ++level) {
+      unsigned numNodes = 1u << (depth - level);
+      for (unsigned n = 0; n != numNodes; ++n) {
+        os << "    node _T_" << level << '_' << n << " = mux(bits(sel, "
+           << level - 1 << ", " << level - 1 << "), ";
+        for (unsigned operand = 0; operand != 2; ++operand) {
+          if (operand)
+            os << ", ";
+          if (level == 1)
+            os << "in" << random.next(numInputs);
+          else
+            os << "_T_" << level - 1 << '_' << 2 * n + operand;
+        }
+        os << ")\n";
+      }
+    }
+    os << "    out <= _T_" << depth << "_0\n\n";
+  }
+  os << "  module Top :\n"
+     << "    input sel : UInt<" << depth << ">\n"
+     << "    input in : UInt<8>\n"
+     << "    output out : UInt<8>\n\n";
+  for (unsigned m = 0; m != numModules; ++m) {
+    std::string prev = m == 0 ? "in" : "m" + std::to_string(m - 1) + ".out";
+    os << "    inst m" << m << " of M" << m << "\n"
+       << "    m" << m << ".sel <= sel\n";
+    for (unsigned i = 0; i != numInputs; ++i)
+      os << "    m" << m << ".in" << i << " <= " << prev << "\n";
+  }
+  os << "    out <= m" << numModules - 1 << ".out\n";
+}
+
+/// Modules with a deep memory that has two readers and a writer.
+static void generateMemories(raw_ostream &os, Random &random) {
+  unsigned numModules = 16 * scale, addrWidth = 16;
+  os << "circuit Top :\n";
+  for (unsigned m = 0; m != numModules; ++m) {
+    os << "  module Mem" << m << " :\n"
+       << "    input clock : Clock\n"
+       << "    input addr : UInt<" << addrWidth << ">\n"
+       << "    input data : UInt<64>\n"
+       << "    input en : UInt<1>\n"
+       << "    output out : UInt<64>\n\n"
+       << "    mem ram : @[Memories.scala " << m + 1 << ":20]\n"
+       << "      data-type => UInt<64>\n"
+       << "      depth => " << (1u << addrWidth) << "\n"
+       << "      read-latency => 0\n"
+       << "      write-latency => 1\n"
+       << "      reader => r0\n"
+       << "      reader => r1\n"
+       << "      writer => w\n"
+       << "      read-under-write => undefined\n\n";
+    for (const char *reader : {"r0", "r1"})
+      os << "    ram." << reader << ".addr <= xor(addr, UInt<" << addrWidth
+         << ">(" << random.next(1u << addrWidth) << "))\n"
+         << "    ram." << reader << ".en <= UInt<1>(1)\n"
+         << "    ram." << reader << ".clk <= clock\n";
+    os << "    ram.w.addr <= addr\n"
+       << "    ram.w.en <= en\n"
+       << "    ram.w.clk <= clock\n"
+       << "    ram.w.data <= data\n"
+       << "    ram.w.mask <= UInt<1>(1)\n"
+       << "    out <= xor(ram.r0.data, ram.r1.data)\n\n";
+  }
+  os << "  module Top :\n"
+     << "    input clock : Clock\n"
+     << "    input addr : UInt<" << addrWidth << ">\n"
+     << "    input data : UInt<64>\n"
+     << "    input en : UInt<1>\n"
+     << "    output out : UInt<64>\n\n";
+  for (unsigned m = 0; m != numModules; ++m) {
+    std::string prev =
+        m == 0 ? "data" : "mem" + std::to_string(m - 1) + ".out";
+    os << "    inst mem" << m << " of Mem" << m << "\n"
+       << "    mem" << m << ".clock <= clock\n"
+       << "    mem" << m << ".addr <= addr\n"
+       << "    mem" << m << ".data <= " << prev << "\n"
+       << "    mem" << m << ".en <= en\n";
+  }
+  os << "    out <= mem" << numModules - 1 << ".out\n";
+}
+
+static StringRef getShapeName() {
+  switch (shape) {
+  case Shape::Hierarchy:
+    return "hierarchy";
+  case Shape::Bundles:
+    return "bundles";
+  case Shape::Registers:
+    return "registers";
+  case Shape::Muxes:
+    return "muxes";
+  case Shape::Memories:
+    return "memories";
+  }
+  llvm_unreachable("unknown shape");
+}
+
+static std::string generateCircuit() {
+  std::string result;
+  raw_string_ostream os(result);
+  Random random(seed);
+  switch (shape) {
+  case Shape::Hierarchy:
+    generateHierarchy(os, random);
+    break;
+  case Shape::Bundles:
+    generateBundles(os);
+    break;
+  case Shape::Registers:
+    generateRegisters(os, random);
+    break;
+  case Shape::Muxes:
+    generateMuxes(os, random);
+    break;
+  case Shape::Memories:
+    generateMemories(os, random);
+    break;
+  }
+  return os.str();
+}
+
+//===----------------------------------------------------------------------===//
+// Driver
+//===----------------------------------------------------------------------===//
+
+/// Return the peak resident set size of the process in megabytes, or 0 if it
+/// is not known on this platform.
+static double getPeakRSS() {
+#if LLVM_ON_UNIX
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) == 0) {
+#if defined(__APPLE__)
+    return usage.ru_maxrss / 1e6;
+#else
+    return usage.ru_maxrss * 1024 / 1e6;
+#endif
+  }
+#endif
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  benchmark::InitBenchmark init(argc, argv, "firtool pipeline benchmark\n");
+
+  std::string corpus = generateCircuit();
+  if (!corpusFilename.empty()) {
+    std::string errorMessage;
+    auto output = mlir::openOutputFile(corpusFilename, &errorMessage);
+    if (!output) {
+      errs() << errorMessage << "\n";
+      return 1;
+    }
+    output->os() << corpus;
+    output->keep();
+  }
+
+  mlir::MLIRContext context;
+  context.loadDialect<firrtl::FIRRTLDialect, rtl::RTLDialect, sv::SVDialect>();
+  context.disableMultithreading(disableThreading);
+
+  SourceMgr sourceMgr;
+  sourceMgr.AddNewSourceBuffer(
+      MemoryBuffer::getMemBuffer(corpus, "bench.fir"), SMLoc());
+  double firMegabytes = corpus.size() / 1e6;
+
+  // Time a phase and report it, returning false if it failed.
+  auto runPhase = [&](StringRef name, function_ref<bool()> phase,
+                      function_ref<double()> getMegabytes) {
+    double peakRSSBefore = getPeakRSS();
+    auto time = benchmark::timeRun(phase);
+    if (!time) {
+      errs() << name << " failed\n";
+      return false;
+    }
+    outs() << name << ':';
+    outs().indent(14 - name.size())
+        << format("%.3f", *time) << " s, "
+        << format("%.1f", getMegabytes() / *time) << " MB/s, "
+        << format("%.1f", getPeakRSS() - peakRSSBefore)
+        << " MB peak RSS growth\n";
+    return true;
+  };
+  auto getFIRMegabytes = [&] { return firMegabytes; };
+
+  outs() << "shape:         " << getShapeName() << ", "
+         << format("%.1f", firMegabytes) << " MB .fir\n";
+
+  mlir::OwningModuleRef module;
+  if (!runPhase(
+          "parse",
+          [&] {
+            module = parseFIRFile(sourceMgr, &context, FIRParserOptions());
+            return bool(module);
+          },
+          getFIRMegabytes))
+    return 1;
+
+  std::string cache;
+  {
+    raw_string_ostream os(cache);
+    if (failed(writeFIRRTLCache(module.get(), os))) {
+      errs() << "writing the FIRRTL cache failed\n";
+      return 1;
+    }
+  }
+  if (!runPhase(
+          "load-cache",
+          [&] {
+            mlir::MLIRContext cacheContext;
+            cacheContext.loadDialect<firrtl::FIRRTLDialect>();
+            cacheContext.disableMultithreading(disableThreading);
+            SourceMgr cacheSourceMgr;
+            cacheSourceMgr.AddNewSourceBuffer(
+                MemoryBuffer::getMemBuffer(cache, "bench.firb",
+                                           /*RequiresNullTerminator=*/false),
+                SMLoc());
+            return bool(readFIRRTLCache(cacheSourceMgr, &cacheContext));
+          },
+          getFIRMegabytes))
+    return 1;
+
+  // The phases run firtool's own pipeline: without any lowering for the
+  // canonicalize phase, and with -lower-to-rtl on the canonicalized circuit
+  // for the lower phase.
+  mlir::PassManager canonicalizePM(&context);
+  buildFirtoolPassPipeline(canonicalizePM, FirtoolPipelineOptions());
+  if (!runPhase(
+          "canonicalize",
+          [&] { return succeeded(canonicalizePM.run(module.get())); },
+          getFIRMegabytes))
+    return 1;
+
+  mlir::PassManager lowerPM(&context);
+  FirtoolPipelineOptions lowerOptions;
+  lowerOptions.lowerToRTL = true;
+  buildFirtoolPassPipeline(lowerPM, lowerOptions);
+  if (!runPhase(
+          "lower", [&] { return succeeded(lowerPM.run(module.get())); },
+          getFIRMegabytes))
+    return 1;
+
+  SmallString<0> verilog;
+  if (!runPhase(
+          "emit",
+          [&] {
+            raw_svector_ostream os(verilog);
+            return succeeded(emitVerilog(module.get(), os));
+          },
+          [&] { return verilog.size() / 1e6; }))
+    return 1;
+  return 0;
+}
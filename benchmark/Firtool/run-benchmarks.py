@@ -0,0 +1,145 @@
+#!/usr/bin/env python3
+#===- run-benchmarks.py - firtool pipeline regression runner -------------===#
+#
+# Runs firtool-bench for every circuit shape and checks the reported phases
+# against regression thresholds.  A threshold file gives the minimum MB/s and
+# the maximum peak RSS growth of each phase, under "default" and optionally per
+# shape.  The peak RSS growth is how far the phase raised the peak resident
+# set size of firtool-bench.
+# A shape that does not report all of parse, canonicalize, lower and emit
+# fails.  The results can be saved and used as the baseline of a later run,
+# which then also fails if a phase got slower than the baseline by more than
+# the tolerance.
+#
+# Usage:
+#   run-benchmarks.py --firtool-bench build/bin/firtool-bench
+#                     [--thresholds thresholds.json] [--baseline old.json]
+#                     [--save new.json] [--scale 1] [--repeat 3]
+#
+#===-----------------------------------------------------------------------===#
+
+import argparse
+import json
+import re
+import subprocess
+import sys
+
+SHAPES = ["hierarchy", "bundles", "registers", "muxes", "memories"]
+
+# The phases every shape has to report, a run that is missing one of them
+# fails rather than passing unchecked.
+REQUIRED_PHASES = ["parse", "canonicalize", "lower", "emit"]
+
+PHASE_RE = re.compile(r"^([\w-]+):\s+([\d.]+) s, ([\d.]+) MB/s, "
+                      r"([\d.]+) MB peak RSS growth$")
+
+
+def run(firtool_bench, shape, scale, extra_args):
+  """Run one shape and return the reported phases, keyed by name."""
+  cmd = [firtool_bench, f"--shape={shape}", f"--scale={scale}"] + extra_args
+  output = subprocess.run(cmd, check=True, stdout=subprocess.PIPE,
+                          universal_newlines=True).stdout
+  phases = {}
+  for line in output.splitlines():
+    match = PHASE_RE.match(line)
+    if match:
+      phases[match.group(1)] = {
+          "time_s": float(match.group(2)),
+          "mb_per_s": float(match.group(3)),
+          "peak_rss_growth_mb": float(match.group(4)),
+      }
+  return phases
+
+
+def best_of(runs):
+  """Merge several runs of a shape, keeping the best result of each phase."""
+  best = {}
+  for phases in runs:
+    for name, result in phases.items():
+      if name not in best or result["time_s"] < best[name]["time_s"]:
+        best[name] = result
+  return best
+
+
+def get_threshold(thresholds, shape, phase):
+  """Return the thresholds of a phase, with per-shape entries taking
+  precedence over the defaults."""
+  result = dict(thresholds.get("default", {}).get(phase, {}))
+  result.update(thresholds.get(shape, {}).get(phase, {}))
+  return result
+
+
+def main():
+  parser = argparse.ArgumentParser(description=__doc__)
+  parser.add_argument("--firtool-bench", required=True,
+                      help="path to the firtool-bench binary")
+  parser.add_argument("--thresholds",
+                      help="JSON file with the minimum MB/s and maximum "
+                      "peak RSS growth of each phase")
+  parser.add_argument("--baseline",
+                      help="JSON file saved by an earlier run to compare with")
+  parser.add_argument("--tolerance", type=float, default=0.2,
+                      help="fraction a phase may be slower than the baseline")
+  parser.add_argument("--save", help="write the results to this JSON file")
+  parser.add_argument("--shapes", default=",".join(SHAPES),
+                      help="comma separated list of shapes to run")
+  parser.add_argument("--scale", type=int, default=1,
+                      help="factor applied to the size of the circuits")
+  parser.add_argument("--repeat", type=int, default=3,
+                      help="number of runs per shape, the best time of each "
+                      "phase is reported")
+  parser.add_argument("--disable-threading", action="store_true",
+                      help="run the pipeline on one thread")
+  args = parser.parse_args()
+
+  thresholds = {}
+  if args.thresholds:
+    with open(args.thresholds) as f:
+      thresholds = json.load(f)
+  baseline = {}
+  if args.baseline:
+    with open(args.baseline) as f:
+      baseline = json.load(f)
+  extra_args = ["--disable-threading"] if args.disable_threading else []
+
+  results = {}
+  failures = []
+  for shape in args.shapes.split(","):
+    results[shape] = best_of(
+        run(args.firtool_bench, shape, args.scale, extra_args)
+        for _ in range(args.repeat))
+    for phase in REQUIRED_PHASES:
+      if phase not in results[shape]:
+        failures.append(f"{shape} {phase}: the phase was not reported")
+    for phase, result in results[shape].items():
+      print(f"{shape:10} {phase:13} {result['time_s']:8.3f} s "
+            f"{result['mb_per_s']:8.1f} MB/s "
+            f"{result['peak_rss_growth_mb']:8.1f} MB peak RSS growth")
+
+      limits = get_threshold(thresholds, shape, phase)
+      if result["mb_per_s"] < limits.get("min_mb_per_s", 0):
+        failures.append(f"{shape} {phase}: {result['mb_per_s']:.1f} MB/s is "
+                        f"below {limits['min_mb_per_s']} MB/s")
+      if result["peak_rss_growth_mb"] > limits.get("max_peak_rss_growth_mb",
+                                                   float("inf")):
+        failures.append(f"{shape} {phase}: {result['peak_rss_growth_mb']:.1f} "
+                        f"MB peak RSS growth is above "
+                        f"{limits['max_peak_rss_growth_mb']} MB")
+
+      old = baseline.get(shape, {}).get(phase)
+      if old and result["time_s"] > old["time_s"] * (1 + args.tolerance):
+        failures.append(f"{shape} {phase}: {result['time_s']:.3f} s is more "
+                        f"than {args.tolerance:.0%} slower than the baseline "
+                        f"{old['time_s']:.3f} s")
+
+  if args.save:
+    with open(args.save, "w") as f:
+      json.dump(results, f, indent=2, sort_keys=True)
+
+  for failure in failures:
+    print(f"REGRESSION: {failure}")
+  return 1 if failures else 0
+
+
+if __name__ == "__main__":
+  sys.exit(main())
@@ -0,0 +1,88 @@
+#!/usr/bin/env python3
+#===- process-scaling.py - LLHD transformation pass scaling benchmark -----===#
+#
+# Generates a design with many LLHD processes and measures how the LLHD
+# transformation passes scale when circt-opt runs them multithreaded compared
+# to a single-threaded run.
+#
+# Usage:
+#   process-scaling.py --circt-opt build/bin/circt-opt [--processes 10000]
+#
+#===-----------------------------------------------------------------------===#
+
+import argparse
+import os
+import subprocess
+import sys
+import tempfile
+import time
+
+PASSES = [
+    "-llhd-memory-to-block-argument",
+    "-llhd-early-code-motion",
+    "-llhd-process-lowering",
+    "-llhd-function-elimination",
+]
+
+
+def generate(num_processes, out):
+  """Write a design with `num_processes` lowerable processes to `out`."""
+  for i in range(num_processes):
+    out.write(f"""
+llhd.proc @proc{i}(%in : !llhd.sig<i32>) -> (%out : !llhd.sig<i32>) {{
+  br ^body
+^body:
+  %c = llhd.const {i} : i32
+  %v = llhd.var %c : i32
+  %p = llhd.prb %in : !llhd.sig<i32>
+  %x = llhd.xor %p, %c : i32
+  llhd.store %v, %x : !llhd.ptr<i32>
+  %l = llhd.load %v : !llhd.ptr<i32>
+  %n = llhd.not %l : i32
+  %t = llhd.const #llhd.time<0ns, 1d, 0e> : !llhd.time
+  llhd.drv %out, %n after %t : !llhd.sig<i32>
+  llhd.wait (%in : !llhd.sig<i32>), ^body
+}}
+""")
+
+
+def run(circt_opt, input_file, extra_args):
+  """Run the pass pipeline once and return the wall time in seconds."""
+  cmd = [circt_opt, input_file, "-o", os.devnull] + PASSES + extra_args
+  start = time.perf_counter()
+  subprocess.run(cmd, check=True)
+  return time.perf_counter() - start
+
+
+def main():
+  parser = argparse.ArgumentParser(description=__doc__)
+  parser.add_argument("--circt-opt", required=True,
+                      help="path to the circt-opt binary")
+  parser.add_argument("--processes", type=int, default=10000,
+                      help="number of processes in the generated design")
+  parser.add_argument("--repeat", type=int, default=3,
+                      help="number of runs per configuration, the best "
+                      "time is reported")
+  args = parser.parse_args()
+
+  with tempfile.TemporaryDirectory() as tmp:
+    input_file = os.path.join(tmp, "processes.mlir")
+    with open(input_file, "w") as f:
+      generate(args.processes, f)
+
+    serial = min(
+        run(args.circt_opt, input_file, ["-mlir-disable-threading"])
+        for _ in range(args.repeat))
+    parallel = min(
+        run(args.circt_opt, input_file, []) for _ in range(args.repeat))
+
+  print(f"processes:        {args.processes}")
+  print(f"cores:            {os.cpu_count()}")
+  print(f"single-threaded:  {serial:.3f}s")
+  print(f"multithreaded:    {parallel:.3f}s")
+  print(f"speedup:          {serial / parallel:.2f}x")
+  return 0
+
+
+if __name__ == "__main__":
+  sys.exit(main())
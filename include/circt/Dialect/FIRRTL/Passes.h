@@ -24,6 +24,7 @@ namespace firrtl {
 
 std::unique_ptr<mlir::Pass> createLowerFIRRTLToRTLModulePass();
 std::unique_ptr<mlir::Pass> createLowerFIRRTLToRTLPass();
+std::unique_ptr<mlir::Pass> createLowerFIRRTLTypesPass();
 
 } // namespace firrtl
 } // namespace circt
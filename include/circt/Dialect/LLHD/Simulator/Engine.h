@@ -25,9 +25,11 @@ struct Instance;
 class Engine {
 public:
   /// Initialize an LLHD simulation engine. This initializes the state, as well
-  /// as the mlir::ExecutionEngine with the given module.
+  /// as the mlir::ExecutionEngine with the given module. Array signals of at
+  /// least `sparseThreshold` bytes are stored sparsely, a threshold of 0
+  /// disables sparse storage.
   Engine(llvm::raw_ostream &out, ModuleOp module, MLIRContext &context,
-         std::string root);
+         std::string root, uint64_t sparseThreshold = 0);
 
   /// Default destructor
   ~Engine();
@@ -19,6 +19,7 @@ namespace circt {
 namespace llhd {
 using namespace mlir;
 
+class EntityOp;
 class ProcOp;
 
 std::unique_ptr<OperationPass<ModuleOp>> createProcessLoweringPass();
@@ -29,6 +30,8 @@ std::unique_ptr<OperationPass<ProcOp>> createMemoryToBlockArgumentPass();
 
 std::unique_ptr<OperationPass<ProcOp>> createEarlyCodeMotionPass();
 
+std::unique_ptr<OperationPass<EntityOp>> createSignalForwardingPass();
+
 /// Register the LLHD Transformation passes.
 void initLLHDTransformationPasses();
 
@@ -12,11 +12,46 @@
 namespace mlir {
 struct LogicalResult;
 class ModuleOp;
+class Operation;
 } // namespace mlir
 
 namespace circt {
 
-mlir::LogicalResult emitVerilog(mlir::ModuleOp module, llvm::raw_ostream &os);
+struct VerilogEmitterOptions {
+  /// If this is set, no comments with the source locations of the statements
+  /// are emitted, and the locations are not even looked at.
+  bool dropLocationInfo = false;
+
+  /// Expression trees that are inlined into a single statement are limited to
+  /// this many operations and this depth.  Larger trees are split up by
+  /// emitting subexpressions to wires.  Zero means no limit.
+  unsigned maxExpressionSize = 1000;
+  unsigned maxExpressionDepth = 100;
+};
+
+mlir::LogicalResult emitVerilog(mlir::ModuleOp module, llvm::raw_ostream &os,
+                                VerilogEmitterOptions options = {});
+
+/// Emit the macros that precede the modules of a circuit in the output of
+/// `emitVerilog`.
+void emitVerilogCircuitHeader(llvm::raw_ostream &os);
+
+/// Emit a single FIRRTL or RTL module, like `emitVerilog` does for each module
+/// of a circuit.  The modules it instantiates have to be defined in the same
+/// symbol table, but only their ports are used.
+mlir::LogicalResult emitVerilogModule(mlir::Operation *module,
+                                      llvm::raw_ostream &os,
+                                      VerilogEmitterOptions options = {});
+
+/// Emit each module to its own `<name>.v` file in the specified directory,
+/// together with a header that holds the macros of the circuits and a
+/// `filelist.f` that lists the modules.  The modules are emitted concurrently
+/// if the context has multithreading enabled, and files whose contents did not
+/// change are not rewritten.  The files of modules listed by a previous
+/// `filelist.f` that no longer exist are removed.
+mlir::LogicalResult emitSplitVerilog(mlir::ModuleOp module,
+                                     llvm::StringRef dirname,
+                                     VerilogEmitterOptions options = {});
 
 void registerVerilogEmitterTranslation();
 
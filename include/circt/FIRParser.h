@@ -7,12 +7,16 @@
 #ifndef CIRCT_DIALECT_FIRPARSER_H
 #define CIRCT_DIALECT_FIRPARSER_H
 
+#include "mlir/Support/LogicalResult.h"
+#include <functional>
+
 namespace llvm {
 class SourceMgr;
 }
 
 namespace mlir {
 class MLIRContext;
+class Operation;
 class OwningModuleRef;
 } // namespace mlir
 
@@ -22,6 +26,26 @@ struct FIRParserOptions {
   /// If this is set to true, the @info locators are ignored, and the locations
   /// are set to the location in the .fir file.
   bool ignoreInfoLocators = false;
+
+  /// If this is set to true, the modules of a circuit are parsed concurrently
+  /// when the context has multithreading enabled.  The resulting IR and the
+  /// reported diagnostics are the same as for a serial parse.
+  bool parseModulesInParallel = false;
+
+  /// If this is set to true, operations that would be located in the .fir
+  /// file get the location of the file as a whole, which saves computing and
+  /// uniquing a line and column for each of them.  The line and column are
+  /// lost for good: only the diagnostics of the parser itself still point
+  /// into the .fir file, diagnostics of later passes and the emitted
+  /// Verilog do not.  Locations from @info locators are not affected.
+  bool dropFIRLocations = false;
+
+  /// If this is set, it is called with each module and extmodule right after
+  /// it was parsed, in the order of the .fir file.  Modules have to be defined
+  /// before they are instantiated, so the callback may process a module and
+  /// drop its body, later modules only need its ports.  Returning failure
+  /// stops the parse.  Modules are parsed serially if this is set.
+  std::function<mlir::LogicalResult(mlir::Operation *)> moduleCallback;
 };
 
 mlir::OwningModuleRef parseFIRFile(llvm::SourceMgr &sourceMgr,
@@ -0,0 +1,69 @@
+//===- FIRRTLCache.h - Binary FIRRTL cache reader and writer ----*- C++ -*-===//
+//
+// Defines the interface to the binary FIRRTL cache format, which stores parsed
+// FIRRTL IR such that it can be loaded without lexing and parsing the .fir
+// file it came from again.  firtool-bench compares the two load times.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef CIRCT_FIRRTLCACHE_H
+#define CIRCT_FIRRTLCACHE_H
+
+#include "circt/Support/LLVM.h"
+#include <memory>
+
+namespace llvm {
+class MemoryBuffer;
+class SourceMgr;
+} // namespace llvm
+
+namespace mlir {
+struct LogicalResult;
+class MLIRContext;
+class ModuleOp;
+class Operation;
+class OwningModuleRef;
+} // namespace mlir
+
+namespace circt {
+
+/// Write the specified IR to `os` in the binary FIRRTL cache format.
+mlir::LogicalResult writeFIRRTLCache(mlir::ModuleOp module,
+                                     llvm::raw_ostream &os);
+
+/// Reads a binary FIRRTL cache on demand.  The IR is loaded with the ports of
+/// all modules first, the bodies of the modules are loaded when they are
+/// requested.  Strings are read in place, the buffer is never copied and has to
+/// outlive the reader.
+class FIRRTLCacheReader {
+public:
+  FIRRTLCacheReader(const llvm::MemoryBuffer &buffer,
+                    mlir::MLIRContext *context);
+  ~FIRRTLCacheReader();
+
+  /// Load the IR with empty module bodies, which only hold their terminator.
+  /// Return null and emit a diagnostic if the cache is malformed.  This may
+  /// only be called once.
+  mlir::OwningModuleRef loadModuleShells();
+
+  /// Load the body of a module returned by `loadModuleShells`.  This does
+  /// nothing if the body is loaded already.
+  mlir::LogicalResult loadModuleBody(mlir::Operation *module);
+
+  /// Load the bodies of all modules that were not loaded yet.  They are loaded
+  /// concurrently if the context has multithreading enabled.
+  mlir::LogicalResult loadAllModuleBodies();
+
+private:
+  class Impl;
+  std::unique_ptr<Impl> impl;
+};
+
+/// Load the main file of the source manager as a binary FIRRTL cache, with
+/// all module bodies.
+mlir::OwningModuleRef readFIRRTLCache(llvm::SourceMgr &sourceMgr,
+                                      mlir::MLIRContext *context);
+
+} // namespace circt
+
+#endif // CIRCT_FIRRTLCACHE_H
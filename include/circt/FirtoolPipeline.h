@@ -0,0 +1,34 @@
+//===- FirtoolPipeline.h - The firtool pass pipeline ------------*- C++ -*-===//
+//
+// Defines the optimizations and lowerings that firtool runs between parsing a
+// circuit and emitting it, such that firtool-bench measures the same pipeline.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef CIRCT_FIRTOOLPIPELINE_H
+#define CIRCT_FIRTOOLPIPELINE_H
+
+namespace mlir {
+class OpPassManager;
+} // namespace mlir
+
+namespace circt {
+
+struct FirtoolPipelineOptions {
+  /// If this is set to true, bundle and vector types are lowered to ground
+  /// types.
+  bool lowerTypes = false;
+
+  /// If this is set to true, FIRRTL modules are lowered to the RTL dialect.
+  /// This implies lowering the types.
+  bool lowerToRTL = false;
+};
+
+/// Add the optimizations and lowerings of firtool to the specified pass
+/// manager, which has to run on the module holding the circuit.
+void buildFirtoolPassPipeline(mlir::OpPassManager &pm,
+                              const FirtoolPipelineOptions &options);
+
+} // namespace circt
+
+#endif // CIRCT_FIRTOOLPIPELINE_H
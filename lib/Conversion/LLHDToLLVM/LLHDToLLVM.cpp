@@ -13,6 +13,7 @@
 #include "mlir/Dialect/LLVMIR/LLVMDialect.h"
 #include "mlir/Dialect/StandardOps/IR/Ops.h"
 #include "mlir/IR/BlockAndValueMapping.h"
+#include "mlir/IR/Matchers.h"
 #include "mlir/Pass/Pass.h"
 #include "mlir/Transforms/DialectConversion.h"
 
@@ -519,6 +520,17 @@ static Operation *recursiveCloneInit(OpBuilder &initBuilder, Operation *op) {
   return initBuilder.insert(op->clone());
 }
 
+/// Return true if the given initial value of a signal is known to be all
+/// zeros.
+static bool isZeroInit(Value init) {
+  Operation *op = init.getDefiningOp();
+  if (auto arrayUniformOp = dyn_cast_or_null<ArrayUniformOp>(op))
+    return isZeroInit(arrayUniformOp.init());
+  if (auto arrayOp = dyn_cast_or_null<ArrayOp>(op))
+    return llvm::all_of(arrayOp.values(), isZeroInit);
+  return matchPattern(init, m_Zero());
+}
+
 /// Check if the given type is either of LLHD's ArrayType, TupleType, or LLVM
 /// array or struct type.
 static bool isArrayOrTuple(Type type) {
@@ -1080,9 +1092,9 @@ struct WaitOpConversion : public ConvertToLLVMPattern {
 } // namespace
 
 namespace {
-/// Lower an llhd.inst operation to LLVM dialect. This generates malloc calls
-/// and allocSignal calls (to store the pointer into the state) for each signal
-/// in the instantiated entity.
+/// Lower an llhd.inst operation to LLVM dialect. This generates
+/// allocSignalStorage and allocSignal calls (to store the pointer into the
+/// state) for each signal in the instantiated entity.
 struct InstOpConversion : public ConvertToLLVMPattern {
   explicit InstOpConversion(MLIRContext *ctx, LLVMTypeConverter &typeConverter)
       : ConvertToLLVMPattern(InstOp::getOperationName(), ctx, typeConverter) {}
@@ -1116,6 +1128,15 @@ struct InstOpConversion : public ConvertToLLVMPattern {
     auto mallFunc = getOrInsertFunction(module, rewriter, op->getLoc(),
                                         "malloc", mallocSigFuncTy);
 
+    // Get or insert the allocSignalStorage library call definition.
+    // allocSignalStorage function signature: (i8* %state, i32 %sig_index, i8*
+    // %sig_owner, i64 %size) -> i8* %value.
+    auto allocSigStorageFuncTy = LLVM::LLVMType::getFunctionTy(
+        i8PtrTy, {i8PtrTy, i32Ty, i8PtrTy, i64Ty}, /*isVarArg=*/false);
+    auto sigStorageFunc =
+        getOrInsertFunction(module, rewriter, op->getLoc(),
+                            "allocSignalStorage", allocSigStorageFuncTy);
+
     // Get or insert the allocSignal library call definition.
     // allocSignal function signature: (i8* %state, i8* %sig_name, i8*
     // %sig_owner, i32 %value) -> i32 %sig_index.
@@ -1218,16 +1239,9 @@ struct InstOpConversion : public ConvertToLLVMPattern {
             op.getLoc(), i32Ty, rewriter.getI32IntegerAttr(initCounter));
         initCounter++;
 
-        // Clone and insert the operation that defines the signal's init
-        // operand (assmued to be a constant/array op)
-        auto defOp = op.init().getDefiningOp();
-        auto initDef = recursiveCloneInit(initBuilder, defOp)->getResult(0);
-
-        // Compute the required space to malloc.
+        // Compute the size of the signal value.
         auto oneC = initBuilder.create<LLVM::ConstantOp>(
             op.getLoc(), i32Ty, rewriter.getI32IntegerAttr(1));
-        auto twoC = initBuilder.create<LLVM::ConstantOp>(
-            op.getLoc(), i64Ty, rewriter.getI32IntegerAttr(2));
         auto nullPtr = initBuilder.create<LLVM::NullOp>(
             op.getLoc(), underlyingTy.getPointerTo());
         auto sizeGep = initBuilder.create<LLVM::GEPOp>(
@@ -1235,21 +1249,28 @@ struct InstOpConversion : public ConvertToLLVMPattern {
             ArrayRef<Value>(oneC));
         auto size =
             initBuilder.create<LLVM::PtrToIntOp>(op.getLoc(), i64Ty, sizeGep);
-        // Malloc double the required space to make sure signal
-        // shifts do not segfault.
-        auto mallocSize =
-            initBuilder.create<LLVM::MulOp>(op.getLoc(), i64Ty, size, twoC);
-        std::array<Value, 1> margs({mallocSize});
-        auto mall = initBuilder
-                        .create<LLVM::CallOp>(
-                            op.getLoc(), i8PtrTy,
-                            rewriter.getSymbolRefAttr(mallFunc), margs)
-                        .getResult(0);
-
-        // Store the initial value.
-        auto bitcast = initBuilder.create<LLVM::BitcastOp>(
-            op.getLoc(), underlyingTy.getPointerTo(), mall);
-        initBuilder.create<LLVM::StoreOp>(op.getLoc(), initDef, bitcast);
+        // Let the runtime allocate the zero-initialized storage, it decides
+        // whether a large memory is stored sparsely.
+        std::array<Value, 4> storageArgs(
+            {initStatePtr, indexConst, owner, size});
+        auto storage = initBuilder
+                           .create<LLVM::CallOp>(
+                               op.getLoc(), i8PtrTy,
+                               rewriter.getSymbolRefAttr(sigStorageFunc),
+                               storageArgs)
+                           .getResult(0);
+
+        // Clone and insert the operation that defines the signal's init
+        // operand (assmued to be a constant/array op), and store the initial
+        // value. A zero value is already in place, storing it would touch
+        // every page of the storage.
+        if (!isZeroInit(op.init())) {
+          auto defOp = op.init().getDefiningOp();
+          auto initDef = recursiveCloneInit(initBuilder, defOp)->getResult(0);
+          auto bitcast = initBuilder.create<LLVM::BitcastOp>(
+              op.getLoc(), underlyingTy.getPointerTo(), storage);
+          initBuilder.create<LLVM::StoreOp>(op.getLoc(), initDef, bitcast);
+        }
 
         // Get the amount of bytes required to represent an integer underlying
         // type. Use the whole size of the type if not an integer.
@@ -1264,7 +1285,7 @@ struct InstOpConversion : public ConvertToLLVMPattern {
         }
 
         std::array<Value, 5> args(
-            {initStatePtr, indexConst, owner, mall, passSize});
+            {initStatePtr, indexConst, owner, storage, passSize});
         initBuilder.create<LLVM::CallOp>(
             op.getLoc(), i32Ty, rewriter.getSymbolRefAttr(sigFunc), args);
       });
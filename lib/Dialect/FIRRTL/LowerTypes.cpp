@@ -0,0 +1,714 @@
+//===- LowerTypes.cpp - Lower FIRRTL aggregate types ----------------------===//
+//
+// This file lowers the bundle and vector types of a FIRRTL circuit to ground
+// types.  Ports, wires, registers, nodes and instances of aggregate type are
+// split into one declaration per ground field, and the connects between
+// aggregates into one connect per ground field.
+//
+//===----------------------------------------------------------------------===//
+
+#include "circt/Dialect/FIRRTL/Ops.h"
+#include "circt/Dialect/FIRRTL/Passes.h"
+#include "circt/Dialect/FIRRTL/Visitors.h"
+#include "mlir/IR/FunctionImplementation.h"
+#include "mlir/Pass/Pass.h"
+#include "llvm/ADT/StringMap.h"
+using namespace circt;
+using namespace firrtl;
+
+/// Return the type of the specified value, casted to the template type.
+template <typename T = FIRRTLType>
+static T getTypeOf(Value v) {
+  return v.getType().cast<T>();
+}
+
+/// Return the specified type with its outermost flip removed.
+static FIRRTLType stripFlip(FIRRTLType type) {
+  if (auto flip = type.dyn_cast<FlipType>())
+    return flip.getElementType();
+  return type;
+}
+
+/// Return true if the specified type is a bundle or a vector.
+static bool isAggregateType(FIRRTLType type) {
+  type = stripFlip(type);
+  return type.isa<BundleType>() || type.isa<FVectorType>();
+}
+
+#define GEN_PASS_CLASSES
+#include "circt/Dialect/FIRRTL/FIRRTLPasses.h.inc"
+
+//===----------------------------------------------------------------------===//
+// Flattened Types
+//===----------------------------------------------------------------------===//
+
+namespace {
+/// A ground field of a flattened aggregate type.
+struct FlatField {
+  /// This is appended to the name of the aggregate to name the field, e.g.
+  /// "_a_0" for the first element of the vector in field "a".
+  std::string suffix;
+  /// This is the ground type of the field, without flips.
+  FIRRTLType type;
+  /// This indicates whether the field is flipped within the aggregate.
+  bool isFlipped;
+
+  /// Return the type of the field as seen through the aggregate.
+  FIRRTLType getValueType() const {
+    return isFlipped ? FlipType::get(type) : type;
+  }
+};
+
+/// Flattens types into their ground fields.  The fields of each type are only
+/// computed once, all values of a type share them.
+class FlatFieldCache {
+public:
+  /// Return the ground fields of the specified type, in declaration order.  A
+  /// ground type has a single field with an empty suffix.  The result stays
+  /// valid as long as the cache.
+  ArrayRef<FlatField> getFields(FIRRTLType type);
+
+  /// Return the index of the first ground field of the specified bundle
+  /// element within the fields of the bundle.
+  size_t getFieldOffset(FIRRTLType type, StringRef name);
+
+  /// Return the index of the first ground field of the specified vector
+  /// element within the fields of the vector.
+  size_t getFieldOffset(FIRRTLType type, unsigned index);
+
+private:
+  static void flatten(FIRRTLType type, StringRef suffix, bool isFlipped,
+                      std::vector<FlatField> &fields);
+
+  /// The vectors are moved when the map grows, which keeps their elements in
+  /// place.
+  DenseMap<FIRRTLType, std::vector<FlatField>> cache;
+};
+} // end anonymous namespace
+
+ArrayRef<FlatField> FlatFieldCache::getFields(FIRRTLType type) {
+  auto it = cache.find(type);
+  if (it != cache.end())
+    return it->second;
+
+  std::vector<FlatField> fields;
+  flatten(type, "", false, fields);
+  return cache.try_emplace(type, std::move(fields)).first->second;
+}
+
+void FlatFieldCache::flatten(FIRRTLType type, StringRef suffix, bool isFlipped,
+                             std::vector<FlatField> &fields) {
+  if (auto flip = type.dyn_cast<FlipType>())
+    return flatten(flip.getElementType(), suffix, !isFlipped, fields);
+
+  SmallString<16> elementSuffix(suffix);
+  if (auto bundle = type.dyn_cast<BundleType>()) {
+    for (auto &element : bundle.getElements()) {
+      elementSuffix.resize(suffix.size());
+      elementSuffix.push_back('_');
+      elementSuffix.append(element.first.strref());
+      flatten(element.second, elementSuffix, isFlipped, fields);
+    }
+    return;
+  }
+
+  if (auto vector = type.dyn_cast<FVectorType>()) {
+    for (unsigned i = 0, e = vector.getNumElements(); i != e; ++i) {
+      elementSuffix.resize(suffix.size());
+      elementSuffix.push_back('_');
+      elementSuffix.append(std::to_string(i));
+      flatten(vector.getElementType(), elementSuffix, isFlipped, fields);
+    }
+    return;
+  }
+
+  fields.push_back({suffix.str(), type, isFlipped});
+}
+
+size_t FlatFieldCache::getFieldOffset(FIRRTLType type, StringRef name) {
+  size_t offset = 0;
+  for (auto &element : stripFlip(type).cast<BundleType>().getElements()) {
+    if (element.first == name)
+      break;
+    offset += getFields(element.second).size();
+  }
+  return offset;
+}
+
+size_t FlatFieldCache::getFieldOffset(FIRRTLType type, unsigned index) {
+  auto vector = stripFlip(type).cast<FVectorType>();
+  return index * getFields(vector.getElementType()).size();
+}
+
+//===----------------------------------------------------------------------===//
+// Module Body Lowering
+//===----------------------------------------------------------------------===//
+
+namespace {
+/// Lowers the aggregate values in the body of a module.  Each lowered value is
+/// mapped to the values of its ground fields, and the operations that used it
+/// are rewritten to use those instead.
+class ModuleTypeLowering
+    : public FIRRTLVisitor<ModuleTypeLowering, LogicalResult> {
+public:
+  ModuleTypeLowering(FlatFieldCache &cache, MLIRContext *context)
+      : cache(cache), builder(context) {}
+
+  /// Map an aggregate value to the values of its ground fields.
+  void setLowering(Value value, ArrayRef<Value> fields) {
+    loweredFields[value].assign(fields.begin(), fields.end());
+  }
+
+  /// Lower the operations in the specified module.  The lowered operations are
+  /// erased once nothing uses them anymore.
+  LogicalResult lowerBody(FModuleOp module);
+
+  using FIRRTLVisitor<ModuleTypeLowering, LogicalResult>::visitExpr;
+  using FIRRTLVisitor<ModuleTypeLowering, LogicalResult>::visitDecl;
+  using FIRRTLVisitor<ModuleTypeLowering, LogicalResult>::visitStmt;
+
+  // Declarations.
+  LogicalResult visitDecl(WireOp op);
+  LogicalResult visitDecl(RegOp op);
+  LogicalResult visitDecl(RegInitOp op);
+  LogicalResult visitDecl(NodeOp op);
+  LogicalResult visitDecl(InstanceOp op);
+
+  // Expressions.
+  LogicalResult visitExpr(SubfieldOp op);
+  LogicalResult visitExpr(SubindexOp op);
+  LogicalResult visitExpr(SubaccessOp op);
+  LogicalResult visitExpr(MuxPrimOp op);
+  LogicalResult visitExpr(AsPassivePrimOp op) { return lowerCast(op); }
+  LogicalResult visitExpr(AsNonPassivePrimOp op) { return lowerCast(op); }
+
+  // Statements.
+  LogicalResult visitStmt(ConnectOp op) {
+    return lowerConnect(op, op.lhs(), op.rhs());
+  }
+  LogicalResult visitStmt(PartialConnectOp op) {
+    return lowerConnect(op, op.lhs(), op.rhs());
+  }
+  LogicalResult visitStmt(InvalidOp op);
+
+  LogicalResult visitUnhandledOp(Operation *op) {
+    return checkNoLoweredOperands(op);
+  }
+  LogicalResult visitInvalidOp(Operation *op) {
+    return checkNoLoweredOperands(op);
+  }
+
+private:
+  /// Return the values of the ground fields of the specified value.  Fields
+  /// of aggregates that are not lowered, e.g. memories, are extracted with
+  /// subfield and subindex operations.
+  ArrayRef<Value> getFields(Value value);
+
+  /// Return a name for a field of a declaration, or null if the declaration
+  /// has no name.
+  StringAttr getFieldName(StringAttr name, const FlatField &field);
+
+  /// Return the value cast to the specified type if it differs only in flips.
+  Value castIfNeeded(Value value, FIRRTLType type, Location loc);
+
+  /// Map the result of a subfield or subindex to a range of the fields of its
+  /// input.
+  void lowerSubelement(Operation *op, size_t offset);
+
+  LogicalResult lowerCast(Operation *op);
+  LogicalResult lowerConnect(Operation *op, Value lhs, Value rhs);
+  LogicalResult checkNoLoweredOperands(Operation *op);
+
+  FlatFieldCache &cache;
+  OpBuilder builder;
+
+  /// The values of the ground fields of each lowered value.  The vectors are
+  /// moved when the map grows, which keeps their elements in place.
+  DenseMap<Value, std::vector<Value>> loweredFields;
+
+  /// The lowered operations, in the order they were lowered.
+  SmallVector<Operation *, 16> opsToRemove;
+};
+} // end anonymous namespace
+
+LogicalResult ModuleTypeLowering::lowerBody(FModuleOp module) {
+  // Collect the operations first, lowering them inserts new ones.  Operations
+  // are visited in order, including the ones in the bodies of when's.
+  SmallVector<Operation *, 64> ops;
+  std::function<void(Block &)> collectOps = [&](Block &block) {
+    for (auto &op : block) {
+      ops.push_back(&op);
+      for (auto &region : op.getRegions())
+        for (auto &nestedBlock : region)
+          collectOps(nestedBlock);
+    }
+  };
+  collectOps(*module.getBodyBlock());
+
+  for (auto *op : ops) {
+    builder.setInsertionPoint(op);
+    if (failed(dispatchVisitor(op)))
+      return failure();
+  }
+
+  // Users are lowered after the values they use, erase them first.
+  while (!opsToRemove.empty())
+    opsToRemove.pop_back_val()->erase();
+  return success();
+}
+
+ArrayRef<Value> ModuleTypeLowering::getFields(Value value) {
+  auto it = loweredFields.find(value);
+  if (it != loweredFields.end())
+    return it->second;
+
+  auto type = getTypeOf(value);
+  std::vector<Value> fields;
+  if (!isAggregateType(type)) {
+    fields.push_back(value);
+  } else {
+    // Extract the elements right after the definition of the aggregate.
+    OpBuilder::InsertionGuard guard(builder);
+    if (auto *op = value.getDefiningOp())
+      builder.setInsertionPointAfter(op);
+    else
+      builder.setInsertionPointToStart(value.getParentBlock());
+
+    auto loc = value.getLoc();
+    if (auto bundle = stripFlip(type).dyn_cast<BundleType>()) {
+      for (auto &element : bundle.getElements()) {
+        auto elementType =
+            SubfieldOp::getResultType(type, element.first.strref());
+        auto subfield = builder.create<SubfieldOp>(
+            loc, elementType, value,
+            builder.getStringAttr(element.first.strref()));
+        auto elementFields = getFields(subfield);
+        fields.append(elementFields.begin(), elementFields.end());
+      }
+    } else {
+      auto vector = stripFlip(type).cast<FVectorType>();
+      for (unsigned i = 0, e = vector.getNumElements(); i != e; ++i) {
+        auto subindex = builder.create<SubindexOp>(
+            loc, SubindexOp::getResultType(type, i), value,
+            builder.getI32IntegerAttr(i));
+        auto elementFields = getFields(subindex);
+        fields.append(elementFields.begin(), elementFields.end());
+      }
+    }
+  }
+
+  return loweredFields[value] = std::move(fields);
+}
+
+StringAttr ModuleTypeLowering::getFieldName(StringAttr name,
+                                            const FlatField &field) {
+  if (!name)
+    return {};
+  return builder.getStringAttr(name.getValue() + field.suffix);
+}
+
+Value ModuleTypeLowering::castIfNeeded(Value value, FIRRTLType type,
+                                       Location loc) {
+  if (value.getType() == type)
+    return value;
+  if (type.isPassiveType())
+    return builder.create<AsPassivePrimOp>(loc, type, value);
+  return builder.create<AsNonPassivePrimOp>(loc, type, value);
+}
+
+LogicalResult ModuleTypeLowering::checkNoLoweredOperands(Operation *op) {
+  for (auto operand : op->getOperands()) {
+    auto type = operand.getType().dyn_cast<FIRRTLType>();
+    if (type && isAggregateType(type) && loweredFields.count(operand))
+      return op->emitOpError("cannot lower operand of aggregate type ")
+             << operand.getType();
+  }
+  return success();
+}
+
+//===----------------------------------------------------------------------===//
+// Declarations
+//===----------------------------------------------------------------------===//
+
+LogicalResult ModuleTypeLowering::visitDecl(WireOp op) {
+  auto type = getTypeOf(op.result());
+  if (!isAggregateType(type))
+    return success();
+
+  SmallVector<Value, 8> fields;
+  for (auto &field : cache.getFields(type))
+    fields.push_back(builder.create<WireOp>(
+        op.getLoc(), field.type, getFieldName(op.nameAttr(), field)));
+  setLowering(op, fields);
+  opsToRemove.push_back(op);
+  return success();
+}
+
+LogicalResult ModuleTypeLowering::visitDecl(RegOp op) {
+  auto type = getTypeOf(op.result());
+  if (!isAggregateType(type))
+    return success();
+
+  SmallVector<Value, 8> fields;
+  for (auto &field : cache.getFields(type))
+    fields.push_back(builder.create<RegOp>(
+        op.getLoc(), field.type, op.clockVal(),
+        getFieldName(op.nameAttr(), field)));
+  setLowering(op, fields);
+  opsToRemove.push_back(op);
+  return success();
+}
+
+LogicalResult ModuleTypeLowering::visitDecl(RegInitOp op) {
+  auto type = getTypeOf(op.result());
+  if (!isAggregateType(type))
+    return success();
+
+  auto resetValues = getFields(op.resetValue());
+  SmallVector<Value, 8> fields;
+  for (auto it : llvm::enumerate(cache.getFields(type))) {
+    auto &field = it.value();
+    auto resetValue =
+        castIfNeeded(resetValues[it.index()], field.type, op.getLoc());
+    fields.push_back(builder.create<RegInitOp>(
+        op.getLoc(), field.type, op.clockVal(), op.resetSignal(), resetValue,
+        getFieldName(op.nameAttr(), field)));
+  }
+  setLowering(op, fields);
+  opsToRemove.push_back(op);
+  return success();
+}
+
+LogicalResult ModuleTypeLowering::visitDecl(NodeOp op) {
+  auto type = getTypeOf(op.result());
+  if (!isAggregateType(type))
+    return success();
+
+  auto inputs = getFields(op.input());
+  SmallVector<Value, 8> fields;
+  for (auto it : llvm::enumerate(cache.getFields(type))) {
+    auto input =
+        castIfNeeded(inputs[it.index()], it.value().type, op.getLoc());
+    fields.push_back(builder.create<NodeOp>(
+        op.getLoc(), input, getFieldName(op.nameAttr(), it.value())));
+  }
+  setLowering(op, fields);
+  opsToRemove.push_back(op);
+  return success();
+}
+
+/// The result of an instance is a bundle of the ports of the module, which
+/// becomes a bundle of the lowered ports.  Those are named like the ports of
+/// the lowered module.
+LogicalResult ModuleTypeLowering::visitDecl(InstanceOp op) {
+  auto type = getTypeOf(op.result());
+  auto flatFields = cache.getFields(type);
+
+  SmallVector<BundleType::BundleElement, 8> elements;
+  elements.reserve(flatFields.size());
+  for (auto &field : flatFields)
+    elements.push_back(
+        {builder.getIdentifier(StringRef(field.suffix).drop_front()),
+         field.getValueType()});
+  auto newType = BundleType::get(elements, op.getContext());
+  if (newType == type)
+    return success();
+
+  auto newInstance = builder.create<InstanceOp>(op.getLoc(), newType,
+                                                op.moduleNameAttr(),
+                                                op.nameAttr());
+  SmallVector<Value, 8> fields;
+  for (auto &element : elements)
+    fields.push_back(builder.create<SubfieldOp>(
+        op.getLoc(), element.second, newInstance,
+        builder.getStringAttr(element.first.strref())));
+  setLowering(op, fields);
+  opsToRemove.push_back(op);
+  return success();
+}
+
+//===----------------------------------------------------------------------===//
+// Expressions
+//===----------------------------------------------------------------------===//
+
+void ModuleTypeLowering::lowerSubelement(Operation *op, size_t offset) {
+  Value result = op->getResult(0);
+  auto resultType = getTypeOf(result);
+  auto numFields = cache.getFields(resultType).size();
+  auto fields = getFields(op->getOperand(0)).slice(offset, numFields);
+
+  if (isAggregateType(resultType))
+    setLowering(result, fields);
+  else
+    result.replaceAllUsesWith(
+        castIfNeeded(fields.front(), resultType, op->getLoc()));
+  opsToRemove.push_back(op);
+}
+
+LogicalResult ModuleTypeLowering::visitExpr(SubfieldOp op) {
+  // Subfields of aggregates that are not lowered, e.g. memories, are kept.
+  if (!loweredFields.count(op.input()))
+    return success();
+  lowerSubelement(op, cache.getFieldOffset(getTypeOf(op.input()),
+                                           op.fieldname()));
+  return success();
+}
+
+LogicalResult ModuleTypeLowering::visitExpr(SubindexOp op) {
+  if (!loweredFields.count(op.input()))
+    return success();
+  lowerSubelement(op, cache.getFieldOffset(getTypeOf(op.input()), op.index()));
+  return success();
+}
+
+LogicalResult ModuleTypeLowering::visitExpr(SubaccessOp op) {
+  if (!loweredFields.count(op.input()))
+    return success();
+  return op.emitOpError("cannot lower a dynamic access to a vector, it has to "
+                        "be removed before lowering types");
+}
+
+LogicalResult ModuleTypeLowering::visitExpr(MuxPrimOp op) {
+  auto type = getTypeOf(op.result());
+  if (!isAggregateType(type))
+    return success();
+
+  auto highs = getFields(op.high());
+  auto lows = getFields(op.low());
+  SmallVector<Value, 8> fields;
+  for (auto it : llvm::enumerate(cache.getFields(type))) {
+    auto fieldType = it.value().type;
+    auto high = castIfNeeded(highs[it.index()], fieldType, op.getLoc());
+    auto low = castIfNeeded(lows[it.index()], fieldType, op.getLoc());
+    fields.push_back(builder.create<MuxPrimOp>(op.getLoc(), fieldType,
+                                               op.sel(), high, low));
+  }
+  setLowering(op, fields);
+  opsToRemove.push_back(op);
+  return success();
+}
+
+/// Casts between passive and non-passive aggregates cast each field.
+LogicalResult ModuleTypeLowering::lowerCast(Operation *op) {
+  Value result = op->getResult(0);
+  auto type = getTypeOf(result);
+  if (!isAggregateType(type))
+    return success();
+
+  auto inputs = getFields(op->getOperand(0));
+  SmallVector<Value, 8> fields;
+  for (auto it : llvm::enumerate(cache.getFields(type)))
+    fields.push_back(castIfNeeded(inputs[it.index()],
+                                  it.value().getValueType(), op->getLoc()));
+  setLowering(result, fields);
+  opsToRemove.push_back(op);
+  return success();
+}
+
+//===----------------------------------------------------------------------===//
+// Statements
+//===----------------------------------------------------------------------===//
+
+/// Return true if the specified ground field is driven from within the
+/// module, false if it drives the module, and None if it can go either way.
+/// Ports and instances are flipped where they are driven, the read data of
+/// memories is flipped where it is read.  The fields of wires and registers
+/// can go either way.
+static Optional<bool> isSinkField(Value field) {
+  bool isFlipped = getTypeOf(field).isa<FlipType>();
+  Value root = field;
+  while (auto *op = root.getDefiningOp()) {
+    if (isa<InstanceOp>(op))
+      return isFlipped;
+    if (isa<MemOp>(op))
+      return !isFlipped;
+    if (!isa<SubfieldOp>(op) && !isa<SubindexOp>(op))
+      return None;
+    root = op->getOperand(0);
+  }
+  return isFlipped;
+}
+
+/// Connects between aggregates are split into one connect per ground field.
+/// A field that is flipped within the aggregates is connected in the other
+/// direction.  Partial connects only connect the fields both sides have.
+LogicalResult ModuleTypeLowering::lowerConnect(Operation *op, Value lhs,
+                                               Value rhs) {
+  auto lhsType = getTypeOf(lhs), rhsType = getTypeOf(rhs);
+  if (!isAggregateType(lhsType) && !isAggregateType(rhsType))
+    return success();
+
+  // The outermost flip of an operand tells how it is used within its
+  // aggregate, it does not affect the direction of the connect.
+  auto lhsFlatFields = cache.getFields(stripFlip(lhsType));
+  auto rhsFlatFields = cache.getFields(stripFlip(rhsType));
+  auto lhsFields = getFields(lhs), rhsFields = getFields(rhs);
+  bool isPartial = isa<PartialConnectOp>(op);
+
+  auto connect = [&](size_t lhsIndex, size_t rhsIndex) {
+    Value dest = lhsFields[lhsIndex], src = rhsFields[rhsIndex];
+    bool isReversed;
+    if (auto isSink = isSinkField(dest))
+      isReversed = !*isSink;
+    else if (auto isSink = isSinkField(src))
+      isReversed = *isSink;
+    else
+      isReversed = lhsFlatFields[lhsIndex].isFlipped;
+    if (isReversed)
+      std::swap(dest, src);
+
+    if (isPartial)
+      builder.create<PartialConnectOp>(op->getLoc(), dest, src);
+    else
+      builder.create<ConnectOp>(op->getLoc(), dest, src);
+  };
+
+  if (isPartial) {
+    llvm::StringMap<size_t> rhsIndices;
+    for (auto it : llvm::enumerate(rhsFlatFields))
+      rhsIndices.try_emplace(it.value().suffix, it.index());
+    for (auto it : llvm::enumerate(lhsFlatFields)) {
+      auto rhsIndex = rhsIndices.find(it.value().suffix);
+      if (rhsIndex != rhsIndices.end())
+        connect(it.index(), rhsIndex->second);
+    }
+  } else {
+    if (lhsFields.size() != rhsFields.size())
+      return op->emitOpError("cannot connect aggregates with a different "
+                             "number of fields");
+    for (size_t i = 0, e = lhsFields.size(); i != e; ++i)
+      connect(i, i);
+  }
+
+  opsToRemove.push_back(op);
+  return success();
+}
+
+LogicalResult ModuleTypeLowering::visitStmt(InvalidOp op) {
+  if (!isAggregateType(getTypeOf(op.operand())))
+    return success();
+
+  for (auto field : getFields(op.operand()))
+    builder.create<InvalidOp>(op.getLoc(), field);
+  opsToRemove.push_back(op);
+  return success();
+}
+
+//===----------------------------------------------------------------------===//
+// Pass Infrastructure
+//===----------------------------------------------------------------------===//
+
+namespace {
+struct LowerTypesPass : public LowerFIRRTLTypesBase<LowerTypesPass> {
+  void runOnOperation() override;
+
+private:
+  /// Replace the aggregate ports of a module or extmodule with their ground
+  /// fields.  The fields of the ports of a module are recorded in the
+  /// lowering of its body.  Return the number of ports before lowering.
+  size_t lowerPorts(Operation *module, FlatFieldCache &cache,
+                    ModuleTypeLowering *lowering);
+};
+} // end anonymous namespace
+
+/// This is the pass constructor.
+std::unique_ptr<mlir::Pass> circt::firrtl::createLowerFIRRTLTypesPass() {
+  return std::make_unique<LowerTypesPass>();
+}
+
+void LowerTypesPass::runOnOperation() {
+  FlatFieldCache cache;
+  auto *circuitBody = getOperation().getBody();
+  for (auto &op : *circuitBody) {
+    if (isa<FExtModuleOp>(op)) {
+      lowerPorts(&op, cache, nullptr);
+      continue;
+    }
+
+    auto module = dyn_cast<FModuleOp>(op);
+    if (!module)
+      continue;
+
+    ModuleTypeLowering lowering(cache, &getContext());
+    size_t numOldPorts = lowerPorts(module, cache, &lowering);
+    if (failed(lowering.lowerBody(module)))
+      return signalPassFailure();
+
+    // Nothing uses the aggregate ports anymore.
+    Block *body = module.getBodyBlock();
+    for (size_t i = 0; i != numOldPorts; ++i)
+      body->eraseArgument(0);
+  }
+}
+
+size_t LowerTypesPass::lowerPorts(Operation *module, FlatFieldCache &cache,
+                                  ModuleTypeLowering *lowering) {
+  SmallVector<ModulePortInfo, 8> ports;
+  getModulePortInfo(module, ports);
+  if (llvm::none_of(ports, [](const ModulePortInfo &port) {
+        return isAggregateType(port.second);
+      }))
+    return 0;
+
+  using namespace mlir::impl;
+  auto *context = module->getContext();
+  auto nameId = Identifier::get("firrtl.name", context);
+  SmallVector<Type, 8> newTypes;
+  SmallVector<DictionaryAttr, 8> newAttrs;
+  SmallVector<Value, 8> fields;
+  Block *body = lowering ? cast<FModuleOp>(module).getBodyBlock() : nullptr;
+  auto oldTypes = getModuleType(module).getInputs();
+  for (auto it : llvm::enumerate(ports)) {
+    // Ground ports are kept as they are.
+    auto oldAttrs = getArgAttrs(module, it.index());
+    if (!isAggregateType(it.value().second)) {
+      auto type = oldTypes[it.index()];
+      newTypes.push_back(type);
+      newAttrs.push_back(oldAttrs.empty()
+                             ? DictionaryAttr()
+                             : DictionaryAttr::get(oldAttrs, context));
+      if (body)
+        body->getArgument(it.index())
+            .replaceAllUsesWith(body->addArgument(type));
+      continue;
+    }
+
+    // Keep any attributes other than the name of the port.
+    SmallVector<NamedAttribute, 4> attrs;
+    for (auto attr : oldAttrs)
+      if (attr.first != nameId)
+        attrs.push_back(attr);
+
+    fields.clear();
+    auto name = it.value().first;
+    for (auto &field : cache.getFields(it.value().second)) {
+      auto type = field.getValueType();
+      newTypes.push_back(type);
+      if (name) {
+        auto fieldName = (name.getValue() + field.suffix).str();
+        attrs.push_back({nameId, StringAttr::get(fieldName, context)});
+        newAttrs.push_back(DictionaryAttr::get(attrs, context));
+        attrs.pop_back();
+      } else {
+        newAttrs.push_back(attrs.empty() ? DictionaryAttr()
+                                         : DictionaryAttr::get(attrs, context));
+      }
+      if (body)
+        fields.push_back(body->addArgument(type));
+    }
+
+    if (body)
+      lowering->setLowering(body->getArgument(it.index()), fields);
+  }
+
+  SmallString<8> attrNameBuf;
+  for (size_t i = 0, e = ports.size(); i != e; ++i)
+    module->removeAttr(
+        Identifier::get(getArgAttrName(i, attrNameBuf), context));
+  for (auto it : llvm::enumerate(newAttrs))
+    if (it.value())
+      module->setAttr(getArgAttrName(it.index(), attrNameBuf), it.value());
+  module->setAttr(FModuleOp::getTypeAttrName(),
+                  TypeAttr::get(FunctionType::get(newTypes, {}, context)));
+  return ports.size();
+}
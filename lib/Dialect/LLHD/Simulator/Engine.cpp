@@ -21,9 +21,10 @@ using namespace mlir;
 using namespace circt::llhd::sim;
 
 Engine::Engine(llvm::raw_ostream &out, ModuleOp module, MLIRContext &context,
-               std::string root)
+               std::string root, uint64_t sparseThreshold)
     : out(out), root(root) {
   state = std::make_unique<State>();
+  state->sparseThreshold = sparseThreshold;
 
   buildLayout(module);
 
@@ -80,6 +81,11 @@ int Engine::simulate(int n) {
 
   int i = 0;
 
+  // Buffer reused across steps to hold the pre-update signal bytes.
+  SmallVector<uint8_t, 64> scratch;
+  // The elements of a sparse signal changed in the current step.
+  SmallVector<uint64_t, 8> changedElements;
+
   // Keep track of the instances that need to wakeup.
   llvm::SmallSet<std::string, 8> wakeupQueue;
   // All instances are run in the first cycle.
@@ -98,29 +104,18 @@ int Engine::simulate(int n) {
 
     // Apply the signal changes and dump the signals that actually changed
     // value.
-    for (auto change : pop.changes) {
-      // Get a buffer to apply the changes on.
-      Signal *curr = &(state->signals[change.first]);
-      APInt buff(
-          curr->size * 8,
-          ArrayRef<uint64_t>(reinterpret_cast<uint64_t *>(curr->value.get()),
-                             curr->size));
-
-      // Apply all the changes to the buffer, in order of execution.
-      for (auto drive : change.second) {
-        if (drive.second.getBitWidth() < buff.getBitWidth())
-          buff.insertBits(drive.second, drive.first);
-        else
-          buff = drive.second;
-      }
-
-      // Skip if the updated signal value is equal to the initial value.
-      if (std::memcmp(curr->value.get(), buff.getRawData(), curr->size) == 0)
+    for (auto &change : pop.changes) {
+      // Apply the changes in place and skip the signal if its value did not
+      // change.
+      Signal &curr = state->signals[change.first];
+      if (curr.isSparse()) {
+        changedElements.clear();
+        curr.applySparseDrives(change.second, scratch, changedElements);
+        if (changedElements.empty())
+          continue;
+      } else if (curr.applyDrives(change.second, scratch).empty()) {
         continue;
-
-      // Apply the signal update.
-      std::memcpy(curr->value.get(), buff.getRawData(),
-                  state->signals[change.first].size);
+      }
 
       // Add sensitive instances.
       for (auto inst : state->signals[change.first].triggers) {
@@ -142,8 +137,12 @@ int Engine::simulate(int n) {
         wakeupQueue.insert(inst);
       }
 
-      // Dump the updated signal.
-      state->dumpSignal(out, change.first);
+      // Dump the updated signal, or only its changed elements if it is stored
+      // sparsely.
+      if (curr.isSparse())
+        state->dumpSignalElements(out, change.first, changedElements);
+      else
+        state->dumpSignal(out, change.first);
     }
 
     // Add scheduled process resumes to the wakeup queue.
@@ -217,6 +216,8 @@ void Engine::walkEntity(EntityOp entity, Instance &child) {
     // Add a signal to the signal table.
     if (auto sig = dyn_cast<SigOp>(op)) {
       uint64_t index = state->addSignal(sig.name().str(), child.name);
+      if (auto arrTy = sig.init().getType().dyn_cast<ArrayType>())
+        state->signals[index].numElements = arrTy.getLength();
       child.sensitivityList.push_back(
           SignalDetail({nullptr, 0, child.sensitivityList.size(), index}));
     }
@@ -0,0 +1,298 @@
+//===- SignalKernels.cpp - Signal storage update kernels --------*- C++ -*-===//
+//
+// This file implements the kernels used to apply drives to signal storage and
+// to detect changed bytes, together with the runtime dispatch between the
+// vectorized and the scalar implementations.
+//
+//===----------------------------------------------------------------------===//
+
+#include "SignalKernels.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define LLHD_SIM_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+using namespace circt::llhd::sim;
+
+//===----------------------------------------------------------------------===//
+// ByteRange
+//===----------------------------------------------------------------------===//
+
+void ByteRange::merge(const ByteRange &other) {
+  if (other.empty())
+    return;
+  if (empty()) {
+    *this = other;
+    return;
+  }
+  begin = std::min(begin, other.begin);
+  end = std::max(end, other.end);
+}
+
+//===----------------------------------------------------------------------===//
+// Scalar kernels
+//===----------------------------------------------------------------------===//
+
+/// Return byte `k` of the bit stream obtained by shifting `src` left by
+/// `shift` bits (0 <= shift < 8).
+static inline uint8_t getShiftedByte(const uint8_t *src, uint64_t srcBytes,
+                                     uint64_t k, unsigned shift) {
+  unsigned curr = k < srcBytes ? src[k] : 0;
+  if (shift == 0)
+    return curr;
+  unsigned prev = (k > 0 && k - 1 < srcBytes) ? src[k - 1] : 0;
+  return static_cast<uint8_t>((curr << shift) | (prev >> (8 - shift)));
+}
+
+/// Write bytes [begin, end) of the shifted source stream to `out`.
+static void shiftCopyScalar(uint8_t *out, const uint8_t *src, uint64_t srcBytes,
+                            uint64_t begin, uint64_t end, unsigned shift) {
+  for (uint64_t k = begin; k < end; ++k)
+    out[k] = getShiftedByte(src, srcBytes, k, shift);
+}
+
+static uint64_t findFirstDiffScalar(const uint8_t *lhs, const uint8_t *rhs,
+                                    uint64_t size) {
+  uint64_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    uint64_t a, b;
+    std::memcpy(&a, lhs + i, 8);
+    std::memcpy(&b, rhs + i, 8);
+    if (a != b)
+      break;
+  }
+  for (; i < size; ++i)
+    if (lhs[i] != rhs[i])
+      return i;
+  return size;
+}
+
+static uint64_t findLastDiffScalar(const uint8_t *lhs, const uint8_t *rhs,
+                                   uint64_t size) {
+  uint64_t i = size;
+  for (; i >= 8; i -= 8) {
+    uint64_t a, b;
+    std::memcpy(&a, lhs + i - 8, 8);
+    std::memcpy(&b, rhs + i - 8, 8);
+    if (a != b)
+      break;
+  }
+  for (; i > 0; --i)
+    if (lhs[i - 1] != rhs[i - 1])
+      return i;
+  return 0;
+}
+
+//===----------------------------------------------------------------------===//
+// x86 kernels
+//===----------------------------------------------------------------------===//
+
+#ifdef LLHD_SIM_X86_KERNELS
+
+__attribute__((target("sse2"))) static void
+shiftCopySSE2(uint8_t *out, const uint8_t *src, uint64_t srcBytes,
+              uint64_t begin, uint64_t end, unsigned shift) {
+  uint64_t k = begin;
+  // Every vector iteration reads src[k - 1, k + 16), so it may only run while
+  // the whole window lies inside the source buffer.
+  if (k > 0) {
+    __m128i lo = _mm_cvtsi32_si128(shift);
+    __m128i hi = _mm_cvtsi32_si128(8 - shift);
+    for (; k + 16 <= end && k + 16 <= srcBytes; k += 16) {
+      __m128i curr =
+          _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + k));
+      __m128i prev =
+          _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + k - 1));
+      __m128i res = shift == 0 ? curr
+                               : _mm_or_si128(_mm_sll_epi64(curr, lo),
+                                              _mm_srl_epi64(prev, hi));
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(out + k), res);
+    }
+  }
+  shiftCopyScalar(out, src, srcBytes, k, end, shift);
+}
+
+__attribute__((target("avx2"))) static void
+shiftCopyAVX2(uint8_t *out, const uint8_t *src, uint64_t srcBytes,
+              uint64_t begin, uint64_t end, unsigned shift) {
+  uint64_t k = begin;
+  if (k > 0) {
+    __m128i lo = _mm_cvtsi32_si128(shift);
+    __m128i hi = _mm_cvtsi32_si128(8 - shift);
+    for (; k + 32 <= end && k + 32 <= srcBytes; k += 32) {
+      __m256i curr =
+          _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + k));
+      __m256i prev =
+          _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + k - 1));
+      __m256i res = shift == 0 ? curr
+                               : _mm256_or_si256(_mm256_sll_epi64(curr, lo),
+                                                 _mm256_srl_epi64(prev, hi));
+      _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + k), res);
+    }
+  }
+  shiftCopySSE2(out, src, srcBytes, k, end, shift);
+}
+
+__attribute__((target("sse2"))) static uint64_t
+findFirstDiffSSE2(const uint8_t *lhs, const uint8_t *rhs, uint64_t size) {
+  uint64_t i = 0;
+  for (; i + 16 <= size; i += 16) {
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(lhs + i));
+    __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(rhs + i));
+    unsigned diff = ~_mm_movemask_epi8(_mm_cmpeq_epi8(a, b)) & 0xffffu;
+    if (diff)
+      return i + __builtin_ctz(diff);
+  }
+  uint64_t rest = findFirstDiffScalar(lhs + i, rhs + i, size - i);
+  return i + rest;
+}
+
+__attribute__((target("sse2"))) static uint64_t
+findLastDiffSSE2(const uint8_t *lhs, const uint8_t *rhs, uint64_t size) {
+  uint64_t i = size;
+  for (; i >= 16; i -= 16) {
+    __m128i a =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(lhs + i - 16));
+    __m128i b =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(rhs + i - 16));
+    unsigned diff = ~_mm_movemask_epi8(_mm_cmpeq_epi8(a, b)) & 0xffffu;
+    if (diff)
+      return i - 16 + (32 - __builtin_clz(diff));
+  }
+  return findLastDiffScalar(lhs, rhs, i);
+}
+
+__attribute__((target("avx2"))) static uint64_t
+findFirstDiffAVX2(const uint8_t *lhs, const uint8_t *rhs, uint64_t size) {
+  uint64_t i = 0;
+  for (; i + 32 <= size; i += 32) {
+    __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(lhs + i));
+    __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(rhs + i));
+    unsigned diff =
+        ~static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, b)));
+    if (diff)
+      return i + __builtin_ctz(diff);
+  }
+  return i + findFirstDiffSSE2(lhs + i, rhs + i, size - i);
+}
+
+__attribute__((target("avx2"))) static uint64_t
+findLastDiffAVX2(const uint8_t *lhs, const uint8_t *rhs, uint64_t size) {
+  uint64_t i = size;
+  for (; i >= 32; i -= 32) {
+    __m256i a =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(lhs + i - 32));
+    __m256i b =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(rhs + i - 32));
+    unsigned diff =
+        ~static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, b)));
+    if (diff)
+      return i - 32 + (32 - __builtin_clz(diff));
+  }
+  return findLastDiffSSE2(lhs, rhs, i);
+}
+
+#endif // LLHD_SIM_X86_KERNELS
+
+//===----------------------------------------------------------------------===//
+// Runtime dispatch
+//===----------------------------------------------------------------------===//
+
+namespace {
+/// The set of kernels selected for the host the simulator is running on.
+struct KernelSet {
+  const char *name;
+  void (*shiftCopy)(uint8_t *, const uint8_t *, uint64_t, uint64_t, uint64_t,
+                    unsigned);
+  /// Return the index of the first differing byte, or size if none differs.
+  uint64_t (*findFirstDiff)(const uint8_t *, const uint8_t *, uint64_t);
+  /// Return one past the index of the last differing byte, or 0 if none
+  /// differs.
+  uint64_t (*findLastDiff)(const uint8_t *, const uint8_t *, uint64_t);
+};
+} // namespace
+
+static KernelSet selectKernels() {
+#ifdef LLHD_SIM_X86_KERNELS
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    return {"avx2", shiftCopyAVX2, findFirstDiffAVX2, findLastDiffAVX2};
+  if (__builtin_cpu_supports("sse2"))
+    return {"sse2", shiftCopySSE2, findFirstDiffSSE2, findLastDiffSSE2};
+#endif
+  return {"scalar", shiftCopyScalar, findFirstDiffScalar, findLastDiffScalar};
+}
+
+static const KernelSet &getKernels() {
+  static const KernelSet kernels = selectKernels();
+  return kernels;
+}
+
+const char *circt::llhd::sim::getSignalKernelsName() {
+  return getKernels().name;
+}
+
+//===----------------------------------------------------------------------===//
+// Kernel entry points
+//===----------------------------------------------------------------------===//
+
+void circt::llhd::sim::insertBits(uint8_t *dst, uint64_t bitOffset,
+                                  const uint8_t *src, uint64_t srcBytes,
+                                  uint64_t width) {
+  if (width == 0)
+    return;
+
+  unsigned shift = bitOffset % 8;
+  uint64_t numBytes = (shift + width + 7) / 8;
+  uint8_t *out = dst + bitOffset / 8;
+
+  // The slice fits into a single byte.
+  if (numBytes == 1) {
+    uint8_t mask = static_cast<uint8_t>(((1u << width) - 1) << shift);
+    uint8_t val = getShiftedByte(src, srcBytes, 0, shift);
+    out[0] = (out[0] & ~mask) | (val & mask);
+    return;
+  }
+
+  // Merge the partially covered first and last byte, and copy the fully
+  // covered bytes in between.
+  uint8_t headMask = static_cast<uint8_t>(0xff << shift);
+  uint8_t head = getShiftedByte(src, srcBytes, 0, shift);
+  unsigned tailBits = (shift + width) % 8;
+  uint8_t tailMask =
+      tailBits ? static_cast<uint8_t>((1u << tailBits) - 1) : uint8_t(0xff);
+  uint8_t tail = getShiftedByte(src, srcBytes, numBytes - 1, shift);
+
+  if (shift == 0) {
+    uint64_t body = std::min(numBytes - 1, srcBytes);
+    std::memcpy(out, src, body);
+    if (body < numBytes - 1)
+      std::memset(out + body, 0, numBytes - 1 - body);
+  } else {
+    getKernels().shiftCopy(out, src, srcBytes, 1, numBytes - 1, shift);
+  }
+
+  out[0] = (out[0] & ~headMask) | (head & headMask);
+  out[numBytes - 1] = (out[numBytes - 1] & ~tailMask) | (tail & tailMask);
+}
+
+ByteRange circt::llhd::sim::findChangedBytes(const uint8_t *lhs,
+                                             const uint8_t *rhs,
+                                             uint64_t size) {
+  auto &kernels = getKernels();
+  uint64_t first = kernels.findFirstDiff(lhs, rhs, size);
+  if (first == size)
+    return ByteRange();
+  uint64_t last = kernels.findLastDiff(lhs + first, rhs + first, size - first);
+  return ByteRange(first, first + last);
+}
+
+uint64_t circt::llhd::sim::findFirstChangedByte(const uint8_t *lhs,
+                                                const uint8_t *rhs,
+                                                uint64_t size) {
+  return getKernels().findFirstDiff(lhs, rhs, size);
+}
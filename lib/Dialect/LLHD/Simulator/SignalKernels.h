@@ -0,0 +1,69 @@
+//===- SignalKernels.h - Signal storage update kernels ----------*- C++ -*-===//
+//
+// Defines the low-level kernels used by the LLHD simulator to apply drives to
+// the raw storage of a signal and to detect which bytes of a signal changed.
+// Vectorized implementations (AVX2, SSE2) are selected at runtime when the host
+// supports them, with a portable scalar fallback.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef CIRCT_DIALECT_LLHD_SIMULATOR_SIGNALKERNELS_H
+#define CIRCT_DIALECT_LLHD_SIMULATOR_SIGNALKERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace circt {
+namespace llhd {
+namespace sim {
+
+/// A half-open range of bytes [begin, end) within a signal's storage.
+struct ByteRange {
+  ByteRange() = default;
+  ByteRange(uint64_t begin, uint64_t end) : begin(begin), end(end) {}
+
+  /// Return true if the range does not contain any byte.
+  bool empty() const { return begin >= end; }
+
+  /// Extend the range to also cover the given range.
+  void merge(const ByteRange &other);
+
+  uint64_t begin = 0;
+  uint64_t end = 0;
+};
+
+/// Insert the `width` least-significant bits of `src` into `dst`, starting at
+/// bit `bitOffset` of `dst`. Bits of `dst` outside the inserted slice are left
+/// untouched. `src` is read as a little-endian bit stream of `srcBytes` bytes;
+/// bits past the end of `src` are treated as zero.
+void insertBits(uint8_t *dst, uint64_t bitOffset, const uint8_t *src,
+                uint64_t srcBytes, uint64_t width);
+
+/// Return the range of bytes that are touched when inserting a slice of
+/// `width` bits at `bitOffset`.
+inline ByteRange getAffectedBytes(uint64_t bitOffset, uint64_t width) {
+  if (width == 0)
+    return ByteRange();
+  return ByteRange(bitOffset / 8, (bitOffset + width + 7) / 8);
+}
+
+/// Compare `size` bytes of `lhs` and `rhs` and return the smallest range
+/// containing every byte that differs. The returned range is relative to the
+/// start of the buffers and empty if both buffers hold the same content.
+ByteRange findChangedBytes(const uint8_t *lhs, const uint8_t *rhs,
+                           uint64_t size);
+
+/// Return the index of the first byte that differs between `lhs` and `rhs`, or
+/// `size` if both buffers hold the same content.
+uint64_t findFirstChangedByte(const uint8_t *lhs, const uint8_t *rhs,
+                              uint64_t size);
+
+/// Return the name of the kernel implementation selected for this host, for
+/// debugging purposes.
+const char *getSignalKernelsName();
+
+} // namespace sim
+} // namespace llhd
+} // namespace circt
+
+#endif // CIRCT_DIALECT_LLHD_SIMULATOR_SIGNALKERNELS_H
@@ -7,9 +7,12 @@
 
 #include "State.h"
 
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/Support/Format.h"
+#include "llvm/Support/Process.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include <algorithm>
 #include <string>
 
 using namespace llvm;
@@ -46,6 +49,25 @@ std::string Time::dump() {
   return ss.str();
 }
 
+//===----------------------------------------------------------------------===//
+// SparseStorage
+//===----------------------------------------------------------------------===//
+
+SparseStorage::SparseStorage(uint64_t size)
+    : pageSize(sys::Process::getPageSizeEstimate()) {
+  // Reserve twice the required space, as done for dense signals, to make sure
+  // signal shifts do not read past the mapping.
+  std::error_code ec;
+  block = sys::Memory::allocateMappedMemory(
+      2 * size, nullptr, sys::Memory::MF_READ | sys::Memory::MF_WRITE, ec);
+  if (ec)
+    report_fatal_error(Twine("failed to allocate sparse signal storage: ") +
+                       ec.message());
+  written.resize(divideCeil(size, pageSize));
+}
+
+SparseStorage::~SparseStorage() { sys::Memory::releaseMappedMemory(block); }
+
 //===----------------------------------------------------------------------===//
 // Signal
 //===----------------------------------------------------------------------===//
@@ -60,7 +82,7 @@ Signal::Signal(std::string name, std::string owner, uint8_t *value,
 bool Signal::operator==(const Signal &rhs) const {
   if (owner != rhs.owner || name != rhs.name || size != rhs.size)
     return false;
-  return std::memcmp(value.get(), rhs.value.get(), size);
+  return std::memcmp(getValue(), rhs.getValue(), size);
 }
 
 bool Signal::operator<(const Signal &rhs) const {
@@ -76,11 +98,162 @@ std::string Signal::dump() {
   raw_string_ostream ss(ret);
   ss << "0x";
   for (int i = size - 1; i >= 0; --i) {
-    ss << format_hex_no_prefix(static_cast<int>(value.get()[i]), 2);
+    ss << format_hex_no_prefix(static_cast<int>(getValue()[i]), 2);
+  }
+  return ss.str();
+}
+
+std::string Signal::dumpElement(uint64_t index) {
+  std::string ret;
+  raw_string_ostream ss(ret);
+  uint64_t elementSize = getElementSize();
+  const uint8_t *elem = getValue() + index * elementSize;
+  ss << "0x";
+  for (int i = elementSize - 1; i >= 0; --i) {
+    ss << format_hex_no_prefix(static_cast<int>(elem[i]), 2);
   }
   return ss.str();
 }
 
+/// Return the (offset, width) slice of a signal of the given width a drive
+/// covers. A drive at least as wide as the signal replaces the whole value.
+static std::pair<uint64_t, uint64_t>
+getDriveSlice(const std::pair<int, APInt> &drive, uint64_t sizeInBits) {
+  uint64_t width = drive.second.getBitWidth();
+  if (width >= sizeInBits)
+    return std::make_pair(uint64_t(0), sizeInBits);
+  uint64_t offset = std::min<uint64_t>(drive.first, sizeInBits);
+  return std::make_pair(offset, std::min(width, sizeInBits - offset));
+}
+
+ByteRange Signal::applyDrives(ArrayRef<std::pair<int, APInt>> drives,
+                              SmallVectorImpl<uint8_t> &scratch) {
+  uint64_t sizeInBits = size * 8;
+
+  // Save the bytes covered by the drives, such that the changes can be applied
+  // in place and compared afterwards.
+  ByteRange affected;
+  for (auto &drive : drives) {
+    auto slice = getDriveSlice(drive, sizeInBits);
+    affected.merge(getAffectedBytes(slice.first, slice.second));
+  }
+  if (affected.empty())
+    return affected;
+
+  uint8_t *data = getValue();
+  scratch.assign(data + affected.begin, data + affected.end);
+
+  // Apply all the changes, in order of execution.
+  for (auto &drive : drives) {
+    auto slice = getDriveSlice(drive, sizeInBits);
+    const APInt &bits = drive.second;
+    insertBits(data, slice.first,
+               reinterpret_cast<const uint8_t *>(bits.getRawData()),
+               bits.getNumWords() * sizeof(uint64_t), slice.second);
+  }
+
+  ByteRange changed = findChangedBytes(
+      scratch.data(), data + affected.begin, affected.end - affected.begin);
+  if (changed.empty())
+    return changed;
+  return ByteRange(affected.begin + changed.begin,
+                   affected.begin + changed.end);
+}
+
+void Signal::applySparseDrives(ArrayRef<std::pair<int, APInt>> drives,
+                               SmallVectorImpl<uint8_t> &scratch,
+                               SmallVectorImpl<uint64_t> &changedElements) {
+  assert(isSparse() && "expected a sparse signal");
+  uint64_t sizeInBits = size * 8;
+  uint64_t pageSize = sparse->getPageSize();
+  uint8_t *data = getValue();
+
+  // Save the old content of a page to the scratch buffer, the first time it is
+  // about to be written to.
+  DenseMap<uint64_t, unsigned> savedPages;
+  scratch.clear();
+  auto savePage = [&](uint64_t page) {
+    if (!savedPages.insert({page, savedPages.size()}).second)
+      return;
+    uint64_t begin = page * pageSize;
+    uint64_t end = std::min(begin + pageSize, size);
+    scratch.resize(savedPages.size() * pageSize);
+    std::memcpy(scratch.data() + (savedPages.size() - 1) * pageSize,
+                data + begin, end - begin);
+  };
+
+  for (auto &drive : drives) {
+    auto slice = getDriveSlice(drive, sizeInBits);
+    ByteRange bytes = getAffectedBytes(slice.first, slice.second);
+    if (bytes.empty())
+      continue;
+    const uint8_t *src =
+        reinterpret_cast<const uint8_t *>(drive.second.getRawData());
+    uint64_t firstPage = bytes.begin / pageSize;
+    uint64_t lastPage = (bytes.end - 1) / pageSize;
+
+    // Drives that are not byte-aligned are rare for memories: save all the
+    // pages they cover and apply them as a whole.
+    if (slice.first % 8 || slice.second % 8) {
+      for (uint64_t page = firstPage; page <= lastPage; ++page)
+        savePage(page);
+      insertBits(data, slice.first, src,
+                 drive.second.getNumWords() * sizeof(uint64_t), slice.second);
+      continue;
+    }
+
+    // Copy the drive page by page, skipping the pages it does not change.
+    for (uint64_t page = firstPage; page <= lastPage; ++page) {
+      uint64_t begin = std::max(bytes.begin, page * pageSize);
+      uint64_t end = std::min(bytes.end, (page + 1) * pageSize);
+      const uint8_t *newBytes = src + (begin - bytes.begin);
+      if (findFirstChangedByte(data + begin, newBytes, end - begin) ==
+          end - begin)
+        continue;
+      savePage(page);
+      std::memcpy(data + begin, newBytes, end - begin);
+    }
+  }
+
+  // Compare the written pages against their saved content, in address order,
+  // and collect the elements that changed.
+  SmallVector<std::pair<uint64_t, unsigned>, 8> pages(savedPages.begin(),
+                                                      savedPages.end());
+  llvm::sort(pages);
+  uint64_t elementSize = getElementSize();
+  for (auto &entry : pages) {
+    uint64_t begin = entry.first * pageSize;
+    uint64_t length = std::min(pageSize, size - begin);
+    const uint8_t *old = scratch.data() + entry.second * pageSize;
+    sparse->markWritten(entry.first);
+
+    uint64_t pos = 0;
+    while (pos < length) {
+      pos += findFirstChangedByte(old + pos, data + begin + pos, length - pos);
+      if (pos >= length)
+        break;
+      uint64_t element = (begin + pos) / elementSize;
+      if (changedElements.empty() || changedElements.back() != element)
+        changedElements.push_back(element);
+      // Continue the search at the start of the next element.
+      pos = (element + 1) * elementSize - begin;
+    }
+  }
+}
+
+void Signal::markWrittenPages() {
+  assert(isSparse() && "expected a sparse signal");
+  uint64_t pageSize = sparse->getPageSize();
+  const uint8_t *data = sparse->data();
+  for (uint64_t page = 0, e = sparse->getNumPages(); page < e; ++page) {
+    uint64_t begin = page * pageSize;
+    uint64_t end = std::min(begin + pageSize, size);
+    if (std::any_of(data + begin, data + end,
+                    [](uint8_t byte) { return byte != 0; }))
+      sparse->markWritten(page);
+  }
+}
+
 //===----------------------------------------------------------------------===//
 // Slot
 //===----------------------------------------------------------------------===//
@@ -108,7 +281,7 @@ void UpdateQueue::insertOrUpdate(Time time, int index, int bitOffset,
   }
   Slot newSlot(time);
   newSlot.insertChange(index, bitOffset, bytes);
-  push(newSlot);
+  push(std::move(newSlot));
 }
 
 void UpdateQueue::insertOrUpdate(Time time, std::string inst) {
@@ -123,6 +296,13 @@ void UpdateQueue::insertOrUpdate(Time time, std::string inst) {
   push(newSlot);
 }
 
+Slot UpdateQueue::popSlot() {
+  std::pop_heap(c.begin(), c.end(), comp);
+  Slot slot = std::move(c.back());
+  c.pop_back();
+  return slot;
+}
+
 //===----------------------------------------------------------------------===//
 // State
 //===----------------------------------------------------------------------===//
@@ -139,9 +319,7 @@ State::~State() {
 
 Slot State::popQueue() {
   assert(!queue.empty() && "the event queue is empty");
-  Slot pop = queue.top();
-  queue.pop();
-  return pop;
+  return queue.popSlot();
 }
 
 void State::pushQueue(Time t, int index, int bitOffset, APInt &bytes) {
@@ -167,22 +345,43 @@ void State::addProcPtr(std::string name, ProcState *procStatePtr) {
   instances[name].procState->inst[name.size()] = '\0';
 }
 
+Signal &State::getOwnedSignal(int index, const std::string &owner) {
+  auto &inst = instances[owner];
+  return signals[inst.sensitivityList[index + inst.nArgs].globalIndex];
+}
+
+uint8_t *State::allocSignalStorage(int index, std::string owner,
+                                   uint64_t size) {
+  // Decide on sparse storage before allocating anything, such that the pages
+  // of a large memory are only backed once they are written to.
+  auto &sig = getOwnedSignal(index, owner);
+  if (sparseThreshold && sig.numElements && size >= sparseThreshold) {
+    sig.sparse = std::make_unique<SparseStorage>(size);
+    return sig.sparse->data();
+  }
+  return static_cast<uint8_t *>(std::calloc(2 * size, 1));
+}
+
 int State::addSignalData(int index, std::string owner, uint8_t *value,
                          uint64_t size) {
   auto &inst = instances[owner];
   uint64_t globalIdx = inst.sensitivityList[index + inst.nArgs].globalIndex;
   auto &sig = signals[globalIdx];
 
-  // Add pointer and size to global signal table entry.
-  sig.value = std::unique_ptr<uint8_t>(value);
+  // Add pointer and size to global signal table entry. The value of a sparse
+  // signal is owned by its sparse storage.
   sig.size = size;
+  if (sig.isSparse())
+    sig.markWrittenPages();
+  else
+    sig.value = std::unique_ptr<uint8_t>(value);
 
   // Add the value pointer to the signal detail struct for each instance this
   // signal appears in.
   for (auto inst : signals[globalIdx].triggers) {
     for (auto &detail : instances[inst].sensitivityList) {
       if (detail.globalIndex == globalIdx) {
-        detail.value = sig.value.get();
+        detail.value = sig.getValue();
       }
     }
   }
@@ -191,12 +390,48 @@ int State::addSignalData(int index, std::string owner, uint8_t *value,
 
 void State::dumpSignal(llvm::raw_ostream &out, int index) {
   auto &sig = signals[index];
+  if (sig.isSparse()) {
+    // Only dump the non-zero elements of the pages that have been written to.
+    SmallVector<uint64_t, 16> elements;
+    uint64_t pageSize = sig.sparse->getPageSize();
+    uint64_t elementSize = sig.getElementSize();
+    const uint8_t *data = sig.getValue();
+    for (uint64_t page = 0, e = sig.sparse->getNumPages(); page < e; ++page) {
+      if (!sig.sparse->isWritten(page))
+        continue;
+      uint64_t first = page * pageSize / elementSize;
+      uint64_t last = std::min((page + 1) * pageSize, sig.size);
+      last = divideCeil(last, elementSize);
+      if (!elements.empty())
+        first = std::max(first, elements.back() + 1);
+      for (uint64_t elem = first; elem < last; ++elem) {
+        const uint8_t *bytes = data + elem * elementSize;
+        if (std::any_of(bytes, bytes + elementSize,
+                        [](uint8_t byte) { return byte != 0; }))
+          elements.push_back(elem);
+      }
+    }
+    dumpSignalElements(out, index, elements);
+    return;
+  }
   for (auto inst : sig.triggers) {
     out << time.dump() << "  " << instances[inst].path << "/" << sig.name
         << "  " << sig.dump() << "\n";
   }
 }
 
+void State::dumpSignalElements(llvm::raw_ostream &out, int index,
+                               ArrayRef<uint64_t> elements) {
+  auto &sig = signals[index];
+  for (auto elem : elements) {
+    auto value = sig.dumpElement(elem);
+    for (auto inst : sig.triggers) {
+      out << time.dump() << "  " << instances[inst].path << "/" << sig.name
+          << "[" << elem << "]  " << value << "\n";
+    }
+  }
+}
+
 void State::dumpLayout() {
   llvm::errs() << "::------------------- Layout -------------------::\n";
   for (auto &inst : instances) {
@@ -8,8 +8,13 @@
 #ifndef CIRCT_DIALECT_LLHD_SIMULATOR_STATE_H
 #define CIRCT_DIALECT_LLHD_SIMULATOR_STATE_H
 
+#include "SignalKernels.h"
+
 #include "llvm/ADT/APInt.h"
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/StringMap.h"
+#include "llvm/Support/Memory.h"
 
 #include <map>
 #include <queue>
@@ -57,6 +62,47 @@ struct SignalDetail {
   uint64_t globalIndex;
 };
 
+/// Page-granular storage used for large array signals. The storage is reserved
+/// as one contiguous region of virtual memory, such that the lowered code can
+/// keep accessing the signal through a plain pointer, but pages are only backed
+/// by physical memory once they are written to: untouched pages are
+/// copy-on-write mappings of the zero page. The pages that have been written to
+/// are tracked, such that the storage can be walked sparsely.
+class SparseStorage {
+public:
+  /// Reserve zero-initialized storage for `size` bytes.
+  explicit SparseStorage(uint64_t size);
+
+  /// Release the reserved memory region.
+  ~SparseStorage();
+
+  SparseStorage(const SparseStorage &) = delete;
+  SparseStorage &operator=(const SparseStorage &) = delete;
+
+  /// Get a pointer to the start of the storage.
+  uint8_t *data() const { return static_cast<uint8_t *>(block.base()); }
+
+  /// Get the size of a page in bytes.
+  uint64_t getPageSize() const { return pageSize; }
+
+  /// Get the number of pages of the storage.
+  uint64_t getNumPages() const { return written.size(); }
+
+  /// Return true if the page has been written to.
+  bool isWritten(uint64_t page) const { return written.test(page); }
+
+  /// Mark a page as written to.
+  void markWritten(uint64_t page) { written.set(page); }
+
+  /// Get the number of pages that have been written to.
+  uint64_t getNumWrittenPages() const { return written.count(); }
+
+private:
+  llvm::sys::MemoryBlock block;
+  uint64_t pageSize;
+  llvm::BitVector written;
+};
+
 /// The simulator's internal representation of a signal.
 struct Signal {
   /// Construct an "empty" signal.
@@ -82,13 +128,54 @@ struct Signal {
   /// Return the signal value in dumpable format: "0x<value>".
   std::string dump();
 
+  /// Apply the given (bit-offset, value) drives, in order, directly to the
+  /// signal storage. The bytes touched by the drives are saved to `scratch`
+  /// beforehand, such that the returned range only covers the bytes whose
+  /// value actually changed. An empty range is returned if the drives left the
+  /// signal value unchanged.
+  ByteRange applyDrives(llvm::ArrayRef<std::pair<int, llvm::APInt>> drives,
+                        llvm::SmallVectorImpl<uint8_t> &scratch);
+
+  /// Apply the given drives, in order, to a sparse signal. Only the pages whose
+  /// content is actually changed by a drive are saved to `scratch` and written
+  /// to. The indices of the elements whose value changed are appended to
+  /// `changedElements` in increasing order.
+  void applySparseDrives(llvm::ArrayRef<std::pair<int, llvm::APInt>> drives,
+                         llvm::SmallVectorImpl<uint8_t> &scratch,
+                         llvm::SmallVectorImpl<uint64_t> &changedElements);
+
+  /// Mark the pages of a sparse signal that hold non-zero data as written to.
+  /// Reading the pages the initial value left at zero does not back them by
+  /// physical memory.
+  void markWrittenPages();
+
+  /// Return true if the signal value is held in sparse storage.
+  bool isSparse() const { return sparse != nullptr; }
+
+  /// Get a pointer to the signal value.
+  uint8_t *getValue() const { return sparse ? sparse->data() : value.get(); }
+
+  /// Get the size in bytes of one element of an array signal, or the size of
+  /// the whole signal otherwise.
+  uint64_t getElementSize() const {
+    return numElements ? size / numElements : size;
+  }
+
+  /// Return the value of the element at the given index in dumpable format:
+  /// "0x<value>".
+  std::string dumpElement(uint64_t index);
+
   std::string name;
   std::string owner;
   // The list of instances this signal triggers.
   std::vector<std::string> triggers;
   int origin = -1;
   uint64_t size;
+  // The number of elements, if the signal carries an array.
+  uint64_t numElements = 0;
   std::unique_ptr<uint8_t> value;
+  // The storage of the signal value, if it is held sparsely.
+  std::unique_ptr<SparseStorage> sparse;
 };
 
 /// The simulator's internal representation of one queue slot.
@@ -128,6 +215,11 @@ public:
   /// add the scheduled wakeup to it, else create a new slot and push it to the
   /// queue.
   void insertOrUpdate(Time time, std::string inst);
+
+  /// Remove the earliest slot from the queue and return it. The slot is moved
+  /// out of the heap storage once it has been popped off the heap, rather than
+  /// being copied from the top of the queue.
+  Slot popSlot();
 };
 
 /// State structure for process persistence across suspension.
@@ -187,6 +279,12 @@ struct State {
   /// Add a new signal to the state. Returns the index of the new signal.
   int addSignal(std::string name, std::string owner);
 
+  /// Allocate zero-initialized storage for the value of the signal at position
+  /// `index` of the owner's signal table. Array signals of at least
+  /// `sparseThreshold` bytes get sparse storage, all others a malloc'd buffer
+  /// of twice the size, such that signal shifts do not read past it.
+  uint8_t *allocSignalStorage(int index, std::string owner, uint64_t size);
+
   int addSignalData(int index, std::string owner, uint8_t *value,
                     uint64_t size);
 
@@ -194,17 +292,29 @@ struct State {
   void addProcPtr(std::string name, ProcState *procStatePtr);
 
   /// Dump a signal to the out stream. One entry is added for every instance
-  /// the signal appears in.
+  /// the signal appears in. Sparse signals are dumped element-wise, skipping
+  /// the elements that are zero.
   void dumpSignal(llvm::raw_ostream &out, int index);
 
+  /// Dump the given elements of an array signal to the out stream. One entry
+  /// is added for every element and every instance the signal appears in.
+  void dumpSignalElements(llvm::raw_ostream &out, int index,
+                          llvm::ArrayRef<uint64_t> elements);
+
   /// Dump the instance layout. Used for testing purposes.
   void dumpLayout();
 
   /// Dump the instances each signal triggers. Used for testing purposes.
   void dumpSignalTriggers();
 
+  /// Return the signal at position `index` of the owner's signal table.
+  Signal &getOwnedSignal(int index, const std::string &owner);
+
   Time time;
   std::string root;
+  // Array signals of at least this size in bytes are stored sparsely. A
+  // threshold of 0 disables sparse storage.
+  uint64_t sparseThreshold = 0;
   llvm::StringMap<Instance> instances;
   std::vector<Signal> signals;
   UpdateQueue queue;
@@ -15,6 +15,13 @@ using namespace circt::llhd::sim;
 // Runtime interface
 //===----------------------------------------------------------------------===//
 
+uint8_t *allocSignalStorage(State *state, int index, char *owner,
+                            int64_t size) {
+  assert(state && "alloc_signal_storage: state not found");
+  std::string sOwner(owner);
+  return state->allocSignalStorage(index, sOwner, size);
+}
+
 int allocSignal(State *state, int index, char *owner, uint8_t *value,
                 int64_t size) {
   assert(state && "alloc_signal: state not found");
@@ -50,7 +57,7 @@ void driveSignal(State *state, SignalDetail *detail, uint8_t *value,
   Time sTime(time, delta, eps);
 
   int bitOffset =
-      (detail->value - state->signals[globalIndex].value.get()) * 8 + offset;
+      (detail->value - state->signals[globalIndex].getValue()) * 8 + offset;
 
   // Spawn a new event.
   state->pushQueue(sTime, globalIndex, bitOffset, drive);
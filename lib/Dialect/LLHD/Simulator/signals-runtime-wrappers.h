@@ -15,6 +15,11 @@ extern "C" {
 // Runtime interfaces
 //===----------------------------------------------------------------------===//
 
+/// Allocate zero-initialized storage for the value of a signal. Large array
+/// signals get sparse storage.
+uint8_t *allocSignalStorage(circt::llhd::sim::State *state, int index,
+                            char *owner, int64_t size);
+
 /// Allocate a new signal. The index of the new signal in the state's list of
 /// signals is returned.
 int allocSignal(circt::llhd::sim::State *state, int index, char *owner,
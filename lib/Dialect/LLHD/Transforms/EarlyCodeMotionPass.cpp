@@ -33,8 +33,8 @@ static SmallVector<Block *, 8> intersection(SmallVectorImpl<Block *> &v1,
 
 void EarlyCodeMotionPass::runOnOperation() {
   llhd::ProcOp proc = getOperation();
-  llhd::TemporalRegionAnalysis trAnalysis = llhd::TemporalRegionAnalysis(proc);
-  DominanceInfo dom(proc);
+  auto &trAnalysis = getAnalysis<llhd::TemporalRegionAnalysis>();
+  auto &dom = getAnalysis<DominanceInfo>();
 
   DenseMap<Block *, unsigned> entryDistance;
   SmallPtrSet<Block *, 32> workDone;
@@ -82,9 +82,10 @@ void EarlyCodeMotionPass::runOnOperation() {
 
       // The probe instruction has to stay in the same temporal region
       if (isa<llhd::PrbOp>(op)) {
-        SmallVector<Block *, 8> blocksInTR =
-            trAnalysis.getBlocksInTR(trAnalysis.getBlockTR(block));
-        validPlacements = intersection(validPlacements, blocksInTR);
+        int tr = trAnalysis.getBlockTR(block);
+        llvm::erase_if(validPlacements, [&](Block *b) {
+          return !trAnalysis.isBlockInTR(b, tr);
+        });
       }
 
       if (validPlacements.empty())
@@ -122,6 +123,10 @@ void EarlyCodeMotionPass::runOnOperation() {
       }
     }
   }
+
+  // Only operations other than terminators are moved, the CFG and thus the
+  // temporal regions and dominance stay the same.
+  markAnalysesPreserved<llhd::TemporalRegionAnalysis, DominanceInfo>();
 }
 
 std::unique_ptr<OperationPass<llhd::ProcOp>>
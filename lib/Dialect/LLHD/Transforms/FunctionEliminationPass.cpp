@@ -20,12 +20,11 @@ struct FunctionEliminationPass
   void runOnOperation() override;
 };
 
-void FunctionEliminationPass::runOnOperation() {
-  ModuleOp module = getOperation();
-
-  WalkResult result = module.walk([](CallOp op) -> WalkResult {
-    if (isa<llhd::ProcOp>(op.getParentOp()) ||
-        isa<llhd::EntityOp>(op.getParentOp())) {
+/// Check that no function call is left directly within the given process or
+/// entity. This does not modify the unit.
+static LogicalResult checkUnit(Operation *unit) {
+  WalkResult result = unit->walk([unit](CallOp op) -> WalkResult {
+    if (op.getParentOp() == unit) {
       return emitError(
           op.getLoc(),
           "Not all functions are inlined, there is at least "
@@ -33,8 +32,22 @@ void FunctionEliminationPass::runOnOperation() {
     }
     return WalkResult::advance();
   });
+  return failure(result.wasInterrupted());
+}
 
-  if (result.wasInterrupted()) {
+void FunctionEliminationPass::runOnOperation() {
+  ModuleOp module = getOperation();
+
+  // The processes and entities are isolated from each other, so the calls
+  // left in them are looked for concurrently.
+  SmallVector<Operation *, 16> units;
+  module.walk([&](Operation *op) {
+    if (isa<llhd::ProcOp, llhd::EntityOp>(op))
+      units.push_back(op);
+  });
+  if (failed(llhd::parallelCheckEachOp(&getContext(),
+                                       ArrayRef<Operation *>(units),
+                                       checkUnit))) {
     signalPassFailure();
     return;
   }
@@ -24,8 +24,7 @@ struct MemoryToBlockArgumentPass
 
 /// Add the dominance fontier blocks of 'frontierOf' to the 'df' set
 static void getDominanceFrontier(Block *frontierOf, Operation *op,
-                                 std::set<Block *> &df) {
-  DominanceInfo dom(op);
+                                 DominanceInfo &dom, std::set<Block *> &df) {
   for (Block &block : op->getRegion(0).getBlocks()) {
     for (Block *pred : block.getPredecessors()) {
       if (dom.dominates(frontierOf, pred) &&
@@ -40,15 +39,15 @@ static void getDominanceFrontier(Block *frontierOf, Operation *op,
 /// Add the blocks in the closure of the dominance fontier relation of all the
 /// block in 'initialSet' to 'closure'
 static void getDFClosure(SmallVectorImpl<Block *> &initialSet, Operation *op,
-                         std::set<Block *> &closure) {
+                         DominanceInfo &dom, std::set<Block *> &closure) {
   unsigned numElements;
   for (Block *block : initialSet) {
-    getDominanceFrontier(block, op, closure);
+    getDominanceFrontier(block, op, dom, closure);
   }
   do {
     numElements = closure.size();
     for (Block *block : closure) {
-      getDominanceFrontier(block, op, closure);
+      getDominanceFrontier(block, op, dom, closure);
     }
   } while (numElements < closure.size());
 }
@@ -106,15 +105,23 @@ void MemoryToBlockArgumentPass::runOnOperation() {
     }
   }
 
-  // For each variable find the blocks where a value is stored to it
+  // The pass only adds block arguments and memory operations, the CFG and thus
+  // the dominance relation stay the same for all variables.
+  DominanceInfo dom(operation);
+
+  // Find the blocks where a value is stored to each variable in a single walk
+  DenseMap<Value, SmallVector<Block *, 16>> storeBlocks;
+  operation->walk([&](llhd::StoreOp op) {
+    storeBlocks[op.pointer()].push_back(op.getOperation()->getBlock());
+  });
+
   for (Value var : vars) {
     SmallVector<Block *, 16> defBlocks;
     defBlocks.push_back(
         var.getDefiningOp<llhd::VarOp>().getOperation()->getBlock());
-    operation->walk([&](llhd::StoreOp op) {
-      if (op.pointer() == var)
-        defBlocks.push_back(op.getOperation()->getBlock());
-    });
+    auto stores = storeBlocks.find(var);
+    if (stores != storeBlocks.end())
+      defBlocks.append(stores->second.begin(), stores->second.end());
     // Remove duplicates from the list
     std::sort(defBlocks.begin(), defBlocks.end());
     defBlocks.erase(std::unique(defBlocks.begin(), defBlocks.end()),
@@ -122,7 +129,7 @@ void MemoryToBlockArgumentPass::runOnOperation() {
 
     // Calculate initial set of join points
     std::set<Block *> joinPoints;
-    getDFClosure(defBlocks, operation, joinPoints);
+    getDFClosure(defBlocks, operation, dom, joinPoints);
 
     for (Block *jp : joinPoints) {
       // Add a block argument for the variable at each join point
@@ -6,7 +6,10 @@
 #define DIALECT_LLHD_TRANSFORMS_PASSDETAILS_H
 
 #include "circt/Dialect/LLHD/IR/LLHDOps.h"
+#include "mlir/IR/Diagnostics.h"
 #include "mlir/Pass/Pass.h"
+#include "llvm/Support/Parallel.h"
+#include <atomic>
 
 namespace circt {
 namespace llhd {
@@ -14,6 +17,31 @@ namespace llhd {
 #define GEN_PASS_CLASSES
 #include "circt/Dialect/LLHD/Transforms/Passes.h.inc"
 
+/// Apply the read-only check `fn` to each of the given operations,
+/// concurrently if the context has multithreading enabled, and return failure
+/// if any of the checks failed. Diagnostics are reported in the order of the
+/// operations, as in a serial run.
+template <typename OpT, typename FnT>
+mlir::LogicalResult parallelCheckEachOp(mlir::MLIRContext *context,
+                                        llvm::ArrayRef<OpT> ops, FnT &&fn) {
+  if (!context->isMultithreadingEnabled() || ops.size() < 2) {
+    for (OpT op : ops)
+      if (mlir::failed(fn(op)))
+        return mlir::failure();
+    return mlir::success();
+  }
+
+  std::atomic<bool> anyFailed(false);
+  mlir::ParallelDiagnosticHandler diagnostics(context);
+  llvm::parallelForEachN(0, ops.size(), [&](size_t i) {
+    diagnostics.setOrderIDForThread(i);
+    if (mlir::failed(fn(ops[i])))
+      anyFailed = true;
+    diagnostics.eraseOrderIDForThread();
+  });
+  return mlir::failure(anyFailed);
+}
+
 } // namespace llhd
 } // namespace circt
 
@@ -0,0 +1,175 @@
+//===- SignalForwardingPass.cpp - Implement Signal Forwarding Pass --------===//
+//
+// Implement pass to forward signals that are driven once into SSA values and to
+// delete signals that are never observed.
+//
+//===----------------------------------------------------------------------===//
+
+#include "PassDetails.h"
+#include "circt/Dialect/LLHD/Transforms/Passes.h"
+#include "mlir/IR/Dominance.h"
+#include "mlir/IR/Matchers.h"
+
+using namespace mlir;
+using namespace circt;
+
+namespace {
+struct SignalForwardingPass
+    : public llhd::SignalForwardingBase<SignalForwardingPass> {
+  void runOnOperation() override;
+};
+} // namespace
+
+/// Return true if the drive unconditionally takes effect after a delta or
+/// epsilon delay only, i.e. without advancing the real time.
+static bool isUnconditionalZeroTimeDrive(llhd::DrvOp drv) {
+  llhd::TimeAttr time;
+  if (!matchPattern(drv.time(), m_Constant(&time)) || time.getTime() != 0)
+    return false;
+  return !drv.enable() || matchPattern(drv.enable(), m_One());
+}
+
+/// Return true if the operation derives a sub-signal from a signal.
+static bool isSubSignalOp(Operation *op) {
+  return isa<llhd::ExtractSliceOp, llhd::DynExtractSliceOp,
+             llhd::ExtractElementOp, llhd::DynExtractElementOp>(op) &&
+         op->getResult(0).getType().isa<llhd::SigType>();
+}
+
+/// Return true if the signal, or any sub-signal derived from it, is used by
+/// anything but drives targeting it. Otherwise collect the drives and
+/// sub-signal ops in `users`, such that they can be deleted.
+static bool isObserved(Value signal, SmallVectorImpl<Operation *> &users) {
+  for (Operation *user : signal.getUsers()) {
+    if (auto drv = dyn_cast<llhd::DrvOp>(user)) {
+      if (drv.signal() != signal)
+        return true;
+    } else if (isSubSignalOp(user) && user->getOperand(0) == signal) {
+      if (isObserved(user->getResult(0), users))
+        return true;
+    } else {
+      return true;
+    }
+    users.push_back(user);
+  }
+  return false;
+}
+
+/// The operations that defined an operand of an erased operation, and thus may
+/// have lost their last use.
+using MaybeDeadOps = SmallPtrSet<Operation *, 16>;
+
+/// Erase an operation and remember the operations defining its operands.
+static void eraseOp(Operation *op, MaybeDeadOps &maybeDead) {
+  for (Value operand : op->getOperands())
+    if (Operation *def = operand.getDefiningOp())
+      maybeDead.insert(def);
+  maybeDead.erase(op);
+  op->erase();
+}
+
+/// Delete a signal that is never observed, together with its drives. Returns
+/// true if the signal was deleted.
+static bool eliminateDeadSignal(llhd::SigOp sig, MaybeDeadOps &maybeDead) {
+  SmallVector<Operation *, 8> users;
+  if (isObserved(sig.result(), users))
+    return false;
+
+  // Users of sub-signals have been collected before the sub-signal op itself,
+  // such that deleting in order never leaves a dangling use.
+  for (Operation *user : users)
+    eraseOp(user, maybeDead);
+  eraseOp(sig, maybeDead);
+  return true;
+}
+
+/// Replace the probes of a signal that is driven exactly once, after a zero
+/// time delay and unconditionally, with the driven value. Returns true if the
+/// signal was forwarded and deleted.
+static bool forwardSignal(llhd::SigOp sig, DominanceInfo &dom,
+                          MaybeDeadOps &maybeDead) {
+  llhd::DrvOp drive;
+  SmallVector<llhd::PrbOp, 4> probes;
+  for (Operation *user : sig.result().getUsers()) {
+    if (auto prb = dyn_cast<llhd::PrbOp>(user)) {
+      probes.push_back(prb);
+      continue;
+    }
+    auto drv = dyn_cast<llhd::DrvOp>(user);
+    if (!drv || drive || drv.signal() != sig.result())
+      return false;
+    drive = drv;
+  }
+  if (!drive || !isUnconditionalZeroTimeDrive(drive))
+    return false;
+
+  // The driven value has to be available at every probe. This also rules out
+  // signals that feed back into their own driven value.
+  Value value = drive.value();
+  if (!llvm::all_of(probes, [&](llhd::PrbOp prb) {
+        return dom.properlyDominates(value, prb);
+      }))
+    return false;
+
+  for (llhd::PrbOp prb : probes) {
+    prb.result().replaceAllUsesWith(value);
+    eraseOp(prb, maybeDead);
+  }
+  eraseOp(drive, maybeDead);
+  eraseOp(sig, maybeDead);
+  return true;
+}
+
+/// Delete the probes and side-effect free operations that lost their last use
+/// when signals were forwarded or deleted, e.g. the ones that computed the
+/// values driven onto a deleted signal. Operations that were unused before are
+/// left to the canonicalizer.
+static bool eliminateDeadOps(MaybeDeadOps &maybeDead) {
+  bool changed = false;
+  while (!maybeDead.empty()) {
+    Operation *op = *maybeDead.begin();
+    maybeDead.erase(op);
+    if (!op->use_empty() || !(isa<llhd::PrbOp>(op) || isOpTriviallyDead(op)))
+      continue;
+    eraseOp(op, maybeDead);
+    changed = true;
+  }
+  return changed;
+}
+
+void SignalForwardingPass::runOnOperation() {
+  llhd::EntityOp entity = getOperation();
+
+  auto countOps = [&](auto &numSignals, auto &numDrives) {
+    entity.walk([&](Operation *op) {
+      if (isa<llhd::SigOp>(op))
+        ++numSignals;
+      else if (isa<llhd::DrvOp>(op))
+        ++numDrives;
+    });
+  };
+  countOps(numSignalsBefore, numDrivesBefore);
+
+  DominanceInfo dom(entity);
+
+  // Iterate to a fixed point: deleting a dead signal can leave the probes
+  // feeding its drives unused, which in turn can make other signals dead.
+  MaybeDeadOps maybeDead;
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    auto sigOps = entity.body().getOps<llhd::SigOp>();
+    SmallVector<llhd::SigOp, 16> signals(sigOps.begin(), sigOps.end());
+    for (llhd::SigOp sig : signals)
+      changed |= eliminateDeadSignal(sig, maybeDead) ||
+                 forwardSignal(sig, dom, maybeDead);
+    changed |= eliminateDeadOps(maybeDead);
+  }
+
+  countOps(numSignalsAfter, numDrivesAfter);
+}
+
+std::unique_ptr<OperationPass<llhd::EntityOp>>
+circt::llhd::createSignalForwardingPass() {
+  return std::make_unique<SignalForwardingPass>();
+}
@@ -7,155 +7,160 @@
 
 #include "TemporalRegions.h"
 #include "circt/Dialect/LLHD/IR/LLHDOps.h"
-#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/DenseSet.h"
+#include <deque>
 
 using namespace mlir;
 using namespace circt;
 
-static void addBlockToTR(Block *block, int tr, DenseMap<Block *, int> &blockMap,
-                         DenseMap<int, SmallVector<Block *, 8>> &trMap) {
-  blockMap.insert(std::make_pair(block, tr));
-  SmallVector<Block *, 8> b;
-  b.push_back(block);
-  trMap.insert(std::make_pair(tr, b));
-}
-
-static bool anyPredecessorHasWait(Block *block) {
-  return std::any_of(block->pred_begin(), block->pred_end(), [](Block *pred) {
-    return isa<llhd::WaitOp>(pred->getTerminator());
-  });
-}
-
-static bool allPredecessorTRsKnown(Block *block,
-                                   SmallPtrSetImpl<Block *> &known) {
-  return std::all_of(block->pred_begin(), block->pred_end(), [&](Block *pred) {
-    return std::find(known.begin(), known.end(), pred) != known.end();
-  });
-}
-
 void llhd::TemporalRegionAnalysis::recalculate(Operation *operation) {
   assert(isa<ProcOp>(operation) &&
          "TemporalRegionAnalysis: operation needs to be llhd::ProcOp");
   ProcOp proc = cast<ProcOp>(operation);
   int nextTRnum = -1;
   blockMap.clear();
-  trMap.clear();
+  trInfos.clear();
+
+  // The number of CFG edges into each block whose source was not processed
+  // yet, and whether the block is targeted by a wait terminator.
+  DenseMap<Block *, unsigned> numPendingPreds;
+  DenseSet<Block *> waitTargets;
+  for (Block &block : proc.getBlocks()) {
+    for (Block *succ : block.getSuccessors())
+      ++numPendingPreds[succ];
+    if (auto wait = dyn_cast<WaitOp>(block.getTerminator()))
+      waitTargets.insert(wait.dest());
+  }
 
-  SmallPtrSet<Block *, 32> workQueue;
-  SmallPtrSet<Block *, 32> workDone;
+  // Blocks are processed in the order they are discovered, preferring the ones
+  // that have all predecessors already processed or are targeted by a wait.
+  // `readyQueue` may contain stale entries of already processed blocks.
+  SmallVector<Block *, 32> workQueue;
+  unsigned workQueueHead = 0;
+  std::deque<Block *> readyQueue;
+  DenseSet<Block *> queued;
+  DenseSet<Block *> workDone;
+
+  auto isReady = [&](Block *block) {
+    return numPendingPreds.lookup(block) == 0 || waitTargets.count(block);
+  };
+  auto enqueue = [&](Block *block) {
+    if (workDone.count(block) || !queued.insert(block).second)
+      return;
+    workQueue.push_back(block);
+    if (isReady(block))
+      readyQueue.push_back(block);
+  };
+  auto getNextBlock = [&]() -> Block * {
+    while (!readyQueue.empty()) {
+      Block *block = readyQueue.front();
+      readyQueue.pop_front();
+      if (!workDone.count(block))
+        return block;
+    }
+    // If no block in the work queue has all predecessors finished or is
+    // targeted by a wait, there is probably a loop within a TR, in this case
+    // we are conservatively assign a new temporal region
+    while (workQueueHead < workQueue.size()) {
+      Block *block = workQueue[workQueueHead++];
+      if (!workDone.count(block))
+        return block;
+    }
+    return nullptr;
+  };
 
   // Add the entry block and all blocks targeted by a wait terminator to the
   // initial work queue because they are always the entry block of a new TR
-  workQueue.insert(&proc.body().front());
-  proc.walk([&](WaitOp wait) { workQueue.insert(wait.dest()); });
-
-  while (!workQueue.empty()) {
-    // Find basic block in the work queue which has all predecessors already
-    // processed or at least one predecessor has a wait terminator
-    auto iter =
-        std::find_if(workQueue.begin(), workQueue.end(), [&](Block *block) {
-          return allPredecessorTRsKnown(block, workDone) ||
-                 anyPredecessorHasWait(block);
-        });
-
-    // If no element in the work queue has all predecessors finished or is
-    // targeted by a wait, there is probably a loop within a TR, in this case we
-    // are conservatively assign a new temporal region
-    if (iter == workQueue.end())
-      iter = workQueue.begin();
-
-    // This is the current block to be processed
-    Block *block = *iter;
-
-    // Delete this block from the work queue and add it to the list of alredy
-    // processed blocks
-    workQueue.erase(block);
-    workDone.insert(block);
+  enqueue(&proc.body().front());
+  proc.walk([&](WaitOp wait) { enqueue(wait.dest()); });
 
-    // Add all successors of this block which were not already processed to the
-    // work queue
+  while (Block *block = getNextBlock()) {
+    // Add it to the list of alredy processed blocks and add all successors of
+    // this block which were not already processed to the work queue
+    workDone.insert(block);
     for (Block *succ : block->getSuccessors()) {
-      if (!workDone.count(succ))
-        workQueue.insert(succ);
+      if (--numPendingPreds[succ] == 0 && queued.count(succ) &&
+          !workDone.count(succ))
+        readyQueue.push_back(succ);
+    }
+    for (Block *succ : block->getSuccessors())
+      enqueue(succ);
+
+    // Find out whether all predecessors already have a TR assigned and whether
+    // they all agree on it. A self-loop does not have a TR yet at this point.
+    bool allPredsKnown = true;
+    bool samePredTR = true;
+    Optional<int> predTR;
+    for (Block *pred : block->getPredecessors()) {
+      auto it = blockMap.find(pred);
+      if (!workDone.count(pred) || it == blockMap.end()) {
+        allPredsKnown = false;
+        break;
+      }
+      if (predTR && *predTR != it->second)
+        samePredTR = false;
+      predTR = it->second;
     }
 
+    int tr;
     // The entry block is always assigned -1 as a placeholder as this block must
     // not contain any temporal operations
-    if (block->isEntryBlock()) {
-      addBlockToTR(block, -1, blockMap, trMap);
-      // If at least one predecessor has a wait terminator or at least one
-      // predecessor has an unknown temporal region or not all predecessors have
-      // the same TR, create a new TR
-    } else if (!allPredecessorTRsKnown(block, workDone) ||
-               anyPredecessorHasWait(block) ||
-               !(std::adjacent_find(block->pred_begin(), block->pred_end(),
-                                    [&](Block *pred1, Block *pred2) {
-                                      return blockMap[pred1] != blockMap[pred2];
-                                    }) == block->pred_end())) {
-      addBlockToTR(block, ++nextTRnum, blockMap, trMap);
-      // If all predecessors have the same TR and none has a wait terminator,
-      // inherit the TR
-    } else {
-      int tr = blockMap[*block->pred_begin()];
-      blockMap.insert(std::make_pair(block, tr));
-      trMap[tr].push_back(block);
-      trMap[tr].erase(std::unique(trMap[tr].begin(), trMap[tr].end()),
-                      trMap[tr].end());
-    }
+    if (block->isEntryBlock())
+      tr = -1;
+    // If at least one predecessor has a wait terminator or at least one
+    // predecessor has an unknown temporal region or not all predecessors have
+    // the same TR, create a new TR
+    else if (!allPredsKnown || waitTargets.count(block) || !samePredTR)
+      tr = ++nextTRnum;
+    // If all predecessors have the same TR and none has a wait terminator,
+    // inherit the TR
+    else
+      tr = *predTR;
+
+    blockMap.insert(std::make_pair(block, tr));
+    if (static_cast<int>(trInfos.size()) <= tr + 1)
+      trInfos.resize(tr + 2);
+    trInfos[tr + 1].blocks.push_back(block);
   }
 
   numTRs = nextTRnum + 1;
-}
-
-int llhd::TemporalRegionAnalysis::getBlockTR(Block *block) {
-  assert(blockMap.count(block) &&
-         "This block is not present in the temporal regions map.");
-  return blockMap[block];
-}
-
-SmallVector<Block *, 8> llhd::TemporalRegionAnalysis::getBlocksInTR(int tr) {
-  if (!trMap.count(tr))
-    return SmallVector<Block *, 8>();
-  return trMap[tr];
-}
-
-SmallVector<Block *, 8>
-llhd::TemporalRegionAnalysis::getExitingBlocksInTR(int tr) {
-  SmallVector<Block *, 8> blocks = getBlocksInTR(tr);
-  SmallVector<Block *, 8> exitingBlocks;
-  for (Block *block : blocks) {
-    for (auto succ : block->getSuccessors()) {
-      if (blockMap[succ] != blockMap[block] ||
-          isa<WaitOp>(block->getTerminator())) {
-        exitingBlocks.push_back(block);
-        break;
+  trInfos.resize(numTRs + 1);
+
+  // Precompute the exiting blocks, entry block and successors of every TR.
+  for (int tr = -1, e = numTRs; tr < e; ++tr) {
+    TRInfo &info = trInfos[tr + 1];
+    info.successorSet.resize(numTRs);
+
+    for (Block *block : info.blocks) {
+      bool isWait = isa<WaitOp>(block->getTerminator());
+      bool isExiting = false;
+      for (Block *succ : block->getSuccessors()) {
+        int succTR = getBlockTR(succ);
+        if (succTR == tr && !isWait)
+          continue;
+        isExiting = true;
+        info.successorSet.set(succTR);
       }
+      if (isExiting)
+        info.exitingBlocks.push_back(block);
+
+      if (!info.entryBlock &&
+          (block->hasNoPredecessors() || waitTargets.count(block) ||
+           llvm::any_of(block->getPredecessors(), [&](Block *pred) {
+             auto it = blockMap.find(pred);
+             return it == blockMap.end() || it->second != tr;
+           })))
+        info.entryBlock = block;
     }
-  }
-  return exitingBlocks;
-}
 
-SmallVector<int, 8> llhd::TemporalRegionAnalysis::getTRSuccessors(int tr) {
-  SmallVector<int, 8> res;
-  for (Block *block : getExitingBlocksInTR(tr)) {
-    for (Block *succ : block->getSuccessors()) {
-      if (getBlockTR(succ) != tr || isa<llhd::WaitOp>(block->getTerminator()))
-        res.push_back(getBlockTR(succ));
-    }
+    for (int succ : info.successorSet.set_bits())
+      info.successors.push_back(succ);
   }
-  res.erase(std::unique(res.begin(), res.end()), res.end());
-  return res;
 }
 
-Block *llhd::TemporalRegionAnalysis::getTREntryBlock(int tr) {
-  for (Block *block : getBlocksInTR(tr)) {
-    if (block->hasNoPredecessors() || anyPredecessorHasWait(block))
-      return block;
-
-    for (Block *pred : block->getPredecessors()) {
-      if (getBlockTR(pred) != tr)
-        return block;
-    }
-  }
-  return nullptr;
+int llhd::TemporalRegionAnalysis::getBlockTR(Block *block) const {
+  auto it = blockMap.find(block);
+  assert(it != blockMap.end() &&
+         "This block is not present in the temporal regions map.");
+  return it->second;
 }
@@ -9,42 +9,86 @@
 #define DIALECT_LLHD_TRANSFORMS_TEMPORALREGIONS_H
 
 #include "mlir/IR/Operation.h"
+#include "llvm/ADT/BitVector.h"
 
 namespace circt {
 namespace llhd {
 using namespace mlir;
 
+/// Partition the blocks of an llhd.proc into temporal regions (TRs). The entry
+/// block forms the placeholder TR -1, all other TRs are numbered from 0.
+///
+/// The per-TR block lists, exiting blocks, entry blocks and successors are all
+/// computed once, such that the queries are cheap enough to be used inside the
+/// loops of a transformation. The TRs only depend on the CFG and the wait
+/// terminators of the process, so transformations that move or replace other
+/// operations keep the analysis valid and should mark it as preserved.
+///
+/// There is no incremental update for CFG edits: adding, removing or
+/// redirecting an edge can renumber every TR after it, so a transformation
+/// that changes the CFG has to call `recalculate` or let the pass manager
+/// invalidate the analysis.
+///
+/// The analysis can be obtained from the pass analysis manager through
+/// `getAnalysis<TemporalRegionAnalysis>()`.
 struct TemporalRegionAnalysis {
-  using BlockMapT = DenseMap<Block *, int>;
-  using TRMapT = DenseMap<int, SmallVector<Block *, 8>>;
-
   explicit TemporalRegionAnalysis(Operation *op) { recalculate(op); }
 
   void recalculate(Operation *);
 
-  unsigned getNumTemporalRegions() { return numTRs; }
+  unsigned getNumTemporalRegions() const { return numTRs; }
 
-  int getBlockTR(Block *);
-  SmallVector<Block *, 8> getBlocksInTR(int);
+  int getBlockTR(Block *) const;
+  /// Return true if the block belongs to TR `tr`. Blocks that are unreachable
+  /// from the entry block do not belong to any TR.
+  bool isBlockInTR(Block *block, int tr) const {
+    auto it = blockMap.find(block);
+    return it != blockMap.end() && it->second == tr;
+  }
+  ArrayRef<Block *> getBlocksInTR(int tr) const {
+    return getInfo(tr).blocks;
+  }
 
-  SmallVector<Block *, 8> getExitingBlocksInTR(int);
-  Block *getTREntryBlock(int);
-  bool hasSingleExitBlock(int tr) {
-    return getExitingBlocksInTR(tr).size() == 1;
+  ArrayRef<Block *> getExitingBlocksInTR(int tr) const {
+    return getInfo(tr).exitingBlocks;
   }
-  bool isOwnTRSuccessor(int tr) {
-    auto succs = getTRSuccessors(tr);
-    return std::find(succs.begin(), succs.end(), tr) != succs.end();
+  Block *getTREntryBlock(int tr) const { return getInfo(tr).entryBlock; }
+  bool hasSingleExitBlock(int tr) const {
+    return getExitingBlocksInTR(tr).size() == 1;
   }
+  bool isOwnTRSuccessor(int tr) const { return isTRSuccessor(tr, tr); }
 
-  SmallVector<int, 8> getTRSuccessors(int);
-  unsigned getNumTRSuccessors(int tr) { return getTRSuccessors(tr).size(); }
-  unsigned numBlocksInTR(int tr) { return getBlocksInTR(tr).size(); }
+  /// Return true if control can pass from TR `tr` to TR `succ`.
+  bool isTRSuccessor(int tr, int succ) const {
+    return succ >= 0 && getInfo(tr).successorSet.test(succ);
+  }
+  ArrayRef<int> getTRSuccessors(int tr) const { return getInfo(tr).successors; }
+  unsigned getNumTRSuccessors(int tr) const {
+    return getTRSuccessors(tr).size();
+  }
+  unsigned numBlocksInTR(int tr) const { return getBlocksInTR(tr).size(); }
 
 private:
-  unsigned numTRs;
-  BlockMapT blockMap;
-  TRMapT trMap;
+  struct TRInfo {
+    /// The blocks of the TR, in the order they were assigned to it.
+    SmallVector<Block *, 8> blocks;
+    SmallVector<Block *, 2> exitingBlocks;
+    Block *entryBlock = nullptr;
+    /// The successor TRs, in ascending order and as a bitset over all TRs.
+    SmallVector<int, 4> successors;
+    llvm::BitVector successorSet;
+  };
+
+  /// The TRs are stored densely, shifted by one to make room for TR -1.
+  const TRInfo &getInfo(int tr) const {
+    assert(tr >= -1 && tr < static_cast<int>(numTRs) &&
+           "temporal region out of range");
+    return trInfos[tr + 1];
+  }
+
+  unsigned numTRs = 0;
+  DenseMap<Block *, int> blockMap;
+  SmallVector<TRInfo, 8> trInfos;
 };
 
 } // namespace llhd
@@ -0,0 +1,64 @@
+//===- TestTemporalRegionsPass.cpp - Print the LLHD temporal regions ------===//
+//
+// Implement a test pass that prints the result of the temporal region analysis
+// for every process.
+//
+//===----------------------------------------------------------------------===//
+
+#include "TemporalRegions.h"
+#include "circt/Dialect/LLHD/IR/LLHDOps.h"
+#include "mlir/Pass/Pass.h"
+
+using namespace mlir;
+using namespace circt;
+
+namespace {
+struct TestTemporalRegionsPass
+    : public PassWrapper<TestTemporalRegionsPass,
+                         OperationPass<llhd::ProcOp>> {
+  void runOnOperation() override;
+};
+} // namespace
+
+void TestTemporalRegionsPass::runOnOperation() {
+  llhd::ProcOp proc = getOperation();
+  auto &trAnalysis = getAnalysis<llhd::TemporalRegionAnalysis>();
+  markAllAnalysesPreserved();
+
+  // Refer to blocks by their position in the process body.
+  DenseMap<Block *, unsigned> blockIds;
+  for (Block &block : proc.getBlocks())
+    blockIds.insert(std::make_pair(&block, blockIds.size()));
+
+  raw_ostream &os = llvm::errs();
+  auto printBlocks = [&](ArrayRef<Block *> blocks) {
+    llvm::interleaveComma(
+        blocks, os, [&](Block *block) { os << "^bb" << blockIds[block]; });
+  };
+
+  os << "Temporal regions of @" << proc.getName() << ": "
+     << trAnalysis.getNumTemporalRegions() << "\n";
+  for (int tr = -1, e = trAnalysis.getNumTemporalRegions(); tr < e; ++tr) {
+    os << "  TR " << tr << ":\n    blocks: ";
+    printBlocks(trAnalysis.getBlocksInTR(tr));
+    os << "\n    entry: ^bb" << blockIds[trAnalysis.getTREntryBlock(tr)];
+    os << "\n    exiting: ";
+    printBlocks(trAnalysis.getExitingBlocksInTR(tr));
+    os << "\n    successors: ";
+    llvm::interleaveComma(trAnalysis.getTRSuccessors(tr), os);
+    os << "\n    is-successor:";
+    for (int succ = 0; succ < e; ++succ)
+      os << " " << trAnalysis.isTRSuccessor(tr, succ);
+    os << "\n";
+  }
+}
+
+namespace circt {
+namespace llhd {
+void registerTestTemporalRegionsPass() {
+  PassRegistration<TestTemporalRegionsPass>(
+      "test-llhd-temporal-regions",
+      "Print the temporal regions of every process to stderr");
+}
+} // namespace llhd
+} // namespace circt
@@ -11,12 +11,21 @@
 #include "circt/Dialect/SV/Ops.h"
 #include "circt/Dialect/SV/Visitors.h"
 #include "circt/Support/LLVM.h"
+#include "mlir/IR/Diagnostics.h"
 #include "mlir/IR/Module.h"
 #include "mlir/IR/StandardTypes.h"
+#include "mlir/IR/SymbolTable.h"
 #include "mlir/Translation.h"
 #include "llvm/ADT/StringSet.h"
 #include "llvm/ADT/TypeSwitch.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Parallel.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/StringSaver.h"
 #include "llvm/Support/raw_ostream.h"
+#include <atomic>
+#include <numeric>
 
 using namespace circt;
 using namespace firrtl;
@@ -28,11 +37,6 @@ static constexpr bool emitInlineWireDecls = true;
 /// This is the preferred source width for the generated Verilog.
 static constexpr size_t preferredSourceWidth = 120;
 
-/// This is a set accessed through getReservedWords() that contains all of the
-/// Verilog names and other identifiers we need to avoid because of name
-/// conflicts.
-static llvm::ManagedStatic<StringSet<>> reservedWordCache;
-
 //===----------------------------------------------------------------------===//
 // Helper routines
 //===----------------------------------------------------------------------===//
@@ -172,18 +176,99 @@ enum VerilogPrecedence {
 };
 } // end anonymous namespace
 
-/// Return a StringSet that contains all of the reserved names (e.g. Verilog
-/// keywords) that we need to avoid for fear of name conflicts.
-static const StringSet<> &getReservedWords() {
-  auto &set = *reservedWordCache;
-  if (set.empty()) {
-    static const char *const reservedWords[] = {
+namespace {
+/// A perfect hash table of the reserved names (e.g. Verilog keywords) that we
+/// need to avoid for fear of name conflicts.  Checking a name takes a single
+/// hash of it and at most one string comparison.  The words are split into
+/// buckets by their hash, and each bucket gets a displacement that places all
+/// of its words in free slots of the table.
+class ReservedWordTable {
+public:
+  ReservedWordTable();
+
+  bool contains(StringRef name) const {
+    if (name.empty() || name.size() > maxWordLength)
+      return false;
+    uint64_t hash = hashName(name);
+    return slots[getSlot(hash, displacements[hash & (numBuckets - 1)])] ==
+           name;
+  }
+
+private:
+  static constexpr unsigned numBuckets = 64;
+  static constexpr unsigned numSlots = 512;
+
+  static uint64_t hashName(StringRef name) {
+    // FNV-1a.
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (char ch : name)
+      hash = (hash ^ (unsigned char)ch) * 0x100000001b3ULL;
+    return hash;
+  }
+
+  static unsigned getSlot(uint64_t hash, unsigned displacement) {
+    // Rehash with the displacement, such that words that collide for one
+    // displacement are spread apart by another.
+    uint64_t x = hash ^ (displacement * 0x9e3779b97f4a7c15ULL);
+    x = (x ^ (x >> 33)) * 0xff51afd7ed558ccdULL;
+    x = (x ^ (x >> 33)) * 0xc4ceb9fe1a85ec53ULL;
+    return (x ^ (x >> 33)) & (numSlots - 1);
+  }
+
+  unsigned displacements[numBuckets] = {};
+  StringRef slots[numSlots];
+  size_t maxWordLength = 0;
+};
+} // end anonymous namespace
+
+ReservedWordTable::ReservedWordTable() {
+  static const char *const reservedWords[] = {
 #include "ReservedWords.def"
-    };
-    for (auto *word : reservedWords)
-      set.insert(word);
+  };
+
+  SmallVector<SmallVector<StringRef, 8>, numBuckets> buckets(numBuckets);
+  for (StringRef word : reservedWords) {
+    auto &bucket = buckets[hashName(word) & (numBuckets - 1)];
+    if (!llvm::is_contained(bucket, word))
+      bucket.push_back(word);
+    maxWordLength = std::max(maxWordLength, word.size());
+  }
+
+  // Place the largest buckets first, while the table has the most room.
+  SmallVector<unsigned, numBuckets> bucketOrder(numBuckets);
+  std::iota(bucketOrder.begin(), bucketOrder.end(), 0);
+  std::stable_sort(bucketOrder.begin(), bucketOrder.end(),
+                   [&](unsigned lhs, unsigned rhs) {
+                     return buckets[lhs].size() > buckets[rhs].size();
+                   });
+
+  SmallVector<unsigned, 8> bucketSlots;
+  for (unsigned bucketID : bucketOrder) {
+    auto &bucket = buckets[bucketID];
+    for (unsigned displacement = 0;; ++displacement) {
+      bucketSlots.clear();
+      for (StringRef word : bucket) {
+        unsigned slot = getSlot(hashName(word), displacement);
+        if (!slots[slot].empty() || llvm::is_contained(bucketSlots, slot))
+          break;
+        bucketSlots.push_back(slot);
+      }
+      if (bucketSlots.size() != bucket.size())
+        continue;
+
+      displacements[bucketID] = displacement;
+      for (unsigned i = 0, e = bucket.size(); i != e; ++i)
+        slots[bucketSlots[i]] = bucket[i];
+      break;
+    }
   }
-  return set;
+}
+
+/// Return true if the specified name is reserved.  The table is built once
+/// and shared by modules emitted in parallel.
+static bool isReservedWord(StringRef name) {
+  static const ReservedWordTable table;
+  return table.contains(name);
 }
 
 //===----------------------------------------------------------------------===//
@@ -195,12 +280,17 @@ namespace {
 /// various emitters.
 class VerilogEmitterState {
 public:
-  explicit VerilogEmitterState(raw_ostream &os) : os(os) {}
+  explicit VerilogEmitterState(raw_ostream &os,
+                               VerilogEmitterOptions options = {})
+      : os(os), options(options) {}
 
   /// The stream to emit to.
   raw_ostream &os;
 
-  bool encounteredError = false;
+  const VerilogEmitterOptions options;
+
+  /// This is set from multiple threads when modules are emitted in parallel.
+  std::atomic<bool> encounteredError{false};
   unsigned currentIndent = 0;
 
 private:
@@ -275,6 +365,26 @@ void VerilogEmitterBase::emitTypePaddedToWidth(Type type, size_t padToWidth,
 //===----------------------------------------------------------------------===//
 
 namespace {
+/// DenseMap traits for a sorted set of locations, given as opaque pointers.
+struct LocationSetInfo {
+  static ArrayRef<const void *> getEmptyKey() {
+    return makeArrayRef(
+        reinterpret_cast<const void *const *>(~uintptr_t(0)), size_t(0));
+  }
+  static ArrayRef<const void *> getTombstoneKey() {
+    return makeArrayRef(
+        reinterpret_cast<const void *const *>(~uintptr_t(1)), size_t(0));
+  }
+  static unsigned getHashValue(ArrayRef<const void *> locations) {
+    return llvm::hash_combine_range(locations.begin(), locations.end());
+  }
+  static bool isEqual(ArrayRef<const void *> lhs, ArrayRef<const void *> rhs) {
+    if (rhs.data() == getEmptyKey().data() ||
+        rhs.data() == getTombstoneKey().data())
+      return lhs.data() == rhs.data();
+    return lhs == rhs;
+  }
+};
 
 class ModuleEmitter : public VerilogEmitterBase {
 
@@ -317,6 +427,7 @@ public:
 
   void collectNamesEmitDecls(Block &block);
   bool collectNamesEmitWires(rtl::RTLInstanceOp &inst);
+  StringRef legalizeName(StringRef name);
   StringRef addName(Value value, StringRef name);
   StringRef addName(Value value, StringAttr nameAttr) {
     return addName(value, nameAttr ? nameAttr.getValue() : "");
@@ -328,8 +439,9 @@ public:
     return entry->getKey();
   }
 
-  /// Return the location information as a (potentially empty) string.
-  std::string getLocationInfoAsString(const SmallPtrSet<Operation *, 8> &ops);
+  /// Return the location information as a (potentially empty) string.  The
+  /// string lives as long as the module emitter.
+  StringRef getLocationInfoAsString(const SmallPtrSet<Operation *, 8> &ops);
 
   /// If we have location information for any of the specified operations,
   /// aggregate it together and print a pretty comment specifying where the
@@ -350,31 +462,53 @@ public:
   // Note: Preprocessor conditions are defined in the ConditionalStatement
   // struct below.
 
-  void addDeclaration(std::string action, std::string locInfo,
-                      std::string ppCond, unsigned partialOrder = 0) {
-    conditionalStmts.push_back({ConditionalStmtKind::Declaration, "",
-                                std::move(ppCond), "", partialOrder,
-                                std::move(action), std::move(locInfo)});
+  void addDeclaration(const Twine &action, StringRef locInfo, StringRef ppCond,
+                      unsigned partialOrder = 0) {
+    addConditionalStatement(ConditionalStmtKind::Declaration, action, locInfo,
+                            "", ppCond, "", partialOrder);
   }
 
-  void addInitial(std::string action, std::string locInfo,
-                  std::string ppCond = {}, std::string condition = {},
-                  unsigned partialOrder = 0) {
-    conditionalStmts.push_back({ConditionalStmtKind::Initial, "",
-                                std::move(ppCond), std::move(condition),
-                                partialOrder, std::move(action),
-                                std::move(locInfo)});
+  void addInitial(const Twine &action, StringRef locInfo, StringRef ppCond = {},
+                  StringRef condition = {}, unsigned partialOrder = 0) {
+    addConditionalStatement(ConditionalStmtKind::Initial, action, locInfo, "",
+                            ppCond, condition, partialOrder);
   }
 
-  void addAtPosEdge(std::string action, std::string locInfo, std::string clock,
-                    std::string ppCond = {}, std::string condition = {},
+  void addAtPosEdge(const Twine &action, StringRef locInfo, StringRef clock,
+                    StringRef ppCond = {}, StringRef condition = {},
                     unsigned partialOrder = 0) {
-    conditionalStmts.push_back({ConditionalStmtKind::AlwaysAtPosEdge,
-                                std::move(clock), std::move(ppCond),
-                                std::move(condition), partialOrder,
-                                std::move(action), std::move(locInfo)});
+    addConditionalStatement(ConditionalStmtKind::AlwaysAtPosEdge, action,
+                            locInfo, clock, ppCond, condition, partialOrder);
   }
 
+  /// The location info has to live as long as the module emitter, like the
+  /// strings returned by getLocationInfoAsString.
+  void addConditionalStatement(ConditionalStmtKind kind, const Twine &action,
+                               StringRef locInfo, StringRef clock,
+                               StringRef ppCond, StringRef condition,
+                               unsigned partialOrder) {
+    conditionalStmts.push_back(
+        {kind, getConditionKeyID(clock), getConditionKeyID(ppCond),
+         getConditionKeyID(condition), partialOrder,
+         savedStrings.save(action), locInfo});
+  }
+
+  /// Return the small integer that stands for the specified clock, ppCond or
+  /// condition of a conditional statement.  The empty string is always 0.
+  unsigned getConditionKeyID(StringRef key) {
+    if (key.empty())
+      return 0;
+    auto it = conditionKeyIDs.try_emplace(key, conditionKeys.size());
+    if (it.second)
+      conditionKeys.push_back(it.first->getKey());
+    return it.first->second;
+  }
+
+  /// Return the string of a clock, ppCond or condition key.
+  StringRef getConditionKey(unsigned id) const { return conditionKeys[id]; }
+
+  void emitConditionalStatements();
+
   // Set up the per-module state for random seeding of registers/memory.
   void emitRandomizeProlog() {
     // Only emit this prolog once.
@@ -391,18 +525,18 @@ public:
     /// initial block of something else.
     ConditionalStmtKind kind;
 
-    /// For "always @" blocks, this is the clock expression they are gated on.
-    /// This is empty for 'initial' blocks.
-    std::string clock;
+    /// For "always @" blocks, this is the key of the clock expression they are
+    /// gated on.  This is 0 (empty) for 'initial' blocks.
+    unsigned clock;
 
-    /// If non-empty, this is a preprocessor condition that gates the statement.
-    /// If the string starts with a ! character, then this is an `ifndef
-    /// condition, otherwise it is an `ifdef condition.
-    std::string ppCond;
+    /// If non-zero, this is the key of a preprocessor condition that gates the
+    /// statement.  If the string starts with a ! character, then this is an
+    /// `ifndef condition, otherwise it is an `ifdef condition.
+    unsigned ppCond;
 
-    /// If non-empty, this is an 'if' condition that gates the statement.  If
-    /// empty, the statement is unconditional.
-    std::string condition;
+    /// If non-zero, this is the key of an 'if' condition that gates the
+    /// statement.  If zero, the statement is unconditional.
+    unsigned condition;
 
     /// This is used to sort entries that have some partial ordering w.r.t. each
     /// other.  This can only be used to order actions conditionalized by the
@@ -412,31 +546,48 @@ public:
     /// This is the statement to emit.  If there is a condition, this should
     /// always be a single verilog statement that can be emitted without a
     /// begin/end clause.
-    std::string action;
+    StringRef action;
 
     /// This is location information (if any) to print.
-    std::string locInfo;
-
-    bool operator<(const ConditionalStatement &rhs) const {
-      return std::make_tuple(kind, clock, ppCond, condition, partialOrder,
-                             action, locInfo) <
-             std::make_tuple(rhs.kind, rhs.clock, rhs.ppCond, rhs.condition,
-                             rhs.partialOrder, rhs.action, locInfo);
-    }
+    StringRef locInfo;
   };
 
   // Per module states.
   std::vector<ConditionalStatement> conditionalStmts;
 
-  llvm::StringSet<> usedNames;
-  llvm::DenseMap<Value, llvm::StringMapEntry<llvm::NoneType> *> nameTable;
-  size_t nextGeneratedNameID = 0;
+  /// The actions and location info of the conditional statements, and the
+  /// legalized names.
+  llvm::BumpPtrAllocator allocator;
+  llvm::StringSaver savedStrings{allocator};
+
+  /// The clock, ppCond and condition strings of the conditional statements,
+  /// indexed by their key.
+  llvm::StringMap<unsigned> conditionKeyIDs;
+  SmallVector<StringRef, 16> conditionKeys{StringRef()};
+
+  /// The names in use.  The value of a name is the next suffix to try when it
+  /// is the base of an auto-uniqued name.
+  llvm::StringMap<size_t> usedNames;
+  llvm::DenseMap<Value, llvm::StringMapEntry<size_t> *> nameTable;
+
+  /// The legal Verilog spelling of the names that needed escaping.
+  llvm::StringMap<StringRef> legalizedNames;
+
+  /// The rendered location info of each set of locations, keyed by the sorted
+  /// opaque pointers of the locations.
+  llvm::DenseMap<ArrayRef<const void *>, StringRef, LocationSetInfo>
+      locationInfoCache;
 
   /// This set keeps track of all of the expression nodes that need to be
   /// emitted as standalone wire declarations.  This can happen because they are
   /// multiply-used or because the user requires a name to reference.
   SmallPtrSet<Operation *, 16> outOfLineExpressions;
 
+  /// The scratch buffer that expressions are rendered into before they are
+  /// written to the stream.  It is reused by all expressions of the module, so
+  /// emitting an expression doesn't allocate once it has grown large enough.
+  SmallString<256> exprBuffer;
+
   // This is set to true after the first RANDOMIZE prolog has been emitted in
   // this module to the initial block.
   bool emittedRandomProlog = false;
@@ -445,71 +596,68 @@ public:
 
 } // end anonymous namespace
 
-/// Add the specified name to the name table, auto-uniquing the name if
-/// required.  If the name is empty, then this creates a unique temp name.
-StringRef ModuleEmitter::addName(Value value, StringRef name) {
-  if (name.empty())
-    name = "_T";
-
-  // Check to see if this name is valid.  The first character cannot be a
-  // number of other weird thing.  If it is, start with an underscore.
-  if (!isalpha(name.front()) && name.front() != '_') {
-    SmallString<16> tmpName("_");
-    tmpName += name;
-    return addName(value, tmpName);
-  }
-
+/// Return the legal Verilog spelling of the specified name.  The first
+/// character cannot be a number or other weird thing, if it is, start with an
+/// underscore.  Invalid characters are escaped.
+StringRef ModuleEmitter::legalizeName(StringRef name) {
   auto isValidVerilogCharacter = [](char ch) -> bool {
     return isalpha(ch) || isdigit(ch) || ch == '_';
   };
 
-  // Check to see if the name consists of all-valid identifiers.  If not, we
-  // need to escape them.
+  bool needsPrefix = !isalpha(name.front()) && name.front() != '_';
+  if (!needsPrefix && llvm::all_of(name, isValidVerilogCharacter))
+    return name;
+
+  // Each spelling is only legalized once.
+  auto &legalName = legalizedNames[name];
+  if (!legalName.empty())
+    return legalName;
+
+  SmallString<32> tmpName;
+  if (needsPrefix)
+    tmpName += '_';
   for (char ch : name) {
     if (isValidVerilogCharacter(ch))
-      continue;
-
-    // Otherwise, we need to escape it.
-    SmallString<16> tmpName;
-    for (char ch : name) {
-      if (isValidVerilogCharacter(ch))
-        tmpName += ch;
-      else if (ch == ' ')
-        tmpName += '_';
-      else {
-        tmpName += llvm::utohexstr((unsigned char)ch);
-      }
-    }
-    return addName(value, tmpName);
+      tmpName += ch;
+    else if (ch == ' ')
+      tmpName += '_';
+    else
+      tmpName += llvm::utohexstr((unsigned char)ch);
   }
+  legalName = savedStrings.save(tmpName);
+  return legalName;
+}
 
-  // Get the list of reserved words we need to avoid.  We could prepopulate this
-  // into the used words cache, but it is large and immutable, so we just query
-  // it when needed.
-  auto &reservedWords = getReservedWords();
+/// Add the specified name to the name table, auto-uniquing the name if
+/// required.  If the name is empty, then this creates a unique temp name.
+StringRef ModuleEmitter::addName(Value value, StringRef name) {
+  if (name.empty())
+    name = "_T";
+  name = legalizeName(name);
 
   // Check to see if this name is available - if so, use it.
-  if (!reservedWords.count(name)) {
-    auto insertResult = usedNames.insert(name);
+  if (!isReservedWord(name)) {
+    auto insertResult = usedNames.try_emplace(name, 0);
     if (insertResult.second) {
       nameTable[value] = &*insertResult.first;
       return insertResult.first->getKey();
     }
   }
 
-  // If not, we need to auto-unique it.
-  SmallVector<char, 16> nameBuffer(name.begin(), name.end());
+  // If not, we need to auto-unique it.  Every base name counts its own
+  // suffixes, so this only takes more than one attempt if the generated name
+  // was taken by some other name.  Map entries never move, so the counter
+  // stays valid while names are added.
+  size_t &nextSuffix = usedNames[name];
+  SmallString<32> nameBuffer(name);
   nameBuffer.push_back('_');
   auto baseSize = nameBuffer.size();
 
   // Try until we find something that works.
   while (1) {
-    auto suffix = llvm::utostr(nextGeneratedNameID++);
-    nameBuffer.append(suffix.begin(), suffix.end());
-    name = StringRef(nameBuffer.data(), nameBuffer.size());
-
-    if (!reservedWords.count(name)) {
-      auto insertResult = usedNames.insert(name);
+    llvm::raw_svector_ostream(nameBuffer) << nextSuffix++;
+    if (!isReservedWord(nameBuffer)) {
+      auto insertResult = usedNames.try_emplace(nameBuffer, 0);
       if (insertResult.second) {
         nameTable[value] = &*insertResult.first;
         return insertResult.first->getKey();
@@ -521,20 +669,9 @@ StringRef ModuleEmitter::addName(Value value, StringRef name) {
   }
 }
 
-/// Return the location information as a (potentially empty) string.
-std::string
-ModuleEmitter::getLocationInfoAsString(const SmallPtrSet<Operation *, 8> &ops) {
-  std::string resultStr;
-  llvm::raw_string_ostream sstr(resultStr);
-
-  // Multiple operations may come from the same location or may not have useful
-  // location info.  Unique it now.
-  SmallPtrSet<Attribute, 8> locations;
-  for (auto *op : ops) {
-    if (auto loc = op->getLoc().dyn_cast<FileLineColLoc>())
-      locations.insert(loc);
-  }
-
+/// Print the specified set of FileLineColLocs, given as opaque pointers.
+static void printLocationInfo(ArrayRef<const void *> locations,
+                              raw_ostream &sstr) {
   auto printLoc = [&](FileLineColLoc loc) {
     sstr << loc.getFilename();
     if (auto line = loc.getLine()) {
@@ -544,21 +681,18 @@ ModuleEmitter::getLocationInfoAsString(const SmallPtrSet<Operation *, 8> &ops) {
     }
   };
 
-  switch (locations.size()) {
-  case 1:
-    printLoc((*locations.begin()).cast<FileLineColLoc>());
-    LLVM_FALLTHROUGH;
-  case 0:
-    return sstr.str();
-  default:
-    break;
+  if (locations.size() == 1) {
+    printLoc(Attribute::getFromOpaquePointer(locations.front())
+                 .cast<FileLineColLoc>());
+    return;
   }
 
   // Sort the entries.
   SmallVector<FileLineColLoc, 8> locVector;
   locVector.reserve(locations.size());
-  for (auto loc : locations)
-    locVector.push_back(loc.cast<FileLineColLoc>());
+  for (auto *loc : locations)
+    locVector.push_back(
+        Attribute::getFromOpaquePointer(loc).cast<FileLineColLoc>());
 
   llvm::array_pod_sort(
       locVector.begin(), locVector.end(),
@@ -611,8 +745,43 @@ ModuleEmitter::getLocationInfoAsString(const SmallPtrSet<Operation *, 8> &ops) {
     }
     sstr << '}';
   }
+}
 
-  return sstr.str();
+/// Return the location information as a (potentially empty) string.  Most
+/// statements share a handful of locations, so the text is rendered once per
+/// set of locations and cached for the rest of the module.
+StringRef
+ModuleEmitter::getLocationInfoAsString(const SmallPtrSet<Operation *, 8> &ops) {
+  if (state.options.dropLocationInfo)
+    return {};
+
+  // Multiple operations may come from the same location or may not have useful
+  // location info.  Unique it now.
+  SmallVector<const void *, 8> locations;
+  for (auto *op : ops) {
+    if (auto loc = op->getLoc().dyn_cast<FileLineColLoc>())
+      locations.push_back(loc.getAsOpaquePointer());
+  }
+  if (locations.empty())
+    return {};
+  llvm::array_pod_sort(locations.begin(), locations.end());
+  locations.erase(std::unique(locations.begin(), locations.end()),
+                  locations.end());
+
+  auto it = locationInfoCache.find(locations);
+  if (it != locationInfoCache.end())
+    return it->second;
+
+  SmallString<64> resultStr;
+  llvm::raw_svector_ostream sstr(resultStr);
+  printLocationInfo(locations, sstr);
+
+  // The key is stored in the arena, like the text.
+  auto *key = allocator.Allocate<const void *>(locations.size());
+  std::uninitialized_copy(locations.begin(), locations.end(), key);
+  StringRef result = savedStrings.save(resultStr);
+  locationInfoCache.insert({makeArrayRef(key, locations.size()), result});
+  return result;
 }
 
 /// If we have location information for any of the specified operations,
@@ -683,7 +852,10 @@ public:
   /// Create an ExprEmitter for the specified module emitter, and keeping track
   /// of any emitted expressions in the specified set.
   ExprEmitter(ModuleEmitter &emitter, SmallPtrSet<Operation *, 8> &emittedExprs)
-      : emitter(emitter), emittedExprs(emittedExprs), os(resultBuffer) {}
+      : emitter(emitter), emittedExprs(emittedExprs),
+        resultBuffer(emitter.exprBuffer), os(resultBuffer) {
+    resultBuffer.clear();
+  }
 
   void emitExpression(Value exp, bool forceRootExpr, raw_ostream &os);
 
@@ -881,7 +1053,10 @@ private:
 
 private:
   SmallPtrSet<Operation *, 8> &emittedExprs;
-  SmallString<128> resultBuffer;
+
+  /// The expression is rendered into the scratch buffer of the module emitter,
+  /// only one expression of a module is emitted at a time.
+  SmallString<256> &resultBuffer;
   llvm::raw_svector_ostream os;
 };
 } // end anonymous namespace
@@ -1300,7 +1475,8 @@ ModuleEmitter::emitExpressionToString(Value exp,
 
 void ModuleEmitter::emitStatementExpression(Operation *op) {
   // This is invoked for expressions that have a non-single use.  This could
-  // either be because they are dead or because they have multiple uses.
+  // either be because they are dead or because they have multiple uses.  It is
+  // also used for subexpressions that are split off of large expressions.
   if (op->getResult(0).use_empty()) {
     indent() << "// Unused: ";
   } else if (emitInlineWireDecls) {
@@ -1357,10 +1533,9 @@ void ModuleEmitter::emitStatement(ConnectOp op) {
   // Connect to a register has "special" behavior.
   auto lhs = op.lhs();
   auto addRegAssign = [&](const std::string &clockExpr, Value value) {
-    std::string action =
-        getName(lhs).str() + " <= " + emitExpressionToString(value, ops) + ";";
+    auto valueStr = emitExpressionToString(value, ops);
     auto locStr = getLocationInfoAsString(ops);
-    addAtPosEdge(action, locStr, clockExpr);
+    addAtPosEdge(getName(lhs) + " <= " + valueStr + ";", locStr, clockExpr);
     return;
   };
 
@@ -1471,7 +1646,8 @@ void ModuleEmitter::emitStatement(sv::FWriteOp op) {
   os << '"';
 
   for (auto operand : op.operands()) {
-    os << ", " << emitExpressionToString(operand, ops);
+    os << ", ";
+    emitExpression(operand, ops);
   }
   os << ");";
   emitLocationInfoAndNewLine(ops);
@@ -1551,7 +1727,9 @@ void ModuleEmitter::emitStatement(sv::IfOp op) {
   SmallPtrSet<Operation *, 8> ops;
   ops.insert(op);
 
-  indent() << "if (" << emitExpressionToString(op.cond(), ops) << ')';
+  indent() << "if (";
+  emitExpression(op.cond(), ops);
+  os << ')';
   emitBeginEndRegion(op.getBodyBlock(), ops, *this);
 }
 
@@ -1559,8 +1737,9 @@ void ModuleEmitter::emitStatement(sv::AlwaysAtPosEdgeOp op) {
   SmallPtrSet<Operation *, 8> ops;
   ops.insert(op);
 
-  indent() << "always @(posedge " << emitExpressionToString(op.clock(), ops)
-           << ")";
+  indent() << "always @(posedge ";
+  emitExpression(op.clock(), ops);
+  os << ')';
   emitBeginEndRegion(op.getBodyBlock(), ops, *this, "always @(posedge)");
 }
 
@@ -1704,9 +1883,9 @@ void ModuleEmitter::emitDecl(RegOp op) {
   emitRandomizeProlog();
 
   // At simulator load time, the register is set to random nothing.
-  std::string action = getName(op.getResult()).str() + " = `RANDOM;";
   auto locInfo = getLocationInfoAsString(ops);
-  addInitial(action, locInfo, /*ppCond*/ "RANDOMIZE_REG_INIT");
+  addInitial(getName(op.getResult()) + " = `RANDOM;", locInfo,
+             /*ppCond*/ "RANDOMIZE_REG_INIT");
 }
 
 void ModuleEmitter::emitDecl(RegInitOp op) {
@@ -1720,12 +1899,10 @@ void ModuleEmitter::emitDecl(RegInitOp op) {
   auto locInfo = getLocationInfoAsString(ops);
 
   emitRandomizeProlog();
-  std::string action = getName(op.getResult()).str() + " = `RANDOM;";
-  addInitial(action, locInfo, /*ppCond*/ "RANDOMIZE_REG_INIT",
-             /*cond*/ "~" + resetSignal);
-
-  action = getName(op.getResult()).str() + " = " + resetValue + ";";
-  addInitial(action, locInfo, /*ppCond*/ "", /*cond*/ resetSignal);
+  addInitial(getName(op.getResult()) + " = `RANDOM;", locInfo,
+             /*ppCond*/ "RANDOMIZE_REG_INIT", /*cond*/ "~" + resetSignal);
+  addInitial(getName(op.getResult()) + " = " + resetValue + ";", locInfo,
+             /*ppCond*/ "", /*cond*/ resetSignal);
 }
 
 void ModuleEmitter::emitDecl(MemOp op) {
@@ -1967,6 +2144,57 @@ void ModuleEmitter::collectNamesEmitDecls(Block &block) {
   SmallVector<FlatBundleFieldEntry, 8> fieldTypes;
   SmallVector<Operation *, 16> declsToEmit;
   bool rtlInstanceDeclaredWires = false;
+
+  // The size and depth of the expression tree that is inlined at each inline
+  // expression.  If the tree of an expression exceeds the limits, its largest
+  // or deepest operand trees are emitted out of line until it fits.
+  DenseMap<Operation *, std::pair<unsigned, unsigned>> inlineTrees;
+  auto maxSize = state.options.maxExpressionSize;
+  auto maxDepth = state.options.maxExpressionDepth;
+  auto limitInlineTree = [&](Operation *op) {
+    // Noop casts are not printed, they don't count.
+    unsigned ownSize = isNoopCast(op) ? 0 : 1;
+    while (true) {
+      unsigned size = ownSize, depth = ownSize;
+      for (auto operand : op->getOperands()) {
+        auto it = inlineTrees.find(operand.getDefiningOp());
+        if (it == inlineTrees.end())
+          continue;
+        size += it->second.first;
+        depth = std::max(depth, it->second.second + ownSize);
+      }
+      bool tooLarge = maxSize && size > maxSize;
+      bool tooDeep = maxDepth && depth > maxDepth;
+      if (!tooLarge && !tooDeep) {
+        inlineTrees[op] = {size, depth};
+        return;
+      }
+
+      // Pick the operand tree to spill.  Trees that are always inline stay.
+      Operation *spill = nullptr;
+      std::pair<unsigned, unsigned> spillTree;
+      for (auto operand : op->getOperands()) {
+        auto it = inlineTrees.find(operand.getDefiningOp());
+        if (it == inlineTrees.end() || isExpressionAlwaysInline(it->first))
+          continue;
+        auto tree = it->second;
+        if (tooLarge ? tree.first > spillTree.first
+                     : tree.second > spillTree.second) {
+          spill = it->first;
+          spillTree = tree;
+        }
+      }
+
+      // If there is nothing left to spill, the tree is as small as it gets.
+      if (!spill) {
+        inlineTrees[op] = {size, depth};
+        return;
+      }
+      inlineTrees.erase(spill);
+      outOfLineExpressions.insert(spill);
+      addName(spill->getResult(0), spill->getAttrOfType<StringAttr>("name"));
+    }
+  };
   for (auto &op : block) {
     if (auto rtlInstance = dyn_cast<rtl::RTLInstanceOp>(op)) {
       rtlInstanceDeclaredWires |= collectNamesEmitWires(rtlInstance);
@@ -1983,8 +2211,12 @@ void ModuleEmitter::collectNamesEmitDecls(Block &block) {
     bool isExpr = isVerilogExpression(&op);
     if (isExpr) {
       // If this expression is dead, or can be emitted inline, ignore it.
-      if (result.use_empty() || isExpressionEmittedInline(&op))
+      if (result.use_empty())
+        continue;
+      if (isExpressionEmittedInline(&op)) {
+        limitInlineTree(&op);
         continue;
+      }
 
       // Remember that this expression should be emitted out of line.
       outOfLineExpressions.insert(&op);
@@ -2237,8 +2469,9 @@ static void
 emitActionByCond(ArrayRef<ModuleEmitter::ConditionalStatement> elements,
                  ModuleEmitter &emitter) {
   bool indentChildren = true;
-  if (!elements[0].condition.empty()) {
-    emitter.indent() << "if (" << elements[0].condition << ") ";
+  StringRef condition = emitter.getConditionKey(elements[0].condition);
+  if (!condition.empty()) {
+    emitter.indent() << "if (" << condition << ") ";
     if (elements.size() != 1) {
       emitter.os << "begin\n";
       emitter.addIndent();
@@ -2273,7 +2506,7 @@ emitActionByCond(ArrayRef<ModuleEmitter::ConditionalStatement> elements,
     emitter.os << '\n';
   }
 
-  if (!elements[0].condition.empty() && elements.size() != 1) {
+  if (!condition.empty() && elements.size() != 1) {
     emitter.reduceIndent();
     emitter.indent() << "end\n";
   }
@@ -2283,27 +2516,26 @@ emitActionByCond(ArrayRef<ModuleEmitter::ConditionalStatement> elements,
 static void
 emitCondActionByPPCond(ArrayRef<ModuleEmitter::ConditionalStatement> elements,
                        ModuleEmitter &emitter) {
-  if (!elements[0].ppCond.empty()) {
-    if (elements[0].ppCond.front() == '!')
-      emitter.indent() << "`ifndef "
-                       << StringRef(elements[0].ppCond).drop_front() << '\n';
+  StringRef ppCond = emitter.getConditionKey(elements[0].ppCond);
+  if (!ppCond.empty()) {
+    if (ppCond.front() == '!')
+      emitter.indent() << "`ifndef " << ppCond.drop_front() << '\n';
     else
-      emitter.indent() << "`ifdef " << elements[0].ppCond << '\n';
+      emitter.indent() << "`ifdef " << ppCond << '\n';
     emitter.addIndent();
   }
 
-  splitByPredicate(
-      emitter, elements, emitActionByCond,
-      [](const ModuleEmitter::ConditionalStatement &condStmt) -> StringRef {
-        return condStmt.condition;
-      });
+  splitByPredicate(emitter, elements, emitActionByCond,
+                   [](const ModuleEmitter::ConditionalStatement &condStmt) {
+                     return condStmt.condition;
+                   });
 
-  if (!elements[0].ppCond.empty()) {
+  if (!ppCond.empty()) {
     emitter.reduceIndent();
     // Only print the macro again if there was a reasonable amount of stuff
     // being guarded.
     if (elements.size() > 1)
-      emitter.indent() << "`endif // " << elements[0].ppCond << '\n';
+      emitter.indent() << "`endif // " << ppCond << '\n';
     else
       emitter.indent() << "`endif\n";
   }
@@ -2314,7 +2546,8 @@ emitCondActionByPPCond(ArrayRef<ModuleEmitter::ConditionalStatement> elements,
 static void
 emitPosEdgeByClock(ArrayRef<ModuleEmitter::ConditionalStatement> elements,
                    ModuleEmitter &emitter) {
-  emitter.indent() << "always @(posedge " << elements[0].clock << ") begin\n";
+  emitter.indent() << "always @(posedge "
+                   << emitter.getConditionKey(elements[0].clock) << ") begin\n";
   emitter.addIndent();
   splitByPredicate(emitter, elements, emitCondActionByPPCond,
                    [](const ModuleEmitter::ConditionalStatement &condStmt) {
@@ -2343,7 +2576,7 @@ emitConditionStmtKind(ArrayRef<ModuleEmitter::ConditionalStatement> elements,
     emitter.indent() << "`ifndef SYNTHESIS\n";
     emitter.indent() << "initial begin\n";
     emitter.addIndent();
-    assert(elements[0].clock.empty() && "initial members can't have a clock");
+    assert(!elements[0].clock && "initial members can't have a clock");
 
     splitByPredicate(emitter, elements, emitCondActionByPPCond,
                      [](const ModuleEmitter::ConditionalStatement &condStmt) {
@@ -2364,6 +2597,41 @@ emitConditionStmtKind(ArrayRef<ModuleEmitter::ConditionalStatement> elements,
   }
 }
 
+/// Emit the conditional statements at the bottom of the module.  Start by
+/// sorting the list to group by kind.
+void ModuleEmitter::emitConditionalStatements() {
+  // Order the keys like the strings they stand for, such that the output does
+  // not depend on the order they were first used in.
+  SmallVector<unsigned, 16> keyOrder(conditionKeys.size());
+  std::iota(keyOrder.begin(), keyOrder.end(), 0);
+  llvm::sort(keyOrder, [&](unsigned lhs, unsigned rhs) {
+    return conditionKeys[lhs] < conditionKeys[rhs];
+  });
+  SmallVector<unsigned, 16> keyRank(conditionKeys.size());
+  for (unsigned i = 0, e = keyOrder.size(); i != e; ++i)
+    keyRank[keyOrder[i]] = i;
+
+  std::stable_sort(
+      conditionalStmts.begin(), conditionalStmts.end(),
+      [&](const ConditionalStatement &lhs, const ConditionalStatement &rhs) {
+        auto lhsKey = std::make_tuple(lhs.kind, keyRank[lhs.clock],
+                                      keyRank[lhs.ppCond],
+                                      keyRank[lhs.condition], lhs.partialOrder);
+        auto rhsKey = std::make_tuple(rhs.kind, keyRank[rhs.clock],
+                                      keyRank[rhs.ppCond],
+                                      keyRank[rhs.condition], rhs.partialOrder);
+        if (lhsKey != rhsKey)
+          return lhsKey < rhsKey;
+        return lhs.action < rhs.action;
+      });
+
+  // Emit conditional statements by groups.
+  splitByPredicate(
+      *this, conditionalStmts, emitConditionStmtKind,
+      [](const ModuleEmitter::ConditionalStatement &condStmt)
+          -> ModuleEmitter::ConditionalStmtKind { return condStmt.kind; });
+}
+
 void ModuleEmitter::emitFModule(FModuleOp module) {
   // Add all the ports to the name table.
   SmallVector<ModulePortInfo, 8> portInfo;
@@ -2454,15 +2722,8 @@ void ModuleEmitter::emitFModule(FModuleOp module) {
     emitOperation(&op);
   }
 
-  // Emit the conditional statements at the bottom.  Start by sorting the list
-  // to group by kind.
-  std::stable_sort(conditionalStmts.begin(), conditionalStmts.end());
-
-  // Emit conditional statements by groups.
-  splitByPredicate(
-      *this, conditionalStmts, emitConditionStmtKind,
-      [](const ModuleEmitter::ConditionalStatement &condStmt)
-          -> ModuleEmitter::ConditionalStmtKind { return condStmt.kind; });
+  // Emit the conditional statements at the bottom.
+  emitConditionalStatements();
   reduceIndent();
 
   os << "endmodule\n\n";
@@ -2486,7 +2747,7 @@ void ModuleEmitter::emitRTLModule(rtl::RTLModuleOp module) {
       name = "<<NO-NAME-FOUND>>";
     }
     if (port.isOutput())
-      usedNames.insert(name);
+      usedNames.try_emplace(name, 0);
     else
       addName(module.getArgument(port.argNum), name);
   }
@@ -2576,15 +2837,8 @@ void ModuleEmitter::emitRTLModule(rtl::RTLModuleOp module) {
     emitOperation(&op);
   }
 
-  // Emit the conditional statements at the bottom.  Start by sorting the list
-  // to group by kind.
-  std::stable_sort(conditionalStmts.begin(), conditionalStmts.end());
-
-  // Emit conditional statements by groups.
-  splitByPredicate(
-      *this, conditionalStmts, emitConditionStmtKind,
-      [](const ModuleEmitter::ConditionalStatement &condStmt)
-          -> ModuleEmitter::ConditionalStmtKind { return condStmt.kind; });
+  // Emit the conditional statements at the bottom.
+  emitConditionalStatements();
   reduceIndent();
 
   os << "endmodule\n\n";
@@ -2602,13 +2856,20 @@ public:
 
   void emitMLIRModule(ModuleOp module);
 
+  /// Emit the macros that precede the modules of a circuit.
+  void emitCircuitHeader();
+
+  /// Emit the specified FIRRTL or RTL module.  Return false if the operation
+  /// is not a module that has a Verilog definition.
+  bool emitModule(Operation *op);
+
 private:
-  void emitCircuit(CircuitOp circuit);
+  void emitModules(ArrayRef<Operation *> ops);
 };
 
 } // end anonymous namespace
 
-void CircuitEmitter::emitCircuit(CircuitOp circuit) {
+void CircuitEmitter::emitCircuitHeader() {
   // TODO(QoI): Emit file header, indicating the name of the circuit,
   // location info and any other interesting metadata (e.g. comment
   // block) attached to it.
@@ -2665,47 +2926,271 @@ void CircuitEmitter::emitCircuit(CircuitOp circuit) {
   `define INIT_RANDOM_PROLOG_
 `endif
 )XXX";
+}
 
-  for (auto &op : *circuit.getBody()) {
-    if (auto module = dyn_cast<FModuleOp>(op)) {
-      ModuleEmitter(state).emitFModule(module);
-      continue;
-    } else if (auto module = dyn_cast<rtl::RTLModuleOp>(op)) {
-      ModuleEmitter(state).emitRTLModule(module);
-      continue;
-    } else if (auto module = dyn_cast<rtl::RTLExternModuleOp>(op)) {
-      ModuleEmitter(state).emitRTLExternModule(module);
-      continue;
-    }
+bool CircuitEmitter::emitModule(Operation *op) {
+  if (auto module = dyn_cast<FModuleOp>(op))
+    ModuleEmitter(state).emitFModule(module);
+  else if (auto module = dyn_cast<rtl::RTLModuleOp>(op))
+    ModuleEmitter(state).emitRTLModule(module);
+  else if (auto module = dyn_cast<rtl::RTLExternModuleOp>(op))
+    ModuleEmitter(state).emitRTLExternModule(module);
+  else
+    return false;
+  return true;
+}
 
-    // Ignore the done terminator at the end of the circuit.
-    // Ignore 'ext modules'.
-    if (isa<firrtl::DoneOp>(op) || isa<FExtModuleOp>(op))
-      continue;
+/// Apply `fn` to the index of each of the given operations, concurrently if
+/// the context has multithreading enabled.  Diagnostics are reported in the
+/// order of the operations, as in a serial run.
+template <typename FnT>
+static void parallelForEachOp(ArrayRef<Operation *> ops, FnT &&fn) {
+  if (ops.empty())
+    return;
+  auto *context = ops.front()->getContext();
+  if (!context->isMultithreadingEnabled() || ops.size() < 2) {
+    for (size_t i = 0, e = ops.size(); i != e; ++i)
+      fn(i);
+    return;
+  }
+
+  ParallelDiagnosticHandler diagnostics(context);
+  llvm::parallelForEachN(0, ops.size(), [&](size_t i) {
+    diagnostics.setOrderIDForThread(i);
+    fn(i);
+    diagnostics.eraseOrderIDForThread();
+  });
+}
+
+/// Emit the specified modules in order, where a circuit stands for its header.
+/// Modules only share the output stream, so they are rendered into separate
+/// buffers in parallel if the context allows it.
+void CircuitEmitter::emitModules(ArrayRef<Operation *> ops) {
+  auto emitOp = [](CircuitEmitter &emitter, Operation *op) {
+    if (isa<CircuitOp>(op))
+      emitter.emitCircuitHeader();
+    else if (!emitter.emitModule(op))
+      op->emitError("unknown operation");
+  };
 
-    op.emitError("unknown operation");
+  if (ops.size() < 2 || !ops.front()->getContext()->isMultithreadingEnabled()) {
+    for (auto *op : ops)
+      emitOp(*this, op);
+    return;
   }
+
+  // The buffers are written to directly, there is no stream buffer in between.
+  std::vector<SmallString<0>> buffers(ops.size());
+  parallelForEachOp(ops, [&](size_t i) {
+    llvm::raw_svector_ostream bufferStream(buffers[i]);
+    VerilogEmitterState bufferState(bufferStream, state.options);
+    CircuitEmitter emitter(bufferState);
+    emitOp(emitter, ops[i]);
+    if (bufferState.encounteredError)
+      state.encounteredError = true;
+  });
+
+  for (auto &buffer : buffers)
+    os << buffer;
 }
 
 void CircuitEmitter::emitMLIRModule(ModuleOp module) {
+  SmallVector<Operation *, 0> ops;
   for (auto &op : *module.getBody()) {
-    if (auto circuit = dyn_cast<CircuitOp>(op))
-      emitCircuit(circuit);
-    else if (auto module = dyn_cast<rtl::RTLModuleOp>(op))
-      ModuleEmitter(state).emitRTLModule(module);
-    else if (auto module = dyn_cast<rtl::RTLExternModuleOp>(op))
-      ModuleEmitter(state).emitRTLExternModule(module);
-    else if (!isa<ModuleTerminatorOp>(op))
+    if (auto circuit = dyn_cast<CircuitOp>(op)) {
+      ops.push_back(circuit);
+      // Ignore the done terminator at the end of the circuit.
+      // Ignore 'ext modules'.
+      for (auto &op : *circuit.getBody())
+        if (!isa<firrtl::DoneOp>(op) && !isa<FExtModuleOp>(op))
+          ops.push_back(&op);
+    } else if (isa<rtl::RTLModuleOp>(op) || isa<rtl::RTLExternModuleOp>(op)) {
+      ops.push_back(&op);
+    } else if (!isa<ModuleTerminatorOp>(op)) {
       op.emitError("unknown operation");
+    }
   }
+  emitModules(ops);
 }
 
-LogicalResult circt::emitVerilog(ModuleOp module, llvm::raw_ostream &os) {
-  VerilogEmitterState state(os);
+LogicalResult circt::emitVerilog(ModuleOp module, llvm::raw_ostream &os,
+                                VerilogEmitterOptions options) {
+  VerilogEmitterState state(os, options);
   CircuitEmitter(state).emitMLIRModule(module);
   return failure(state.encounteredError);
 }
 
+void circt::emitVerilogCircuitHeader(llvm::raw_ostream &os) {
+  VerilogEmitterState state(os);
+  CircuitEmitter(state).emitCircuitHeader();
+}
+
+LogicalResult circt::emitVerilogModule(Operation *module,
+                                       llvm::raw_ostream &os,
+                                       VerilogEmitterOptions options) {
+  VerilogEmitterState state(os, options);
+  if (!CircuitEmitter(state).emitModule(module))
+    return module->emitError("unknown operation");
+  return failure(state.encounteredError);
+}
+
+//===----------------------------------------------------------------------===//
+// Split Verilog Emission
+//===----------------------------------------------------------------------===//
+
+/// The name of the file that holds the circuit header in split mode.
+static constexpr const char *splitHeaderFileName = "circt_header.vh";
+
+/// Write `contents` to the specified file, unless the file holds them already.
+/// This keeps the timestamps of unchanged files stable for make-based flows.
+/// The file is created under a temporary name and then renamed, such that a
+/// tool reading it concurrently, or after an interrupted run, never sees a
+/// partial file.
+static LogicalResult writeFileIfChanged(StringRef path, StringRef contents,
+                                        Location loc) {
+  auto existing = llvm::MemoryBuffer::getFile(
+      path, /*FileSize=*/-1, /*RequiresNullTerminator=*/false);
+  if (existing && (*existing)->getBuffer() == contents)
+    return success();
+
+  int fd;
+  SmallString<128> tempPath;
+  std::error_code error =
+      llvm::sys::fs::createUniqueFile(path + "-%%%%%%.tmp", fd, tempPath);
+  if (!error) {
+    llvm::raw_fd_ostream os(fd, /*shouldClose=*/true);
+    os << contents;
+    os.close();
+    error = os.error();
+    os.clear_error();
+    if (!error)
+      error = llvm::sys::fs::rename(tempPath, path);
+    if (error)
+      llvm::sys::fs::remove(tempPath);
+  }
+  if (error)
+    return emitError(loc, "cannot write '") << path << "': " << error.message();
+  return success();
+}
+
+LogicalResult circt::emitSplitVerilog(ModuleOp module, StringRef dirname,
+                                      VerilogEmitterOptions options) {
+  if (auto error = llvm::sys::fs::create_directories(dirname))
+    return emitError(module.getLoc(), "cannot create directory '")
+           << dirname << "': " << error.message();
+
+  // Collect the modules that have a Verilog definition, each of them is
+  // written to a file named after it.  External modules are only declared.
+  SmallVector<Operation *, 0> ops;
+  llvm::StringSet<> moduleNames;
+  bool needsHeader = false;
+  bool encounteredError = false;
+  auto addModule = [&](Operation *op) {
+    auto name = SymbolTable::getSymbolName(op);
+    if (moduleNames.insert(name).second) {
+      ops.push_back(op);
+      return;
+    }
+    op->emitError("module '") << name << "' is defined more than once";
+    encounteredError = true;
+  };
+
+  for (auto &op : *module.getBody()) {
+    if (auto circuit = dyn_cast<CircuitOp>(op)) {
+      needsHeader = true;
+      for (auto &op : *circuit.getBody()) {
+        if (isa<FModuleOp>(op) || isa<rtl::RTLModuleOp>(op)) {
+          addModule(&op);
+        } else if (!isa<firrtl::DoneOp>(op) && !isa<FExtModuleOp>(op) &&
+                   !isa<rtl::RTLExternModuleOp>(op)) {
+          op.emitError("unknown operation");
+          encounteredError = true;
+        }
+      }
+    } else if (isa<rtl::RTLModuleOp>(op)) {
+      addModule(&op);
+    } else if (!isa<rtl::RTLExternModuleOp>(op) &&
+               !isa<ModuleTerminatorOp>(op)) {
+      op.emitError("unknown operation");
+      encounteredError = true;
+    }
+  }
+  if (encounteredError)
+    return failure();
+
+  // Emit and write the modules concurrently.  The modules of a circuit use
+  // the macros of its header, which they include.
+  std::atomic<bool> failedModule(false);
+  parallelForEachOp(ops, [&](size_t i) {
+    Operation *op = ops[i];
+    std::string verilog;
+    llvm::raw_string_ostream os(verilog);
+    if (isa<CircuitOp>(op->getParentOp()))
+      os << "`include \"" << splitHeaderFileName << "\"\n";
+
+    VerilogEmitterState state(os, options);
+    CircuitEmitter(state).emitModule(op);
+    os.flush();
+    if (state.encounteredError) {
+      failedModule = true;
+      return;
+    }
+
+    SmallString<128> path(dirname);
+    llvm::sys::path::append(path, SymbolTable::getSymbolName(op) + ".v");
+    if (failed(writeFileIfChanged(path, verilog, op->getLoc())))
+      failedModule = true;
+  });
+  if (failedModule)
+    return failure();
+
+  // The header is shared by all circuits, it is guarded against being
+  // included more than once.
+  if (needsHeader) {
+    std::string header;
+    llvm::raw_string_ostream os(header);
+    os << "`ifndef CIRCT_HEADER_VH_\n`define CIRCT_HEADER_VH_\n";
+    emitVerilogCircuitHeader(os);
+    os << "`endif // CIRCT_HEADER_VH_\n";
+
+    SmallString<128> path(dirname);
+    llvm::sys::path::append(path, splitHeaderFileName);
+    if (failed(writeFileIfChanged(path, os.str(), module.getLoc())))
+      return failure();
+  }
+
+  // Remove the files of modules that a previous run listed but that no
+  // longer exist, such that the directory only holds the current design.
+  // Files that were not written by the emitter are left alone.
+  SmallString<128> fileListPath(dirname);
+  llvm::sys::path::append(fileListPath, "filelist.f");
+  if (auto previous = llvm::MemoryBuffer::getFile(fileListPath)) {
+    SmallVector<StringRef, 0> fileNames;
+    (*previous)->getBuffer().split(fileNames, '\n', /*MaxSplit=*/-1,
+                                   /*KeepEmpty=*/false);
+    for (StringRef fileName : fileNames) {
+      if (!fileName.endswith(".v") ||
+          llvm::sys::path::filename(fileName) != fileName ||
+          moduleNames.count(fileName.drop_back(2)))
+        continue;
+      SmallString<128> path(dirname);
+      llvm::sys::path::append(path, fileName);
+      if (auto error = llvm::sys::fs::remove(path))
+        return emitError(module.getLoc(), "cannot remove '")
+               << path << "': " << error.message();
+    }
+  }
+
+  // List the module files in the order of the input.
+  std::string fileList;
+  llvm::raw_string_ostream os(fileList);
+  for (auto *op : ops)
+    os << SymbolTable::getSymbolName(op) << ".v\n";
+  return writeFileIfChanged(fileListPath, os.str(), module.getLoc());
+}
+
 void circt::registerVerilogEmitterTranslation() {
-  static TranslateFromMLIRRegistration toVerilog("emit-verilog", emitVerilog);
+  static TranslateFromMLIRRegistration toVerilog(
+      "emit-verilog",
+      [](ModuleOp module, raw_ostream &os) { return emitVerilog(module, os); });
 }
@@ -9,6 +9,13 @@
 #include "llvm/ADT/StringExtras.h"
 #include "llvm/ADT/StringSwitch.h"
 #include "llvm/Support/SourceMgr.h"
+#include <algorithm>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define FIR_LEXER_X86_KERNELS
+#include <immintrin.h>
+#endif
 
 using namespace circt;
 using namespace firrtl;
@@ -20,6 +27,193 @@ using llvm::SourceMgr;
 #define isdigit(x) DO_NOT_USE_SLOW_CTYPE_FUNCTIONS
 #define isalpha(x) DO_NOT_USE_SLOW_CTYPE_FUNCTIONS
 
+//===----------------------------------------------------------------------===//
+// Scanning Kernels
+//===----------------------------------------------------------------------===//
+
+// The lexer skips over identifiers, whitespace, file info and comments with
+// the kernels below.  Each one returns a pointer to the first character in
+// [ptr, end) that stops the scan, or end if there is none.  The vectorized
+// versions handle 16 or 32 characters at a time and finish the tail with the
+// scalar version.
+
+static inline bool isNotIdentifierChar(char c) {
+  return !llvm::isAlpha(c) && !llvm::isDigit(c) && c != '_' && c != '$' &&
+         c != '-';
+}
+
+static inline bool isNotHorizontalWS(char c) {
+  return c != ' ' && c != '\t' && c != ',';
+}
+
+static inline bool isFileInfoSpecial(char c) {
+  return c == ']' || c == '\\' || c == '\n' || c == '\v' || c == '\f' ||
+         c == 0;
+}
+
+static inline bool isCommentEnd(char c) {
+  return c == '\n' || c == '\r' || c == 0;
+}
+
+template <bool (*IsStop)(char)>
+static const char *scanScalar(const char *ptr, const char *end) {
+  while (ptr < end && !IsStop(*ptr))
+    ++ptr;
+  return ptr;
+}
+
+#ifdef FIR_LEXER_X86_KERNELS
+
+// Each mask function returns a bit for every byte that stops the scan.
+
+__attribute__((target("sse2"))) static inline __m128i
+inRangeSSE2(__m128i v, char lo, char hi) {
+  __m128i offset = _mm_sub_epi8(v, _mm_set1_epi8(lo));
+  return _mm_cmpeq_epi8(_mm_min_epu8(offset, _mm_set1_epi8(hi - lo)), offset);
+}
+
+__attribute__((target("sse2"))) static inline unsigned
+identifierMaskSSE2(__m128i v) {
+  __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+  __m128i ok = _mm_or_si128(inRangeSSE2(lower, 'a', 'z'),
+                            inRangeSSE2(v, '0', '9'));
+  ok = _mm_or_si128(ok, _mm_cmpeq_epi8(v, _mm_set1_epi8('_')));
+  ok = _mm_or_si128(ok, _mm_cmpeq_epi8(v, _mm_set1_epi8('$')));
+  ok = _mm_or_si128(ok, _mm_cmpeq_epi8(v, _mm_set1_epi8('-')));
+  return ~_mm_movemask_epi8(ok) & 0xffffU;
+}
+
+__attribute__((target("sse2"))) static inline unsigned
+horizontalWSMaskSSE2(__m128i v) {
+  __m128i ws = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),
+                            _mm_cmpeq_epi8(v, _mm_set1_epi8('\t')));
+  ws = _mm_or_si128(ws, _mm_cmpeq_epi8(v, _mm_set1_epi8(',')));
+  return ~_mm_movemask_epi8(ws) & 0xffffU;
+}
+
+__attribute__((target("sse2"))) static inline unsigned
+fileInfoMaskSSE2(__m128i v) {
+  __m128i stop = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(']')),
+                              _mm_cmpeq_epi8(v, _mm_set1_epi8('\\')));
+  // '\n', '\v' and '\f' are 10, 11 and 12.
+  stop = _mm_or_si128(stop, inRangeSSE2(v, '\n', '\f'));
+  stop = _mm_or_si128(stop, _mm_cmpeq_epi8(v, _mm_setzero_si128()));
+  return _mm_movemask_epi8(stop);
+}
+
+__attribute__((target("sse2"))) static inline unsigned
+commentMaskSSE2(__m128i v) {
+  __m128i stop = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')),
+                              _mm_cmpeq_epi8(v, _mm_set1_epi8('\r')));
+  stop = _mm_or_si128(stop, _mm_cmpeq_epi8(v, _mm_setzero_si128()));
+  return _mm_movemask_epi8(stop);
+}
+
+__attribute__((target("avx2"))) static inline __m256i
+inRangeAVX2(__m256i v, char lo, char hi) {
+  __m256i offset = _mm256_sub_epi8(v, _mm256_set1_epi8(lo));
+  return _mm256_cmpeq_epi8(_mm256_min_epu8(offset, _mm256_set1_epi8(hi - lo)),
+                           offset);
+}
+
+__attribute__((target("avx2"))) static inline unsigned
+identifierMaskAVX2(__m256i v) {
+  __m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+  __m256i ok = _mm256_or_si256(inRangeAVX2(lower, 'a', 'z'),
+                               inRangeAVX2(v, '0', '9'));
+  ok = _mm256_or_si256(ok, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_')));
+  ok = _mm256_or_si256(ok, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('$')));
+  ok = _mm256_or_si256(ok, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('-')));
+  return ~static_cast<unsigned>(_mm256_movemask_epi8(ok));
+}
+
+__attribute__((target("avx2"))) static inline unsigned
+horizontalWSMaskAVX2(__m256i v) {
+  __m256i ws = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')),
+                               _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t')));
+  ws = _mm256_or_si256(ws, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(',')));
+  return ~static_cast<unsigned>(_mm256_movemask_epi8(ws));
+}
+
+__attribute__((target("avx2"))) static inline unsigned
+fileInfoMaskAVX2(__m256i v) {
+  __m256i stop =
+      _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(']')),
+                      _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\')));
+  stop = _mm256_or_si256(stop, inRangeAVX2(v, '\n', '\f'));
+  stop = _mm256_or_si256(stop, _mm256_cmpeq_epi8(v, _mm256_setzero_si256()));
+  return _mm256_movemask_epi8(stop);
+}
+
+__attribute__((target("avx2"))) static inline unsigned
+commentMaskAVX2(__m256i v) {
+  __m256i stop = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')),
+                                 _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r')));
+  stop = _mm256_or_si256(stop, _mm256_cmpeq_epi8(v, _mm256_setzero_si256()));
+  return _mm256_movemask_epi8(stop);
+}
+
+template <bool (*IsStop)(char), unsigned (*StopMask)(__m128i)>
+__attribute__((target("sse2"))) static const char *scanSSE2(const char *ptr,
+                                                             const char *end) {
+  for (; end - ptr >= 16; ptr += 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(ptr));
+    if (unsigned stop = StopMask(v))
+      return ptr + __builtin_ctz(stop);
+  }
+  return scanScalar<IsStop>(ptr, end);
+}
+
+template <bool (*IsStop)(char), unsigned (*StopMask128)(__m128i),
+          unsigned (*StopMask256)(__m256i)>
+__attribute__((target("avx2"))) static const char *scanAVX2(const char *ptr,
+                                                             const char *end) {
+  for (; end - ptr >= 32; ptr += 32) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(ptr));
+    if (unsigned stop = StopMask256(v))
+      return ptr + __builtin_ctz(stop);
+  }
+  return scanSSE2<IsStop, StopMask128>(ptr, end);
+}
+
+#endif // FIR_LEXER_X86_KERNELS
+
+namespace {
+/// The set of scanning kernels selected for the host the lexer is running on.
+struct ScanKernels {
+  using ScanFn = const char *(*)(const char *, const char *);
+  ScanFn identifierEnd;
+  ScanFn horizontalWSEnd;
+  ScanFn fileInfoSpecial;
+  ScanFn commentEnd;
+};
+} // namespace
+
+static ScanKernels selectScanKernels() {
+#ifdef FIR_LEXER_X86_KERNELS
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    return {
+        scanAVX2<isNotIdentifierChar, identifierMaskSSE2, identifierMaskAVX2>,
+        scanAVX2<isNotHorizontalWS, horizontalWSMaskSSE2,
+                 horizontalWSMaskAVX2>,
+        scanAVX2<isFileInfoSpecial, fileInfoMaskSSE2, fileInfoMaskAVX2>,
+        scanAVX2<isCommentEnd, commentMaskSSE2, commentMaskAVX2>};
+  if (__builtin_cpu_supports("sse2"))
+    return {scanSSE2<isNotIdentifierChar, identifierMaskSSE2>,
+            scanSSE2<isNotHorizontalWS, horizontalWSMaskSSE2>,
+            scanSSE2<isFileInfoSpecial, fileInfoMaskSSE2>,
+            scanSSE2<isCommentEnd, commentMaskSSE2>};
+#endif
+  return {scanScalar<isNotIdentifierChar>, scanScalar<isNotHorizontalWS>,
+          scanScalar<isFileInfoSpecial>, scanScalar<isCommentEnd>};
+}
+
+static const ScanKernels &getScanKernels() {
+  static const ScanKernels kernels = selectScanKernels();
+  return kernels;
+}
+
 //===----------------------------------------------------------------------===//
 // FIRToken
 //===----------------------------------------------------------------------===//
@@ -100,60 +294,119 @@ std::string FIRToken::getStringValue(StringRef spelling) {
 //===----------------------------------------------------------------------===//
 
 FIRLexer::FIRLexer(const llvm::SourceMgr &sourceMgr, MLIRContext *context)
-    : sourceMgr(sourceMgr), context(context) {
-  auto bufferID = sourceMgr.getMainFileID();
-  curBuffer = sourceMgr.getMemoryBuffer(bufferID)->getBuffer();
-  curPtr = curBuffer.begin();
+    : FIRLexer(sourceMgr, context,
+               sourceMgr.getMemoryBuffer(sourceMgr.getMainFileID())
+                   ->getBuffer()) {}
+
+FIRLexer::FIRLexer(const llvm::SourceMgr &sourceMgr, MLIRContext *context,
+                   StringRef buffer)
+    : sourceMgr(sourceMgr), context(context), curBuffer(buffer),
+      curPtr(buffer.begin()), lineStart(buffer.begin()),
+      bufferName(Identifier::get(
+          sourceMgr.getMemoryBuffer(sourceMgr.getMainFileID())
+              ->getBufferIdentifier(),
+          context)),
+      bufferLoc(FileLineColLoc::get(bufferName, /*line=*/0, /*column=*/0,
+                                    context)),
+      curLineBegin(buffer.begin()) {
+  // A lexer for a part of the main buffer starts on a later line.
+  auto *mainBuffer = sourceMgr.getMemoryBuffer(sourceMgr.getMainFileID());
+  firstLineNo = buffer.begin() == mainBuffer->getBufferStart()
+                    ? 1
+                    : sourceMgr.getLineAndColumn(
+                          SMLoc::getFromPointer(buffer.begin())).first;
+  curLineNo = firstLineNo;
 }
 
 /// Encode the specified source location information into a Location object
 /// for attachment to the IR or error reporting.
 Location FIRLexer::translateLocation(llvm::SMLoc loc) {
-  unsigned mainFileID = sourceMgr.getMainFileID();
-  auto lineAndColumn = sourceMgr.getLineAndColumn(loc, mainFileID);
-  auto *buffer = sourceMgr.getMemoryBuffer(mainFileID);
-
-  return FileLineColLoc::get(buffer->getBufferIdentifier(), lineAndColumn.first,
+  // The lexer only knows about the lines it already lexed.  The source manager
+  // handles everything else.
+  const char *ptr = loc.getPointer();
+  std::pair<unsigned, unsigned> lineAndColumn;
+  if (ptr >= curBuffer.begin() && ptr <= curPtr)
+    lineAndColumn = getLineAndColumn(ptr);
+  else
+    lineAndColumn = sourceMgr.getLineAndColumn(loc, sourceMgr.getMainFileID());
+
+  return FileLineColLoc::get(bufferName, lineAndColumn.first,
                              lineAndColumn.second, context);
 }
 
+/// Return the line and column of a pointer into the part of the buffer that
+/// was already lexed, counting the same way as the source manager: lines are
+/// ended by '\n', columns start after the last '\n' or '\r'.  A '\r' may also
+/// appear in strings and file info, so the column is always found by scanning
+/// back from the pointer.
+std::pair<unsigned, unsigned>
+FIRLexer::getLineAndColumn(const char *ptr) const {
+  // Tokens on the current line are the common case.
+  unsigned lineNo = curLineNo;
+  if (ptr < curLineBegin) {
+    auto it = std::upper_bound(lineIndex.begin(), lineIndex.end(), ptr);
+    lineNo = firstLineNo + (it - lineIndex.begin()) * lineIndexStride;
+    const char *lineBegin =
+        it == lineIndex.begin() ? curBuffer.begin() : it[-1];
+    while (const char *newline = static_cast<const char *>(
+               memchr(lineBegin, '\n', ptr - lineBegin))) {
+      ++lineNo;
+      lineBegin = newline + 1;
+    }
+  }
+
+  const char *columnBegin = ptr;
+  while (columnBegin != curBuffer.begin() && columnBegin[-1] != '\n' &&
+         columnBegin[-1] != '\r')
+    --columnBegin;
+  return {lineNo, ptr - columnBegin + 1};
+}
+
+/// Note that a '\n' or '\r' was just lexed, `curPtr` is the start of the next
+/// line.  Only '\n' counts towards the line number.
+void FIRLexer::startNewLine() {
+  lineStart = curPtr;
+  onlyIndentOnLine = true;
+  if (curPtr[-1] != '\n')
+    return;
+
+  ++curLineNo;
+  curLineBegin = curPtr;
+  if (--linesUntilIndex == 0) {
+    lineIndex.push_back(curPtr);
+    linesUntilIndex = lineIndexStride;
+  }
+}
+
 /// Emit an error message and return a FIRToken::error token.
 FIRToken FIRLexer::emitError(const char *loc, const Twine &message) {
   mlir::emitError(translateLocation(SMLoc::getFromPointer(loc)), message);
   return formToken(FIRToken::error, loc);
 }
 
-/// Return the indentation level of the specified token.
-Optional<unsigned> FIRLexer::getIndentation(const FIRToken &tok) const {
-  // Count the number of horizontal whitespace characters before the token.
-  auto *bufStart = curBuffer.begin();
-
-  auto isHorizontalWS = [](char c) -> bool {
-    return c == ' ' || c == '\t' || c == ',';
-  };
-  auto isVerticalWS = [](char c) -> bool {
-    return c == '\n' || c == '\r' || c == '\f' || c == '\v';
-  };
-
-  unsigned indent = 0;
-  const auto *ptr = (const char *)tok.getSpelling().data();
-  while (ptr != bufStart && isHorizontalWS(ptr[-1]))
-    --ptr, ++indent;
-
-  // If the character we stopped at isn't the start of line, then return none.
-  if (ptr != bufStart && !isVerticalWS(ptr[-1]))
-    return None;
-
-  return indent;
-}
-
 //===----------------------------------------------------------------------===//
 // Lexer Implementation Methods
 //===----------------------------------------------------------------------===//
 
 FIRToken FIRLexer::lexToken() {
+  FIRToken token = lexTokenImpl();
+
+  // Record the indentation if this is the first token on its line.
+  if (onlyIndentOnLine)
+    token.indentation = token.getSpelling().data() - lineStart;
+  onlyIndentOnLine = false;
+  return token;
+}
+
+FIRToken FIRLexer::lexTokenImpl() {
   while (true) {
     const char *tokStart = curPtr;
+
+    // Stop at the end of the buffer.  The end of a partial buffer is not
+    // marked by a nul character.
+    if (curPtr == curBuffer.end())
+      return formToken(FIRToken::eof, tokStart);
+
     switch (*curPtr++) {
     default:
       // Handle identifiers.
@@ -169,14 +422,23 @@ FIRToken FIRLexer::lexToken() {
       if (curPtr - 1 == curBuffer.end())
         return formToken(FIRToken::eof, tokStart);
 
-      LLVM_FALLTHROUGH; // Treat as whitespace.
+      // Treat as whitespace, but not as indentation.
+      onlyIndentOnLine = false;
+      continue;
 
     case ' ':
     case '\t':
+    case ',':
+      // Handle whitespace.  Single separators are common, only runs such as
+      // indentation are worth handing to the kernel.
+      if (!isNotHorizontalWS(*curPtr))
+        curPtr = getScanKernels().horizontalWSEnd(curPtr, curBuffer.end());
+      continue;
+
     case '\n':
     case '\r':
-    case ',':
-      // Handle whitespace.
+      // Handle vertical whitespace, the next line starts after it.
+      startNewLine();
       continue;
 
     case '_':
@@ -220,6 +482,8 @@ FIRToken FIRLexer::lexToken() {
       return emitError(tokStart, "unexpected character");
 
     case ';':
+      // A comment is not indentation, even if nothing follows it.
+      onlyIndentOnLine = false;
       skipComment();
       continue;
 
@@ -253,7 +517,10 @@ FIRToken FIRLexer::lexToken() {
 ///   FileInfo ::= '@[' ('\]'|.)* ']'
 ///
 FIRToken FIRLexer::lexFileInfo(const char *tokStart) {
+  auto fileInfoSpecial = getScanKernels().fileInfoSpecial;
   while (1) {
+    // Skip ahead to the next character that needs to be looked at.
+    curPtr = fileInfoSpecial(curPtr, curBuffer.end());
     switch (*curPtr++) {
     case ']': // This is the end of the fileinfo literal.
       return formToken(FIRToken::fileinfo, tokStart);
@@ -287,7 +554,14 @@ FIRToken FIRLexer::lexFileInfo(const char *tokStart) {
 ///   Id ::= LegalStartChar (LegalIdChar)*
 ///
 FIRToken FIRLexer::lexIdentifierOrKeyword(const char *tokStart) {
-  // Match the rest of the identifier regex: [0-9a-zA-Z_$-]*
+  // Match the rest of the identifier regex: [0-9a-zA-Z_$-]*.  Most identifiers
+  // are short, so only long ones are handed to the kernel.  The kernel stops at
+  // the end of the buffer, the loop below picks up from there.
+  const char *shortEnd = tokStart + 8;
+  while (curPtr != shortEnd && !isNotIdentifierChar(*curPtr))
+    ++curPtr;
+  if (curPtr == shortEnd)
+    curPtr = getScanKernels().identifierEnd(curPtr, curBuffer.end());
   while (llvm::isAlpha(*curPtr) || llvm::isDigit(*curPtr) || *curPtr == '_' ||
          *curPtr == '$' || *curPtr == '-')
     ++curPtr;
@@ -318,11 +592,15 @@ FIRToken FIRLexer::lexIdentifierOrKeyword(const char *tokStart) {
 
 /// Skip a comment line, starting with a ';' and going to end of line.
 void FIRLexer::skipComment() {
+  auto commentEnd = getScanKernels().commentEnd;
   while (true) {
+    // Skip ahead to the next character that can end the comment.
+    curPtr = commentEnd(curPtr, curBuffer.end());
     switch (*curPtr++) {
     case '\n':
     case '\r':
       // Newline is end of comment.
+      startNewLine();
       return;
     case 0:
       // If this is the end of the buffer, end the comment.
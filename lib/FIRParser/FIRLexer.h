@@ -8,11 +8,12 @@
 #define FIRTOMLIR_FIRLEXER_H
 
 #include "circt/Support/LLVM.h"
+#include "mlir/IR/Location.h"
 #include "llvm/Support/SourceMgr.h"
+#include <vector>
 
 namespace mlir {
 class MLIRContext;
-class Location;
 } // namespace mlir
 
 namespace circt {
@@ -72,13 +73,28 @@ public:
   llvm::SMLoc getEndLoc() const;
   llvm::SMRange getLocRange() const;
 
+  /// Return the indentation level of this token or None if this token is
+  /// preceded by another token on the same line.
+  Optional<unsigned> getIndentation() const {
+    if (indentation == notFirstOnLine)
+      return None;
+    return indentation;
+  }
+
 private:
+  friend class FIRLexer;
+
   /// Discriminator that indicates the sort of token this is.
   Kind kind;
 
   /// A reference to the entire token contents; this is always a pointer into
   /// a memory buffer owned by the source manager.
   StringRef spelling;
+
+  /// The number of horizontal whitespace characters before this token on its
+  /// line, filled in by the lexer as it crosses newlines.
+  static constexpr unsigned notFirstOnLine = ~0U;
+  unsigned indentation = notFirstOnLine;
 };
 
 /// This implements a lexer for .fir files.
@@ -86,15 +102,21 @@ class FIRLexer {
 public:
   FIRLexer(const llvm::SourceMgr &sourceMgr, mlir::MLIRContext *context);
 
+  /// Create a lexer for a part of the main buffer, e.g. a single module.  The
+  /// lexer produces an eof token at the end of `buffer`, which has to start
+  /// and end at the beginning of a line.
+  FIRLexer(const llvm::SourceMgr &sourceMgr, mlir::MLIRContext *context,
+           StringRef buffer);
+
   const llvm::SourceMgr &getSourceMgr() const { return sourceMgr; }
 
   FIRToken lexToken();
 
   mlir::Location translateLocation(llvm::SMLoc loc);
 
-  /// Return the indentation level of the specified token or None if this token
-  /// is preceded by another token on the same line.
-  Optional<unsigned> getIndentation(const FIRToken &tok) const;
+  /// Return the location of the main buffer as a whole, without a line and
+  /// column.
+  mlir::Location getBufferLocation() const { return bufferLoc; }
 
 private:
   // Helpers.
@@ -104,7 +126,11 @@ private:
 
   FIRToken emitError(const char *loc, const Twine &message);
 
+  void startNewLine();
+  std::pair<unsigned, unsigned> getLineAndColumn(const char *ptr) const;
+
   // Lexer implementation methods.
+  FIRToken lexTokenImpl();
   FIRToken lexFileInfo(const char *tokStart);
   FIRToken lexIdentifierOrKeyword(const char *tokStart);
   FIRToken lexNumber(const char *tokStart);
@@ -118,6 +144,28 @@ private:
   StringRef curBuffer;
   const char *curPtr;
 
+  /// The start of the current line, and whether only horizontal whitespace was
+  /// lexed since then.  This is used to record the indentation of tokens.
+  const char *lineStart;
+  bool onlyIndentOnLine = true;
+
+  /// The name of the main buffer, interned once for all locations.
+  mlir::Identifier bufferName;
+  mlir::Location bufferLoc;
+
+  /// Line numbers are counted as the lexer crosses newlines, such that the
+  /// location of a token can be translated without searching the buffer.
+  /// `curLineBegin` is the start of line `curLineNo`, the line of `curPtr`.
+  unsigned firstLineNo, curLineNo;
+  const char *curLineBegin;
+
+  /// The start of every `lineIndexStride`th line after `firstLineNo`.  The
+  /// line of an earlier location is found by counting the newlines from the
+  /// closest line start in the index.
+  static constexpr unsigned lineIndexStride = 64;
+  std::vector<const char *> lineIndex;
+  unsigned linesUntilIndex = lineIndexStride;
+
   FIRLexer(const FIRLexer &) = delete;
   void operator=(const FIRLexer &) = delete;
 };
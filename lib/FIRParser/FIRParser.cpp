@@ -13,8 +13,13 @@
 #include "mlir/IR/Verifier.h"
 #include "mlir/Translation.h"
 #include "llvm/ADT/ScopedHashTable.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/Parallel.h"
 #include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/Threading.h"
 #include "llvm/Support/raw_ostream.h"
+#include <mutex>
 
 using namespace circt;
 using namespace firrtl;
@@ -22,6 +27,8 @@ using namespace mlir;
 using llvm::SMLoc;
 using llvm::SourceMgr;
 
+#define DEBUG_TYPE "fir-parser"
+
 /// Return true if this is a useless temporary name produced by FIRRTL.  We
 /// drop these as they don't convey semantic meaning.
 static bool isUselessName(StringRef name) {
@@ -61,6 +68,12 @@ struct GlobalFIRParserState {
       : context(context), options(options), lex(sourceMgr, context),
         curToken(lex.lexToken()) {}
 
+  /// Create the state for parsing a part of the main buffer, e.g. a module.
+  GlobalFIRParserState(const llvm::SourceMgr &sourceMgr, MLIRContext *context,
+                       FIRParserOptions options, StringRef buffer)
+      : context(context), options(options), lex(sourceMgr, context, buffer),
+        curToken(lex.lexToken()) {}
+
   /// The context we're parsing into.
   MLIRContext *const context;
 
@@ -73,6 +86,24 @@ struct GlobalFIRParserState {
   /// This is the next token that hasn't been consumed yet.
   FIRToken curToken;
 
+  /// When the modules of a circuit are parsed in parallel, they are only added
+  /// to the circuit once all of them are parsed.  Instances look up the
+  /// referenced module in this table instead, which maps each module name to
+  /// the index of the chunk it is defined in and to its operation.
+  const llvm::StringMap<std::pair<size_t, Operation *>> *moduleTable = nullptr;
+
+  /// The index of the chunk parsed with this state, see `moduleTable`.
+  size_t chunkIndex = 0;
+
+  /// Chisel repeats the same few info records over and over, so the location
+  /// of each distinct `@[...]` spelling is only computed once.  A null entry
+  /// marks a record in an unknown format.  The keys point into the source
+  /// buffer, which outlives the parser.
+  DenseMap<StringRef, LocationAttr> infoLocCache;
+
+  /// The filenames used by info records, interned into the context once.
+  DenseMap<StringRef, Identifier> infoFilenames;
+
 private:
   GlobalFIRParserState(const GlobalFIRParserState &) = delete;
   void operator=(const GlobalFIRParserState &) = delete;
@@ -97,7 +128,7 @@ struct FIRParser {
 
   /// Return the indentation level of the specified token.
   Optional<unsigned> getIndentation() const {
-    return state.lex.getIndentation(state.curToken);
+    return state.curToken.getIndentation();
   }
 
   /// Return the current token the parser is inspecting.
@@ -121,11 +152,24 @@ struct FIRParser {
   class LocWithInfo;
 
   /// Encode the specified source location information into an attribute for
-  /// attachment to the IR.
+  /// attachment to the IR.  If the .fir locations are dropped, this is the
+  /// location of the file as a whole.
   Location translateLocation(llvm::SMLoc loc) {
+    if (state.options.dropFIRLocations)
+      return state.lex.getBufferLocation();
     return state.lex.translateLocation(loc);
   }
 
+  /// Encode the specified source location information into an attribute for
+  /// error reporting.
+  Location translateDiagnosticLocation(llvm::SMLoc loc) {
+    return state.lex.translateLocation(loc);
+  }
+
+  /// Return the location of the info record with the specified spelling, or a
+  /// null location if the record is in an unknown format.
+  LocationAttr getInfoLocation(StringRef spelling);
+
   /// Parse an @info marker if present.  If so, apply the symbolic location
   /// specified it to all of the operations listed in subOps.
   ParseResult parseOptionalInfo(LocWithInfo &result,
@@ -214,7 +258,7 @@ private:
 //===----------------------------------------------------------------------===//
 
 InFlightDiagnostic FIRParser::emitError(SMLoc loc, const Twine &message) {
-  auto diag = mlir::emitError(translateLocation(loc), message);
+  auto diag = mlir::emitError(translateDiagnosticLocation(loc), message);
 
   // If we hit a parse error in response to a lexer error, then the lexer
   // already reported the error.
@@ -294,6 +338,96 @@ private:
   Optional<Location> infoLoc;
 };
 
+namespace {
+/// A single file/line/column locator of an info record.
+struct InfoLocator {
+  StringRef filename;
+  unsigned line, column;
+};
+} // end anonymous namespace
+
+/// Decode a "221:8" or "221" line/column piece of an info record.  Zero
+/// represents an unknown line/column number.
+static bool parseInfoLineAndColumn(StringRef piece, unsigned &line,
+                                   unsigned &column) {
+  StringRef lineStr, colStr;
+  std::tie(lineStr, colStr) = piece.split(':');
+  column = 0;
+  return !lineStr.getAsInteger(10, line) &&
+         (colStr.empty() || !colStr.getAsInteger(10, column));
+}
+
+/// Split the spelling of an info token into its locators.  The spelling looks
+/// something like "@[Decoupled.scala 221:8]".  Chisel merges several locators
+/// into one record, as in "@[Foo.scala 12:3 Bar.scala 7:1 9:2]", where a
+/// line/column without a filename refers to the previous filename.  Filenames
+/// may contain spaces, so everything up to the next line/column piece is part
+/// of the filename, and the first piece always is.  A line without a column is
+/// only recognized at the end.  Return true if the record is in an unknown
+/// format.
+static bool parseInfoLocators(StringRef spelling,
+                              SmallVectorImpl<InfoLocator> &locators) {
+  if (!spelling.startswith("@[") || !spelling.endswith("]"))
+    return true;
+  spelling = spelling.drop_front(2).drop_back(1);
+
+  // The start of the filename that the next line/column piece belongs to, if
+  // one was seen since the last line/column piece.
+  const char *filenameStart = nullptr;
+  StringRef filename;
+  for (size_t pos = 0; pos <= spelling.size();) {
+    size_t next = std::min(spelling.find(' ', pos), spelling.size());
+    StringRef piece = spelling.slice(pos, next);
+    unsigned line, column;
+    bool isLast = next == spelling.size();
+    if (pos != 0 && (isLast || piece.find(':') != StringRef::npos) &&
+        parseInfoLineAndColumn(piece, line, column)) {
+      if (filenameStart)
+        filename = StringRef(filenameStart, piece.data() - 1 - filenameStart);
+      filenameStart = nullptr;
+      locators.push_back({filename, line, column});
+    } else if (!filenameStart) {
+      filenameStart = piece.data();
+    }
+    pos = next + 1;
+  }
+
+  // The record has to end in a line/column.
+  return filenameStart != nullptr;
+}
+
+LocationAttr FIRParser::getInfoLocation(StringRef spelling) {
+  auto it = state.infoLocCache.find(spelling);
+  if (it != state.infoLocCache.end())
+    return it->second;
+
+  LocationAttr &result = state.infoLocCache[spelling];
+  SmallVector<InfoLocator, 2> locators;
+  if (parseInfoLocators(spelling, locators))
+    return result;
+
+  // If info locators are ignored, the record is still verified above, but no
+  // location is built for it.
+  if (state.options.ignoreInfoLocators)
+    return result = UnknownLoc::get(getContext());
+
+  SmallVector<Location, 2> locs;
+  for (auto &locator : locators) {
+    auto filenameIt = state.infoFilenames.find(locator.filename);
+    if (filenameIt == state.infoFilenames.end()) {
+      auto filename = Identifier::get(locator.filename, getContext());
+      filenameIt =
+          state.infoFilenames.insert({locator.filename, filename}).first;
+    }
+    locs.push_back(FileLineColLoc::get(filenameIt->second, locator.line,
+                                       locator.column, getContext()));
+  }
+
+  if (locs.size() == 1)
+    return result = locs.front();
+  return result = FusedLoc::get(locs, getContext());
+}
+
 /// Parse an @info marker if present.  If so, apply the symbolic location
 /// specified it to all of the operations listed in subOps.
 ///
@@ -305,53 +439,21 @@ ParseResult FIRParser::parseOptionalInfo(LocWithInfo &result,
     return success();
 
   auto loc = getToken().getLoc();
+  auto resultLoc = getInfoLocation(getTokenSpelling());
+  consumeToken(FIRToken::fileinfo);
 
-  // See if we can parse this token into a File/Line/Column record.  If not,
-  // just ignore it with a warning.
-  auto unknownFormat = [&]() -> ParseResult {
-    mlir::emitWarning(translateLocation(loc),
+  // If we can't parse this token into File/Line/Column records, just ignore it
+  // with a warning.
+  if (!resultLoc) {
+    mlir::emitWarning(translateDiagnosticLocation(loc),
                       "ignoring unknown @ info record format");
     return success();
-  };
-
-  auto spelling = getTokenSpelling();
-  consumeToken(FIRToken::fileinfo);
-
-  // The spelling of the token looks something like "@[Decoupled.scala 221:8]".
-  if (!spelling.startswith("@[") || !spelling.endswith("]"))
-    return unknownFormat();
-
-  spelling = spelling.drop_front(2).drop_back(1);
-
-  // Split at the last space.
-  auto spaceLoc = spelling.find_last_of(' ');
-  if (spaceLoc == StringRef::npos)
-    return unknownFormat();
-
-  auto filename = spelling.take_front(spaceLoc);
-  auto lineAndColumn = spelling.drop_front(spaceLoc + 1);
-
-  // Decode the line/column.  If the colon is missing, then it will be empty
-  // here.
-  StringRef lineStr, colStr;
-  std::tie(lineStr, colStr) = lineAndColumn.split(':');
-
-  // Zero represents an unknown line/column number.
-  unsigned lineNo = 0, columnNo = 0;
-
-  // Decode the line number and the column number if present.
-  if (lineStr.getAsInteger(10, lineNo))
-    return unknownFormat();
-  if (!colStr.empty() && colStr.getAsInteger(10, columnNo))
-    return unknownFormat();
+  }
 
-  // If info locators are ignored, don't actually apply them.  We still do all
-  // the verification above though.
+  // If info locators are ignored, don't actually apply them.
   if (state.options.ignoreInfoLocators)
     return success();
 
-  auto resultLoc =
-      FileLineColLoc::get(filename, lineNo, columnNo, getContext());
   result.setInfoLocation(resultLoc);
 
   // Now that we have a symbolic location, apply it to any subOps specified.
@@ -687,7 +789,7 @@ ParseResult FIRScopedParser::addSymbolEntry(StringRef name, Value value,
   auto prev = symbolTable.lookup(nameId);
   if (prev.first.isValid()) {
     emitError(loc, "redefinition of name '" + name.str() + "'")
-            .attachNote(translateLocation(prev.first))
+            .attachNote(translateDiagnosticLocation(prev.first))
         << "previous definition here";
     return failure();
   }
@@ -777,6 +879,8 @@ private:
   ParseResult parseWhen(unsigned whenIndent);
   ParseResult parseLeadingExpStmt(Value lhs, SubOpVector &subOps);
 
+  Operation *lookupModule(StringRef name);
+
   // Declarations
   ParseResult parseInstance();
   ParseResult parseCMem();
@@ -1695,6 +1799,24 @@ ParseResult FIRStmtParser::parseLeadingExpStmt(Value lhs, SubOpVector &subOps) {
 //===-------------------------------
 // FIRStmtParser Declaration Parsing
 
+/// Return the module with the specified name if it has been parsed already, or
+/// null otherwise.
+Operation *FIRStmtParser::lookupModule(StringRef name) {
+  auto *moduleTable = getState().moduleTable;
+  if (!moduleTable) {
+    auto circuit =
+        builder.getBlock()->getParentOp()->getParentOfType<CircuitOp>();
+    return circuit.lookupSymbol(name);
+  }
+
+  // Modules defined in a later chunk would not have been parsed yet by a
+  // serial parse.
+  auto it = moduleTable->find(name);
+  if (it == moduleTable->end() || it->second.first > getState().chunkIndex)
+    return nullptr;
+  return it->second.second;
+}
+
 /// instance ::= 'inst' id 'of' id info?
 ParseResult FIRStmtParser::parseInstance() {
   LocWithInfo info(getToken().getLoc(), this);
@@ -1713,9 +1835,7 @@ ParseResult FIRStmtParser::parseInstance() {
     return failure();
 
   // Look up the module that is being referenced.
-  auto circuit =
-      builder.getBlock()->getParentOp()->getParentOfType<CircuitOp>();
-  auto referencedModule = circuit.lookupSymbol(moduleName);
+  auto referencedModule = lookupModule(moduleName);
   if (!referencedModule) {
     emitError(info.getFIRLoc(),
               "use of undefined module name '" + moduleName + "' in instance");
@@ -2084,19 +2204,28 @@ ParseResult FIRStmtParser::parseRegister(unsigned regIndent) {
 namespace {
 /// This class implements logic and state for parsing module bodies.
 struct FIRModuleParser : public FIRScopedParser {
-  explicit FIRModuleParser(GlobalFIRParserState &state, CircuitOp circuit)
-      : FIRScopedParser(state, symbolTable, memoryScopeTable), circuit(circuit),
-        firstScope(symbolTable), firstMemoryScope(memoryScopeTable) {}
+  explicit FIRModuleParser(GlobalFIRParserState &state,
+                           OpBuilder moduleBuilder)
+      : FIRScopedParser(state, symbolTable, memoryScopeTable),
+        moduleBuilder(moduleBuilder), firstScope(symbolTable),
+        firstMemoryScope(memoryScopeTable) {}
 
   ParseResult parseExtModule(unsigned indent);
   ParseResult parseModule(unsigned indent);
 
+  /// Parse the module up to the end of its port list, and then its body.
+  ParseResult parseModuleHeader(unsigned indent, FModuleOp &fmodule);
+  ParseResult parseModuleBody(FModuleOp fmodule, unsigned indent);
+
 private:
   using PortInfoAndLoc = std::pair<ModulePortInfo, SMLoc>;
   ParseResult parsePortList(SmallVectorImpl<PortInfoAndLoc> &result,
                             unsigned indent);
 
-  CircuitOp circuit;
+  /// The builder to create the module with.  This inserts into the circuit
+  /// body, or into a separate block when modules are parsed in parallel.
+  OpBuilder moduleBuilder;
+
   SymbolTable symbolTable;
   SymbolTable::ScopeTy firstScope;
 
@@ -2160,7 +2289,7 @@ ParseResult FIRModuleParser::parseExtModule(unsigned indent) {
       parseOptionalInfo(info) || parsePortList(portListAndLoc, indent))
     return failure();
 
-  auto builder = circuit.getBodyBuilder();
+  auto builder = moduleBuilder;
 
   // Create the module.
   SmallVector<ModulePortInfo, 4> portList;
@@ -2247,6 +2376,13 @@ ParseResult FIRModuleParser::parseExtModule(unsigned indent) {
 /// DEDENT
 ///
 ParseResult FIRModuleParser::parseModule(unsigned indent) {
+  FModuleOp fmodule;
+  return failure(parseModuleHeader(indent, fmodule) ||
+                 parseModuleBody(fmodule, indent));
+}
+
+ParseResult FIRModuleParser::parseModuleHeader(unsigned indent,
+                                               FModuleOp &fmodule) {
   LocWithInfo info(getToken().getLoc(), this);
   StringAttr name;
   SmallVector<PortInfoAndLoc, 4> portListAndLoc;
@@ -2257,14 +2393,14 @@ ParseResult FIRModuleParser::parseModule(unsigned indent) {
       parseOptionalInfo(info) || parsePortList(portListAndLoc, indent))
     return failure();
 
-  auto builder = circuit.getBodyBuilder();
+  auto builder = moduleBuilder;
 
   // Create the module.
   SmallVector<ModulePortInfo, 4> portList;
   portList.reserve(portListAndLoc.size());
   for (auto &elt : portListAndLoc)
     portList.push_back(elt.first);
-  auto fmodule = builder.create<FModuleOp>(info.getLoc(), name, portList);
+  fmodule = builder.create<FModuleOp>(info.getLoc(), name, portList);
 
   // Install all of the ports into the symbol table, associated with their
   // block arguments.
@@ -2274,7 +2410,11 @@ ParseResult FIRModuleParser::parseModule(unsigned indent) {
       return failure();
     ++argIt;
   }
+  return success();
+}
 
+ParseResult FIRModuleParser::parseModuleBody(FModuleOp fmodule,
+                                             unsigned indent) {
   FIRModuleContext moduleContext;
   FIRStmtParser stmtParser(fmodule.getBodyBuilder(), *this, moduleContext);
 
@@ -2296,11 +2436,112 @@ struct FIRCircuitParser : public FIRParser {
   ParseResult parseCircuit();
 
 private:
+  ParseResult parseModules(OpBuilder moduleBuilder, unsigned circuitIndent);
+  ParseResult parseModuleIndent(unsigned circuitIndent, unsigned &moduleIndent);
+  Optional<ParseResult> parseModulesInParallel(CircuitOp circuit,
+                                               unsigned circuitIndent);
+
   ModuleOp mlirModule;
 };
 
+/// This collects the diagnostics emitted while parsing chunks of the input in
+/// parallel, such that they can be reported in source order afterwards.
+/// Diagnostics emitted by threads that are not parsing a chunk are passed on.
+class ChunkDiagnosticCollector {
+public:
+  ChunkDiagnosticCollector(MLIRContext *context, size_t numChunks)
+      : context(context), diagnostics(numChunks) {
+    handlerID = context->getDiagEngine().registerHandler(
+        [this](Diagnostic &diag) -> LogicalResult {
+          std::lock_guard<std::mutex> lock(mutex);
+          auto it = threadToChunk.find(llvm::get_threadid());
+          if (it == threadToChunk.end())
+            return failure();
+          diagnostics[it->second].push_back(std::move(diag));
+          return success();
+        });
+  }
+
+  ~ChunkDiagnosticCollector() {
+    if (isRegistered)
+      context->getDiagEngine().eraseHandler(handlerID);
+  }
+
+  /// Collect the diagnostics emitted by the current thread for `chunk`, until
+  /// the next call.
+  void setChunkForThread(size_t chunk) {
+    std::lock_guard<std::mutex> lock(mutex);
+    threadToChunk[llvm::get_threadid()] = chunk;
+  }
+
+  /// Report the diagnostics of the first `numChunks` chunks in order, through
+  /// the handlers registered before this collector.
+  void emitDiagnostics(size_t numChunks) {
+    context->getDiagEngine().eraseHandler(handlerID);
+    isRegistered = false;
+    for (size_t i = 0; i != numChunks; ++i)
+      for (Diagnostic &diag : diagnostics[i])
+        context->getDiagEngine().emit(std::move(diag));
+  }
+
+private:
+  MLIRContext *context;
+  DiagnosticEngine::HandlerID handlerID;
+  bool isRegistered = true;
+  std::mutex mutex;
+  DenseMap<uint64_t, size_t> threadToChunk;
+  std::vector<std::vector<Diagnostic>> diagnostics;
+};
+
 } // end anonymous namespace
 
+/// Split the module list of a circuit, starting at the beginning of the line of
+/// the first module, into chunks of one module each.  A module ends at the next
+/// line that is not indented more than the module, which has to start the next
+/// module.  Return false if the buffer doesn't have this structure; the serial
+/// parser is used to diagnose it then.
+static bool splitIntoModules(StringRef buffer,
+                             SmallVectorImpl<StringRef> &chunks) {
+  const char *chunkStart = buffer.begin();
+  Optional<unsigned> moduleIndent;
+
+  auto isKeywordAt = [&](const char *ptr, StringRef keyword) {
+    StringRef rest(ptr, buffer.end() - ptr);
+    if (!rest.startswith(keyword) || rest.size() == keyword.size())
+      return false;
+    char next = rest[keyword.size()];
+    return !llvm::isAlnum(next) && next != '_' && next != '$' && next != '-';
+  };
+
+  for (const char *lineStart = buffer.begin(); lineStart != buffer.end();) {
+    const char *lineEnd = std::find(lineStart, buffer.end(), '\n');
+    if (lineEnd != buffer.end())
+      ++lineEnd;
+
+    // Horizontal whitespace, including commas, forms the indentation.
+    const char *ptr = lineStart;
+    while (ptr != lineEnd && (*ptr == ' ' || *ptr == '\t' || *ptr == ','))
+      ++ptr;
+    unsigned indent = ptr - lineStart;
+
+    // Skip empty lines and comments, they don't affect the module structure.
+    bool isEmpty = ptr == lineEnd || *ptr == '\n' || *ptr == '\r' ||
+                   *ptr == ';' || *ptr == 0;
+    if (!isEmpty && (!moduleIndent || indent <= *moduleIndent)) {
+      if (!isKeywordAt(ptr, "module") && !isKeywordAt(ptr, "extmodule"))
+        return false;
+      if (moduleIndent)
+        chunks.push_back(StringRef(chunkStart, lineStart - chunkStart));
+      chunkStart = lineStart;
+      moduleIndent = indent;
+    }
+    lineStart = lineEnd;
+  }
+
+  chunks.push_back(StringRef(chunkStart, buffer.end() - chunkStart));
+  return true;
+}
+
 /// file ::= circuit
 /// circuit ::= 'circuit' id ':' info? INDENT module* DEDENT EOF
 ///
@@ -2325,7 +2566,18 @@ ParseResult FIRCircuitParser::parseCircuit() {
   OpBuilder b(mlirModule.getBodyRegion());
   auto circuit = b.create<CircuitOp>(info.getLoc(), name);
 
-  // Parse any contained modules.
+  if (getState().options.parseModulesInParallel &&
+      !getState().options.moduleCallback &&
+      getContext()->isMultithreadingEnabled())
+    if (auto result = parseModulesInParallel(circuit, circuitIndent))
+      return *result;
+
+  return parseModules(circuit.getBodyBuilder(), circuitIndent);
+}
+
+/// Parse the modules of a circuit until the end of the file.
+ParseResult FIRCircuitParser::parseModules(OpBuilder moduleBuilder,
+                                           unsigned circuitIndent) {
   while (true) {
     switch (getToken().getKind()) {
     // If we got to the end of the file, then we're done.
@@ -2344,24 +2596,163 @@ ParseResult FIRCircuitParser::parseCircuit() {
 
     case FIRToken::kw_module:
     case FIRToken::kw_extmodule: {
-      auto indent = getIndentation();
-      if (!indent.hasValue())
-        return emitError("'module' must be first token on its line"), failure();
-      unsigned moduleIndent = indent.getValue();
-
-      if (moduleIndent <= circuitIndent)
-        return emitError("module should be indented more"), failure();
+      unsigned moduleIndent;
+      if (parseModuleIndent(circuitIndent, moduleIndent))
+        return failure();
 
-      FIRModuleParser mp(getState(), circuit);
+      FIRModuleParser mp(getState(), moduleBuilder);
       if (getToken().is(FIRToken::kw_module) ? mp.parseModule(moduleIndent)
                                              : mp.parseExtModule(moduleIndent))
         return failure();
+
+      // Hand the module that was just created to the client.
+      if (auto &callback = getState().options.moduleCallback)
+        if (failed(callback(&*std::prev(moduleBuilder.getInsertionPoint()))))
+          return failure();
       break;
     }
     }
   }
 }
 
+/// Check the indentation of the 'module' or 'extmodule' keyword that starts a
+/// module.
+ParseResult FIRCircuitParser::parseModuleIndent(unsigned circuitIndent,
+                                                unsigned &moduleIndent) {
+  auto indent = getIndentation();
+  if (!indent.hasValue())
+    return emitError("'module' must be first token on its line"), failure();
+  moduleIndent = indent.getValue();
+
+  if (moduleIndent <= circuitIndent)
+    return emitError("module should be indented more"), failure();
+  return success();
+}
+
+/// Parse the modules of a circuit concurrently, each with its own lexer and
+/// module parser, and add them to the circuit in source order.  The
+/// diagnostics are reported as if the modules had been parsed one after the
+/// other.  Return None if the serial parser has to be used instead, because the
+/// module list could not be split up or a module failed to parse.  In the
+/// latter case the serial parser is rerun to produce exactly the diagnostics
+/// of a serial parse.
+Optional<ParseResult>
+FIRCircuitParser::parseModulesInParallel(CircuitOp circuit,
+                                         unsigned circuitIndent) {
+  if (getToken().isNot(FIRToken::kw_module, FIRToken::kw_extmodule))
+    return None;
+  auto indent = getIndentation();
+  if (!indent.hasValue())
+    return None;
+
+  const char *modulesStart = getToken().getSpelling().data() - *indent;
+  auto &sourceMgr = getSourceMgr();
+  StringRef buffer =
+      sourceMgr.getMemoryBuffer(sourceMgr.getMainFileID())->getBuffer();
+  SmallVector<StringRef, 64> chunks;
+  if (!splitIntoModules(buffer.drop_front(modulesStart - buffer.begin()),
+                        chunks) ||
+      chunks.size() < 2)
+    return None;
+
+  LLVM_DEBUG(llvm::dbgs() << "parsing " << chunks.size()
+                          << " modules in parallel\n");
+
+  // The source manager builds its line table on first use, make sure this
+  // happens before the chunks translate locations concurrently.
+  sourceMgr.getLineAndColumn(getToken().getLoc());
+
+  // Each chunk keeps its parser state alive between the two phases below.
+  struct ModuleChunk {
+    std::unique_ptr<GlobalFIRParserState> state;
+    std::unique_ptr<FIRModuleParser> moduleParser;
+    Block block;
+    FModuleOp fmodule;
+    unsigned moduleIndent = 0;
+    ParseResult result = success();
+  };
+  std::vector<ModuleChunk> results(chunks.size());
+  auto *context = getContext();
+  auto options = getState().options;
+  llvm::StringMap<std::pair<size_t, Operation *>> moduleTable;
+
+  auto anyFailed = [&]() {
+    return llvm::any_of(
+        results, [](ModuleChunk &chunk) { return failed(chunk.result); });
+  };
+
+  {
+    ChunkDiagnosticCollector diagnostics(context, chunks.size());
+
+    // First create all modules with their ports, such that instances can refer
+    // to modules parsed in other chunks.
+    llvm::parallelForEachN(0, chunks.size(), [&](size_t i) {
+      diagnostics.setChunkForThread(i);
+      auto &chunk = results[i];
+      chunk.state = std::make_unique<GlobalFIRParserState>(sourceMgr, context,
+                                                           options, chunks[i]);
+      chunk.state->moduleTable = &moduleTable;
+      chunk.state->chunkIndex = i;
+
+      FIRCircuitParser chunkParser(*chunk.state, mlirModule);
+      if (chunkParser.parseModuleIndent(circuitIndent, chunk.moduleIndent)) {
+        chunk.result = failure();
+        return;
+      }
+      chunk.moduleParser = std::make_unique<FIRModuleParser>(
+          *chunk.state, OpBuilder::atBlockEnd(&chunk.block));
+      chunk.result =
+          chunkParser.getToken().is(FIRToken::kw_module)
+              ? chunk.moduleParser->parseModuleHeader(chunk.moduleIndent,
+                                                      chunk.fmodule)
+              : chunk.moduleParser->parseExtModule(chunk.moduleIndent);
+    });
+
+    // Fall back to the serial parser if any of the modules failed.  It stops
+    // at the first error, which a parallel parse can't easily mirror.
+    if (anyFailed()) {
+      LLVM_DEBUG(llvm::dbgs() << "reparsing the modules serially\n");
+      return None;
+    }
+
+    // The first definition of a name is the one a serial parse would find.
+    for (size_t i = 0, e = results.size(); i != e; ++i)
+      for (auto &op : results[i].block)
+        if (auto name = op.getAttrOfType<StringAttr>(
+                mlir::SymbolTable::getSymbolAttrName()))
+          moduleTable.try_emplace(name.getValue(), i, &op);
+
+    // Then parse the module bodies, and make sure nothing follows them.
+    llvm::parallelForEachN(0, chunks.size(), [&](size_t i) {
+      diagnostics.setChunkForThread(i);
+      auto &chunk = results[i];
+      if (chunk.fmodule &&
+          chunk.moduleParser->parseModuleBody(chunk.fmodule,
+                                              chunk.moduleIndent)) {
+        chunk.result = failure();
+        return;
+      }
+      chunk.result = FIRCircuitParser(*chunk.state, mlirModule)
+                         .parseModules(OpBuilder::atBlockEnd(&chunk.block),
+                                       circuitIndent);
+    });
+
+    if (anyFailed()) {
+      LLVM_DEBUG(llvm::dbgs() << "reparsing the modules serially\n");
+      return None;
+    }
+
+    diagnostics.emitDiagnostics(chunks.size());
+  }
+
+  // Move the modules into the circuit, in front of its terminator.
+  Block *body = circuit.getBody();
+  for (auto &chunk : results)
+    body->getOperations().splice(std::prev(body->end()),
+                                 chunk.block.getOperations());
+  return success();
+}
+
 //===----------------------------------------------------------------------===//
 // Driver
 //===----------------------------------------------------------------------===//
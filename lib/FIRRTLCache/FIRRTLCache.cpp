@@ -0,0 +1,1197 @@
+//===- FIRRTLCache.cpp - Binary FIRRTL cache reader and writer ------------===//
+//
+// This file implements the binary FIRRTL cache format.  All integers are
+// ULEB128 encoded, a cache file is laid out as follows:
+//
+//   cache      ::= 'FIRB' version strings opNames types attributes locations
+//                  topSize top sections
+//   strings    ::= count (size byte*)*
+//   opNames    ::= count string*
+//   types      ::= count type*
+//   attributes ::= count attribute*
+//   locations  ::= count location*
+//   top        ::= location attributes? opCount op*
+//   op         ::= opName flags location attributes? resultCount type*
+//                  operandCount operand* successorCount block*
+//                  regionCount (blockCount (argCount type*)*)* bodies
+//   operand    ::= (id << 1) | (id << 1 | 1) type
+//   bodies     ::= (opCount op*)*             -- per block of each region
+//                | ((0 | 1 op)*)* offset size -- a deferred body
+//
+// Strings, operation names, types, attributes and locations are stored once
+// and referred to by their index.  Types, attributes and locations only refer
+// to entries before them.  The FIRRTL types, integer, function and none types
+// are encoded structurally, e.g. a bundle as its element names and the indices
+// of its element types.  Other types and attributes without a dedicated
+// encoding are stored as text, which is parsed once per distinct entry.
+//
+// The bodies of symbols that are isolated from above, i.e. the modules of a
+// circuit, are deferred: they are stored in the sections at the end of the
+// file and can be loaded independently of each other.  Only a terminator
+// without operands is stored with a deferred body, such that a module that is
+// not loaded yet is valid and empty.  Values are numbered in the order they
+// are defined, starting from zero in each deferred body.  A value that is used
+// before it is defined, as graph regions allow, is marked as a forward
+// reference along with its type.
+//
+//===----------------------------------------------------------------------===//
+
+#include "circt/FIRRTLCache.h"
+#include "circt/Dialect/FIRRTL/Types.h"
+#include "mlir/IR/Attributes.h"
+#include "mlir/IR/Diagnostics.h"
+#include "mlir/IR/Module.h"
+#include "mlir/IR/StandardTypes.h"
+#include "mlir/IR/Verifier.h"
+#include "mlir/Parser.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Parallel.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace circt;
+using namespace mlir;
+
+static const char cacheMagic[] = {'F', 'I', 'R', 'B'};
+static const unsigned cacheVersion = 2;
+
+namespace {
+/// The encodings of types.
+enum TypeKind : uint8_t {
+  ClockTypeKind,
+  ResetTypeKind,
+  AsyncResetTypeKind,
+  SIntTypeKind,
+  UIntTypeKind,
+  AnalogTypeKind,
+  FlipTypeKind,
+  BundleTypeKind,
+  FVectorTypeKind,
+  IntegerTypeKind,
+  FunctionTypeKind,
+  NoneTypeKind,
+  TextTypeKind,
+};
+
+/// The encodings of attributes.
+enum AttributeKind : uint8_t {
+  StringAttrKind,
+  IntegerAttrKind,
+  UnitAttrKind,
+  TypeAttrKind,
+  ArrayAttrKind,
+  DictionaryAttrKind,
+  FlatSymbolRefAttrKind,
+  TextAttrKind,
+};
+
+/// The encodings of locations.
+enum LocationKind : uint8_t {
+  UnknownLocKind,
+  FileLineColLocKind,
+  NameLocKind,
+  CallSiteLocKind,
+  FusedLocKind,
+};
+
+/// The operation flags.
+enum : uint8_t { DeferredBody = 1 };
+} // end anonymous namespace
+
+/// Return true if the regions of the specified operation are stored as a
+/// deferred body, unless the operation is within a deferred body already.
+static bool hasDeferrableBody(Operation *op) {
+  return op->getNumRegions() != 0 && op->isKnownIsolatedFromAbove() &&
+         op->getAttrOfType<StringAttr>(SymbolTable::getSymbolAttrName());
+}
+
+/// Return the terminator of a block that is stored with a deferred body, if
+/// there is one.
+static Operation *getStoredTerminator(Block &block) {
+  if (block.empty())
+    return nullptr;
+  Operation &op = block.back();
+  if (!op.isKnownTerminator() || op.getNumOperands() != 0 ||
+      op.getNumResults() != 0 || op.getNumRegions() != 0 ||
+      op.getNumSuccessors() != 0)
+    return nullptr;
+  return &op;
+}
+
+//===----------------------------------------------------------------------===//
+// Writer
+//===----------------------------------------------------------------------===//
+
+static void writeVarInt(std::string &out, uint64_t value) {
+  do {
+    uint8_t byte = value & 0x7f;
+    value >>= 7;
+    if (value)
+      byte |= 0x80;
+    out.push_back(byte);
+  } while (value);
+}
+
+namespace {
+class CacheWriter {
+public:
+  explicit CacheWriter(MLIRContext *context) : context(context) {}
+
+  void write(ModuleOp module, raw_ostream &os);
+
+private:
+  /// The values of the top-level module or a deferred body, numbered in the
+  /// order they are written.
+  struct ValueScope {
+    DenseMap<Value, unsigned> ids;
+    unsigned numDefined = 0;
+  };
+
+  /// A table of uniqued entries and their encoding.
+  template <typename T>
+  struct Table {
+    DenseMap<T, unsigned> indices;
+    std::string data;
+  };
+
+  unsigned getStringIndex(StringRef string);
+  unsigned getOpNameIndex(OperationName name);
+  unsigned getTypeIndex(Type type);
+  unsigned getAttributeIndex(Attribute attr);
+  unsigned getLocationIndex(Location loc);
+
+  void numberValues(MutableArrayRef<Region> regions, ValueScope &scope,
+                    bool inDeferredBody);
+  void writeOp(std::string &out, Operation &op, ValueScope &scope,
+               bool inDeferredBody);
+  void writeBlockOps(std::string &out, Block &block, ValueScope &scope,
+                     bool inDeferredBody, Operation *storedTerminator);
+
+  MLIRContext *context;
+
+  llvm::StringMap<unsigned> stringIndices;
+  std::vector<StringRef> strings;
+  Table<OperationName> opNames;
+  Table<Type> types;
+  Table<Attribute> attributes;
+  Table<Location> locations;
+
+  /// The deferred bodies.
+  std::string sections;
+};
+} // end anonymous namespace
+
+unsigned CacheWriter::getStringIndex(StringRef string) {
+  auto it = stringIndices.try_emplace(string, strings.size());
+  if (it.second)
+    strings.push_back(it.first->getKey());
+  return it.first->second;
+}
+
+unsigned CacheWriter::getOpNameIndex(OperationName name) {
+  auto it = opNames.indices.find(name);
+  if (it != opNames.indices.end())
+    return it->second;
+  writeVarInt(opNames.data, getStringIndex(name.getStringRef()));
+  unsigned index = opNames.indices.size();
+  opNames.indices.try_emplace(name, index);
+  return index;
+}
+
+unsigned CacheWriter::getTypeIndex(Type type) {
+  using namespace firrtl;
+  auto it = types.indices.find(type);
+  if (it != types.indices.end())
+    return it->second;
+
+  // The types this one refers to are added to the table first.  Widths are
+  // stored off by one, such that an unknown width is zero.
+  std::string entry;
+  auto writeKind = [&](TypeKind kind) { entry.push_back(kind); };
+  if (type.isa<ClockType>()) {
+    writeKind(ClockTypeKind);
+  } else if (type.isa<ResetType>()) {
+    writeKind(ResetTypeKind);
+  } else if (type.isa<AsyncResetType>()) {
+    writeKind(AsyncResetTypeKind);
+  } else if (auto sint = type.dyn_cast<SIntType>()) {
+    writeKind(SIntTypeKind);
+    writeVarInt(entry, sint.getWidthOrSentinel() + 1);
+  } else if (auto uint = type.dyn_cast<UIntType>()) {
+    writeKind(UIntTypeKind);
+    writeVarInt(entry, uint.getWidthOrSentinel() + 1);
+  } else if (auto analog = type.dyn_cast<AnalogType>()) {
+    writeKind(AnalogTypeKind);
+    writeVarInt(entry, analog.getWidthOrSentinel() + 1);
+  } else if (auto flip = type.dyn_cast<FlipType>()) {
+    unsigned element = getTypeIndex(flip.getElementType());
+    writeKind(FlipTypeKind);
+    writeVarInt(entry, element);
+  } else if (auto bundle = type.dyn_cast<BundleType>()) {
+    SmallVector<std::pair<unsigned, unsigned>, 8> elements;
+    for (auto element : bundle.getElements())
+      elements.push_back({getStringIndex(element.first.strref()),
+                          getTypeIndex(element.second)});
+    writeKind(BundleTypeKind);
+    writeVarInt(entry, elements.size());
+    for (auto element : elements) {
+      writeVarInt(entry, element.first);
+      writeVarInt(entry, element.second);
+    }
+  } else if (auto vector = type.dyn_cast<FVectorType>()) {
+    unsigned element = getTypeIndex(vector.getElementType());
+    writeKind(FVectorTypeKind);
+    writeVarInt(entry, element);
+    writeVarInt(entry, vector.getNumElements());
+  } else if (auto integer = type.dyn_cast<IntegerType>()) {
+    writeKind(IntegerTypeKind);
+    writeVarInt(entry, integer.getWidth());
+    writeVarInt(entry, integer.getSignedness());
+  } else if (auto function = type.dyn_cast<FunctionType>()) {
+    SmallVector<unsigned, 8> inputs, results;
+    for (auto input : function.getInputs())
+      inputs.push_back(getTypeIndex(input));
+    for (auto result : function.getResults())
+      results.push_back(getTypeIndex(result));
+    writeKind(FunctionTypeKind);
+    writeVarInt(entry, inputs.size());
+    for (auto input : inputs)
+      writeVarInt(entry, input);
+    writeVarInt(entry, results.size());
+    for (auto result : results)
+      writeVarInt(entry, result);
+  } else if (type.isa<NoneType>()) {
+    writeKind(NoneTypeKind);
+  } else {
+    std::string text;
+    llvm::raw_string_ostream os(text);
+    type.print(os);
+    writeKind(TextTypeKind);
+    writeVarInt(entry, getStringIndex(os.str()));
+  }
+
+  types.data += entry;
+  unsigned index = types.indices.size();
+  types.indices.try_emplace(type, index);
+  return index;
+}
+
+unsigned CacheWriter::getAttributeIndex(Attribute attr) {
+  auto it = attributes.indices.find(attr);
+  if (it != attributes.indices.end())
+    return it->second;
+
+  // The entries this attribute refers to are added to the table first.
+  std::string entry;
+  auto writeKind = [&](AttributeKind kind) { entry.push_back(kind); };
+  auto string = attr.dyn_cast<StringAttr>();
+  auto integer = attr.dyn_cast<IntegerAttr>();
+  if (string && string.getType().isa<NoneType>()) {
+    writeKind(StringAttrKind);
+    writeVarInt(entry, getStringIndex(string.getValue()));
+  } else if (integer && integer.getValue().getBitWidth() != 0) {
+    writeKind(IntegerAttrKind);
+    writeVarInt(entry, getTypeIndex(integer.getType()));
+    APInt value = integer.getValue();
+    writeVarInt(entry, value.getBitWidth());
+    for (unsigned i = 0, e = value.getNumWords(); i != e; ++i)
+      writeVarInt(entry, value.getRawData()[i]);
+  } else if (attr.isa<UnitAttr>()) {
+    writeKind(UnitAttrKind);
+  } else if (auto type = attr.dyn_cast<TypeAttr>()) {
+    writeKind(TypeAttrKind);
+    writeVarInt(entry, getTypeIndex(type.getValue()));
+  } else if (auto array = attr.dyn_cast<ArrayAttr>()) {
+    SmallVector<unsigned, 8> elements;
+    for (auto element : array)
+      elements.push_back(getAttributeIndex(element));
+    writeKind(ArrayAttrKind);
+    writeVarInt(entry, elements.size());
+    for (auto element : elements)
+      writeVarInt(entry, element);
+  } else if (auto dict = attr.dyn_cast<DictionaryAttr>()) {
+    SmallVector<std::pair<unsigned, unsigned>, 8> elements;
+    for (auto named : dict)
+      elements.push_back({getStringIndex(named.first.strref()),
+                          getAttributeIndex(named.second)});
+    writeKind(DictionaryAttrKind);
+    writeVarInt(entry, elements.size());
+    for (auto element : elements) {
+      writeVarInt(entry, element.first);
+      writeVarInt(entry, element.second);
+    }
+  } else if (auto symbol = attr.dyn_cast<FlatSymbolRefAttr>()) {
+    writeKind(FlatSymbolRefAttrKind);
+    writeVarInt(entry, getStringIndex(symbol.getValue()));
+  } else {
+    std::string text;
+    llvm::raw_string_ostream os(text);
+    attr.print(os);
+    writeKind(TextAttrKind);
+    writeVarInt(entry, getStringIndex(os.str()));
+  }
+
+  attributes.data += entry;
+  unsigned index = attributes.indices.size();
+  attributes.indices.try_emplace(attr, index);
+  return index;
+}
+
+unsigned CacheWriter::getLocationIndex(Location loc) {
+  auto it = locations.indices.find(loc);
+  if (it != locations.indices.end())
+    return it->second;
+
+  // The locations this one refers to are added to the table first.  Opaque
+  // locations have no stable encoding and are stored as unknown locations.
+  std::string entry;
+  auto writeKind = [&](LocationKind kind) { entry.push_back(kind); };
+  if (auto fileLoc = loc.dyn_cast<FileLineColLoc>()) {
+    writeKind(FileLineColLocKind);
+    writeVarInt(entry, getStringIndex(fileLoc.getFilename()));
+    writeVarInt(entry, fileLoc.getLine());
+    writeVarInt(entry, fileLoc.getColumn());
+  } else if (auto nameLoc = loc.dyn_cast<NameLoc>()) {
+    unsigned child = getLocationIndex(nameLoc.getChildLoc());
+    writeKind(NameLocKind);
+    writeVarInt(entry, getStringIndex(nameLoc.getName().strref()));
+    writeVarInt(entry, child);
+  } else if (auto callSite = loc.dyn_cast<CallSiteLoc>()) {
+    unsigned callee = getLocationIndex(callSite.getCallee());
+    unsigned caller = getLocationIndex(callSite.getCaller());
+    writeKind(CallSiteLocKind);
+    writeVarInt(entry, callee);
+    writeVarInt(entry, caller);
+  } else if (auto fused = loc.dyn_cast<FusedLoc>()) {
+    SmallVector<unsigned, 4> fusedLocs;
+    for (auto fusedLoc : fused.getLocations())
+      fusedLocs.push_back(getLocationIndex(fusedLoc));
+    unsigned metadata =
+        fused.getMetadata() ? getAttributeIndex(fused.getMetadata()) + 1 : 0;
+    writeKind(FusedLocKind);
+    writeVarInt(entry, fusedLocs.size());
+    for (auto fusedLoc : fusedLocs)
+      writeVarInt(entry, fusedLoc);
+    writeVarInt(entry, metadata);
+  } else {
+    writeKind(UnknownLocKind);
+  }
+
+  locations.data += entry;
+  unsigned index = locations.indices.size();
+  locations.indices.try_emplace(loc, index);
+  return index;
+}
+
+/// Number the values defined in the specified regions in the order they are
+/// written: the block arguments of all regions first, then the results of the
+/// operations in the blocks.
+void CacheWriter::numberValues(MutableArrayRef<Region> regions,
+                               ValueScope &scope, bool inDeferredBody) {
+  for (Region &region : regions)
+    for (Block &block : region)
+      for (auto arg : block.getArguments())
+        scope.ids.try_emplace(arg, scope.ids.size());
+
+  for (Region &region : regions)
+    for (Block &block : region)
+      for (Operation &op : block) {
+        for (auto result : op.getResults())
+          scope.ids.try_emplace(result, scope.ids.size());
+        if (inDeferredBody || !hasDeferrableBody(&op))
+          numberValues(op.getRegions(), scope, inDeferredBody);
+      }
+}
+
+void CacheWriter::writeOp(std::string &out, Operation &op, ValueScope &scope,
+                          bool inDeferredBody) {
+  bool deferred = !inDeferredBody && hasDeferrableBody(&op);
+  writeVarInt(out, getOpNameIndex(op.getName()));
+  writeVarInt(out, deferred ? DeferredBody : 0);
+  writeVarInt(out, getLocationIndex(op.getLoc()));
+  if (op.getAttrs().empty())
+    writeVarInt(out, 0);
+  else
+    writeVarInt(out, getAttributeIndex(
+                         DictionaryAttr::get(op.getAttrs(), context)) +
+                         1);
+
+  writeVarInt(out, op.getNumResults());
+  for (auto type : op.getResultTypes())
+    writeVarInt(out, getTypeIndex(type));
+
+  writeVarInt(out, op.getNumOperands());
+  for (auto operand : op.getOperands()) {
+    unsigned id = scope.ids.lookup(operand);
+    if (id < scope.numDefined) {
+      writeVarInt(out, uint64_t(id) << 1);
+    } else {
+      writeVarInt(out, uint64_t(id) << 1 | 1);
+      writeVarInt(out, getTypeIndex(operand.getType()));
+    }
+  }
+  scope.numDefined += op.getNumResults();
+
+  writeVarInt(out, op.getNumSuccessors());
+  for (auto *successor : op.getSuccessors()) {
+    auto *region = successor->getParent();
+    writeVarInt(out,
+                std::distance(region->begin(), Region::iterator(successor)));
+  }
+
+  // A deferred body starts a new value numbering.
+  ValueScope bodyScope;
+  ValueScope &regionScope = deferred ? bodyScope : scope;
+  if (deferred)
+    numberValues(op.getRegions(), bodyScope, /*inDeferredBody=*/true);
+
+  writeVarInt(out, op.getNumRegions());
+  for (Region &region : op.getRegions()) {
+    writeVarInt(out, region.getBlocks().size());
+    for (Block &block : region) {
+      writeVarInt(out, block.getNumArguments());
+      for (auto arg : block.getArguments())
+        writeVarInt(out, getTypeIndex(arg.getType()));
+      regionScope.numDefined += block.getNumArguments();
+    }
+  }
+
+  if (!deferred) {
+    for (Region &region : op.getRegions())
+      for (Block &block : region)
+        writeBlockOps(out, block, scope, inDeferredBody, nullptr);
+    return;
+  }
+
+  std::string body;
+  for (Region &region : op.getRegions())
+    for (Block &block : region) {
+      auto *terminator = getStoredTerminator(block);
+      writeVarInt(out, terminator != nullptr);
+      if (terminator)
+        writeOp(out, *terminator, scope, inDeferredBody);
+      writeBlockOps(body, block, bodyScope, /*inDeferredBody=*/true,
+                    terminator);
+    }
+  writeVarInt(out, sections.size());
+  writeVarInt(out, body.size());
+  sections += body;
+}
+
+void CacheWriter::writeBlockOps(std::string &out, Block &block,
+                                ValueScope &scope, bool inDeferredBody,
+                                Operation *storedTerminator) {
+  writeVarInt(out, block.getOperations().size() - (storedTerminator ? 1 : 0));
+  for (Operation &op : block)
+    if (&op != storedTerminator)
+      writeOp(out, op, scope, inDeferredBody);
+}
+
+void CacheWriter::write(ModuleOp module, raw_ostream &os) {
+  // The contents are encoded first, such that the tables are complete.
+  std::string top;
+  writeVarInt(top, getLocationIndex(module.getLoc()));
+  if (module.getAttrs().empty())
+    writeVarInt(top, 0);
+  else
+    writeVarInt(top, getAttributeIndex(
+                         DictionaryAttr::get(module.getAttrs(), context)) +
+                         1);
+
+  ValueScope scope;
+  auto topOps = module.getBody()->without_terminator();
+  numberValues(module.getOperation()->getRegions(), scope,
+               /*inDeferredBody=*/false);
+  writeVarInt(top, std::distance(topOps.begin(), topOps.end()));
+  for (Operation &op : topOps)
+    writeOp(top, op, scope, /*inDeferredBody=*/false);
+
+  std::string header(cacheMagic, sizeof(cacheMagic));
+  writeVarInt(header, cacheVersion);
+  writeVarInt(header, strings.size());
+  for (auto string : strings) {
+    writeVarInt(header, string.size());
+    header += string;
+  }
+  writeVarInt(header, opNames.indices.size());
+  header += opNames.data;
+  writeVarInt(header, types.indices.size());
+  header += types.data;
+  writeVarInt(header, attributes.indices.size());
+  header += attributes.data;
+  writeVarInt(header, locations.indices.size());
+  header += locations.data;
+  writeVarInt(header, top.size());
+
+  os << header << top << sections;
+}
+
+LogicalResult circt::writeFIRRTLCache(ModuleOp module, raw_ostream &os) {
+  CacheWriter(module.getContext()).write(module, os);
+  return success();
+}
+
+//===----------------------------------------------------------------------===//
+// Reader
+//===----------------------------------------------------------------------===//
+
+namespace {
+/// Decodes the integers of a part of the cache.  Reading past the end or an
+/// index out of range marks the cursor as failed, and yields zero or null.
+struct Cursor {
+  explicit Cursor(StringRef data)
+      : ptr(data.bytes_begin()), end(data.bytes_end()) {}
+
+  uint64_t readVarInt() {
+    uint64_t result = 0;
+    for (unsigned shift = 0; ptr != end && shift < 64; shift += 7) {
+      uint8_t byte = *ptr++;
+      result |= uint64_t(byte & 0x7f) << shift;
+      if (!(byte & 0x80))
+        return result;
+    }
+    failed = true;
+    return 0;
+  }
+
+  StringRef readBytes(uint64_t size) {
+    if (size > uint64_t(end - ptr)) {
+      failed = true;
+      return {};
+    }
+    StringRef result(reinterpret_cast<const char *>(ptr), size);
+    ptr += size;
+    return result;
+  }
+
+  /// Read an index into the specified table and return the entry.
+  template <typename T>
+  T readEntry(ArrayRef<T> table) {
+    uint64_t index = readVarInt();
+    if (index < table.size())
+      return table[index];
+    failed = true;
+    return T();
+  }
+  template <typename T>
+  T readEntry(const std::vector<T> &table) {
+    return readEntry(ArrayRef<T>(table));
+  }
+
+  /// Read a count of entries that take at least one byte each.
+  uint64_t readCount() {
+    uint64_t count = readVarInt();
+    if (count > uint64_t(end - ptr)) {
+      failed = true;
+      return 0;
+    }
+    return count;
+  }
+
+  bool atEnd() const { return ptr == end; }
+
+  const uint8_t *ptr, *end;
+  bool failed = false;
+};
+
+/// The values of the top-level module or a deferred body, in the order they
+/// are defined.  Values used before their definition are represented by the
+/// result of a placeholder operation.
+struct ValueScope {
+  explicit ValueScope(OperationName placeholderName)
+      : placeholderName(placeholderName) {}
+  ~ValueScope() {
+    for (auto &entry : forwardRefs) {
+      entry.second->getResult(0).dropAllUses();
+      entry.second->destroy();
+    }
+  }
+
+  /// Define the next value, and replace its placeholder if it was used
+  /// before.  Return false if the type does not match the uses.
+  bool define(Value value) {
+    auto it = forwardRefs.find(values.size());
+    values.push_back(value);
+    if (it == forwardRefs.end())
+      return true;
+    Operation *placeholder = it->second;
+    forwardRefs.erase(it);
+    bool typesMatch = placeholder->getResult(0).getType() == value.getType();
+    placeholder->getResult(0).replaceAllUsesWith(value);
+    placeholder->destroy();
+    return typesMatch;
+  }
+
+  Value getForwardRef(uint64_t id, Type type, Location loc) {
+    Operation *&placeholder = forwardRefs[id];
+    if (!placeholder) {
+      OperationState state(loc, placeholderName);
+      state.addTypes(type);
+      placeholder = Operation::create(state);
+    }
+    return placeholder->getResult(0);
+  }
+
+  OperationName placeholderName;
+  std::vector<Value> values;
+  DenseMap<uint64_t, Operation *> forwardRefs;
+};
+} // end anonymous namespace
+
+class FIRRTLCacheReader::Impl {
+public:
+  Impl(const llvm::MemoryBuffer &buffer, MLIRContext *context)
+      : buffer(buffer), context(context),
+        placeholderName("firrtl_cache.placeholder", context) {}
+
+  OwningModuleRef loadModuleShells();
+  LogicalResult loadModuleBody(Operation *module);
+  LogicalResult loadAllModuleBodies();
+
+private:
+  InFlightDiagnostic emitError(const Twine &message) {
+    return mlir::emitError(
+        FileLineColLoc::get(buffer.getBufferIdentifier(), 0, 0, context),
+        message);
+  }
+
+  LogicalResult readTables(Cursor &cursor);
+  Type readType(Cursor &cursor);
+  Attribute readAttribute(Cursor &cursor);
+  LocationAttr readLocation(Cursor &cursor);
+  Operation *readOp(Cursor &cursor, ValueScope &scope, bool inDeferredBody,
+                    ArrayRef<Block *> regionBlocks);
+  bool readBlockOps(Cursor &cursor, Block *block, ValueScope &scope,
+                    bool inDeferredBody, ArrayRef<Block *> regionBlocks);
+  LogicalResult readDeferredBody(Operation *op, StringRef data);
+
+  const llvm::MemoryBuffer &buffer;
+  MLIRContext *context;
+  OperationName placeholderName;
+
+  std::vector<StringRef> strings;
+  std::vector<OperationName> opNames;
+  std::vector<Type> types;
+  std::vector<Attribute> attributes;
+  std::vector<LocationAttr> locations;
+  StringRef sections;
+
+  /// The deferred bodies that were not loaded yet, in the order of the file.
+  std::vector<std::pair<Operation *, StringRef>> pendingBodies;
+  DenseMap<Operation *, size_t> pendingBodyIndices;
+};
+
+LogicalResult FIRRTLCacheReader::Impl::readTables(Cursor &cursor) {
+  if (cursor.readBytes(sizeof(cacheMagic)) !=
+      StringRef(cacheMagic, sizeof(cacheMagic)))
+    return emitError("not a FIRRTL cache");
+  if (cursor.readVarInt() != cacheVersion)
+    return emitError("unsupported FIRRTL cache version");
+
+  for (uint64_t i = 0, e = cursor.readCount(); i != e; ++i)
+    strings.push_back(cursor.readBytes(cursor.readVarInt()));
+
+  for (uint64_t i = 0, e = cursor.readCount(); i != e; ++i)
+    opNames.push_back(OperationName(cursor.readEntry(strings), context));
+
+  for (uint64_t i = 0, e = cursor.readCount(); i != e && !cursor.failed; ++i) {
+    Type type = readType(cursor);
+    if (!type)
+      return failure();
+    types.push_back(type);
+  }
+
+  for (uint64_t i = 0, e = cursor.readCount(); i != e && !cursor.failed; ++i) {
+    Attribute attr = readAttribute(cursor);
+    if (!attr)
+      return failure();
+    attributes.push_back(attr);
+  }
+
+  for (uint64_t i = 0, e = cursor.readCount(); i != e && !cursor.failed; ++i)
+    locations.push_back(readLocation(cursor));
+
+  if (cursor.failed)
+    return emitError("malformed FIRRTL cache");
+  return success();
+}
+
+Type FIRRTLCacheReader::Impl::readType(Cursor &cursor) {
+  using namespace firrtl;
+  auto readFIRRTLType = [&]() -> FIRRTLType {
+    Type type = cursor.readEntry(types);
+    return type ? type.dyn_cast<FIRRTLType>() : FIRRTLType();
+  };
+  // Widths are stored off by one, such that an unknown width is zero.
+  auto readWidth = [&](int32_t &width) {
+    uint64_t value = cursor.readVarInt();
+    width = int32_t(value) - 1;
+    return !cursor.failed && value <= uint64_t(INT32_MAX);
+  };
+
+  int32_t width;
+  switch (cursor.readVarInt()) {
+  case ClockTypeKind:
+    return ClockType::get(context);
+  case ResetTypeKind:
+    return ResetType::get(context);
+  case AsyncResetTypeKind:
+    return AsyncResetType::get(context);
+
+  case SIntTypeKind:
+    if (readWidth(width))
+      return SIntType::get(context, width);
+    break;
+  case UIntTypeKind:
+    if (readWidth(width))
+      return UIntType::get(context, width);
+    break;
+  case AnalogTypeKind:
+    if (readWidth(width))
+      return AnalogType::get(context, width);
+    break;
+
+  case FlipTypeKind:
+    if (FIRRTLType element = readFIRRTLType())
+      return FlipType::get(element);
+    break;
+
+  case BundleTypeKind: {
+    SmallVector<BundleType::BundleElement, 8> elements;
+    for (uint64_t i = 0, e = cursor.readCount(); i != e; ++i) {
+      auto name = Identifier::get(cursor.readEntry(strings), context);
+      FIRRTLType type = readFIRRTLType();
+      if (!type)
+        cursor.failed = true;
+      elements.push_back({name, type});
+    }
+    if (cursor.failed)
+      break;
+    return BundleType::get(elements, context);
+  }
+
+  case FVectorTypeKind: {
+    FIRRTLType element = readFIRRTLType();
+    uint64_t numElements = cursor.readVarInt();
+    if (!element || cursor.failed || numElements > UINT32_MAX)
+      break;
+    return FVectorType::get(element, numElements);
+  }
+
+  case IntegerTypeKind: {
+    uint64_t bitWidth = cursor.readVarInt();
+    uint64_t signedness = cursor.readVarInt();
+    if (cursor.failed || bitWidth > IntegerType::kMaxWidth ||
+        signedness > IntegerType::Unsigned)
+      break;
+    return IntegerType::get(
+        bitWidth, IntegerType::SignednessSemantics(signedness), context);
+  }
+
+  case FunctionTypeKind: {
+    SmallVector<Type, 8> inputs, results;
+    for (uint64_t i = 0, e = cursor.readCount(); i != e; ++i)
+      inputs.push_back(cursor.readEntry(types));
+    for (uint64_t i = 0, e = cursor.readCount(); i != e; ++i)
+      results.push_back(cursor.readEntry(types));
+    if (cursor.failed)
+      break;
+    return FunctionType::get(inputs, results, context);
+  }
+
+  case NoneTypeKind:
+    return NoneType::get(context);
+
+  case TextTypeKind:
+    return parseType(cursor.readEntry(strings), context);
+  }
+
+  emitError("malformed FIRRTL cache");
+  return {};
+}
+
+Attribute FIRRTLCacheReader::Impl::readAttribute(Cursor &cursor) {
+  switch (cursor.readVarInt()) {
+  case StringAttrKind:
+    return StringAttr::get(cursor.readEntry(strings), context);
+
+  case IntegerAttrKind: {
+    Type type = cursor.readEntry(types);
+    uint64_t bitWidth = cursor.readVarInt();
+    if (!type || cursor.failed)
+      break;
+    // IntegerAttr::get asserts that the width of the value matches the type.
+    uint64_t typeWidth = 0;
+    if (auto integerType = type.dyn_cast<IntegerType>())
+      typeWidth = integerType.getWidth();
+    else if (type.isa<IndexType>())
+      typeWidth = IndexType::kInternalStorageBitWidth;
+    if (bitWidth == 0 || bitWidth != typeWidth)
+      break;
+    SmallVector<uint64_t, 2> words;
+    for (unsigned i = 0, e = APInt::getNumWords(bitWidth); i != e; ++i)
+      words.push_back(cursor.readVarInt());
+    if (cursor.failed)
+      break;
+    return IntegerAttr::get(type, APInt(bitWidth, words));
+  }
+
+  case UnitAttrKind:
+    return UnitAttr::get(context);
+
+  case TypeAttrKind:
+    if (Type type = cursor.readEntry(types))
+      return TypeAttr::get(type);
+    break;
+
+  case ArrayAttrKind: {
+    SmallVector<Attribute, 8> elements;
+    for (uint64_t i = 0, e = cursor.readCount(); i != e; ++i)
+      elements.push_back(cursor.readEntry(attributes));
+    if (cursor.failed)
+      break;
+    return ArrayAttr::get(elements, context);
+  }
+
+  case DictionaryAttrKind: {
+    SmallVector<NamedAttribute, 8> elements;
+    for (uint64_t i = 0, e = cursor.readCount(); i != e; ++i) {
+      auto name = Identifier::get(cursor.readEntry(strings), context);
+      elements.push_back({name, cursor.readEntry(attributes)});
+    }
+    if (cursor.failed)
+      break;
+    return DictionaryAttr::get(elements, context);
+  }
+
+  case FlatSymbolRefAttrKind:
+    return FlatSymbolRefAttr::get(cursor.readEntry(strings), context);
+
+  case TextAttrKind:
+    return parseAttribute(cursor.readEntry(strings), context);
+  }
+
+  emitError("malformed FIRRTL cache");
+  return {};
+}
+
+LocationAttr FIRRTLCacheReader::Impl::readLocation(Cursor &cursor) {
+  switch (cursor.readVarInt()) {
+  case UnknownLocKind:
+    break;
+
+  case FileLineColLocKind: {
+    auto filename = Identifier::get(cursor.readEntry(strings), context);
+    unsigned line = cursor.readVarInt();
+    unsigned column = cursor.readVarInt();
+    return FileLineColLoc::get(filename, line, column, context);
+  }
+
+  case NameLocKind: {
+    auto name = Identifier::get(cursor.readEntry(strings), context);
+    LocationAttr child = cursor.readEntry(locations);
+    if (!child)
+      break;
+    return NameLoc::get(name, child);
+  }
+
+  case CallSiteLocKind: {
+    LocationAttr callee = cursor.readEntry(locations);
+    LocationAttr caller = cursor.readEntry(locations);
+    if (!callee || !caller)
+      break;
+    return CallSiteLoc::get(callee, caller);
+  }
+
+  case FusedLocKind: {
+    SmallVector<Location, 4> fusedLocs;
+    for (uint64_t i = 0, e = cursor.readCount(); i != e; ++i) {
+      LocationAttr fusedLoc = cursor.readEntry(locations);
+      if (!fusedLoc)
+        break;
+      fusedLocs.push_back(fusedLoc);
+    }
+    Attribute metadata;
+    if (uint64_t index = cursor.readVarInt()) {
+      if (index > attributes.size()) {
+        cursor.failed = true;
+        break;
+      }
+      metadata = attributes[index - 1];
+    }
+    if (cursor.failed)
+      break;
+    return FusedLoc::get(fusedLocs, metadata, context);
+  }
+
+  default:
+    cursor.failed = true;
+    break;
+  }
+  return UnknownLoc::get(context);
+}
+
+/// Read an operation, and the operations nested in it unless they are in a
+/// deferred body.  Return null if the operation is malformed and could not be
+/// created, errors after that mark the cursor as failed.
+Operation *FIRRTLCacheReader::Impl::readOp(Cursor &cursor, ValueScope &scope,
+                                           bool inDeferredBody,
+                                           ArrayRef<Block *> regionBlocks) {
+  uint64_t nameIndex = cursor.readVarInt();
+  uint64_t flags = cursor.readVarInt();
+  LocationAttr loc = cursor.readEntry(locations);
+  if (cursor.failed || nameIndex >= opNames.size() || !loc)
+    return nullptr;
+
+  OperationState state(loc, opNames[nameIndex]);
+  if (uint64_t index = cursor.readVarInt()) {
+    auto dict = index <= attributes.size()
+                    ? attributes[index - 1].dyn_cast<DictionaryAttr>()
+                    : DictionaryAttr();
+    if (!dict)
+      return nullptr;
+    state.addAttributes(dict.getValue());
+  }
+
+  for (uint64_t i = 0, e = cursor.readCount(); i != e; ++i)
+    state.addTypes(cursor.readEntry(types));
+
+  for (uint64_t i = 0, e = cursor.readCount(); i != e; ++i) {
+    uint64_t ref = cursor.readVarInt();
+    uint64_t id = ref >> 1;
+    if (ref & 1) {
+      Type type = cursor.readEntry(types);
+      if (!type || id < scope.values.size())
+        return nullptr;
+      state.addOperands(scope.getForwardRef(id, type, loc));
+    } else {
+      if (id >= scope.values.size())
+        return nullptr;
+      state.addOperands(scope.values[id]);
+    }
+  }
+
+  for (uint64_t i = 0, e = cursor.readCount(); i != e; ++i)
+    state.addSuccessors(cursor.readEntry(regionBlocks));
+
+  uint64_t numRegions = cursor.readCount();
+  for (uint64_t i = 0; i != numRegions; ++i)
+    state.addRegion();
+
+  bool deferred = flags & DeferredBody;
+  if (cursor.failed || llvm::is_contained(state.types, Type()) ||
+      llvm::is_contained(state.successors, nullptr) ||
+      (deferred && inDeferredBody))
+    return nullptr;
+
+  // Once the operation exists, its results may be used already.  Errors are
+  // reported through the cursor, and the caller takes ownership regardless.
+  Operation *op = Operation::create(state);
+  for (auto result : op->getResults())
+    if (!scope.define(result))
+      cursor.failed = true;
+
+  // Create all blocks along with their arguments first, the argument values are
+  // numbered before the operations of the regions.
+  for (Region &region : op->getRegions()) {
+    for (uint64_t i = 0, e = cursor.readCount(); i != e; ++i) {
+      Block *block = new Block();
+      region.push_back(block);
+      for (uint64_t j = 0, f = cursor.readCount(); j != f; ++j) {
+        Type type = cursor.readEntry(types);
+        if (!type)
+          return op;
+        auto arg = block->addArgument(type);
+        if (!deferred && !scope.define(arg))
+          cursor.failed = true;
+      }
+    }
+  }
+
+  for (Region &region : op->getRegions()) {
+    SmallVector<Block *, 4> blocks;
+    for (Block &block : region)
+      blocks.push_back(&block);
+    for (Block *block : blocks) {
+      if (cursor.failed)
+        return op;
+      if (!deferred) {
+        readBlockOps(cursor, block, scope, inDeferredBody, blocks);
+        continue;
+      }
+      // Only the terminator is stored with a deferred body.
+      if (cursor.readVarInt()) {
+        Operation *terminator = readOp(cursor, scope, inDeferredBody, blocks);
+        if (!terminator) {
+          cursor.failed = true;
+          return op;
+        }
+        block->push_back(terminator);
+      }
+    }
+  }
+
+  if (deferred) {
+    uint64_t offset = cursor.readVarInt();
+    uint64_t size = cursor.readVarInt();
+    if (cursor.failed || offset > sections.size() ||
+        size > sections.size() - offset) {
+      cursor.failed = true;
+      return op;
+    }
+    pendingBodyIndices.try_emplace(op, pendingBodies.size());
+    pendingBodies.push_back({op, sections.substr(offset, size)});
+  }
+  return op;
+}
+
+/// Read the operations of a block and insert them before its terminator, if
+/// it has one already.  Return false if they are malformed.
+bool FIRRTLCacheReader::Impl::readBlockOps(Cursor &cursor, Block *block,
+                                           ValueScope &scope,
+                                           bool inDeferredBody,
+                                           ArrayRef<Block *> regionBlocks) {
+  auto insertPt = block->end();
+  if (!block->empty())
+    insertPt = Block::iterator(&block->back());
+  for (uint64_t i = 0, e = cursor.readCount(); i != e; ++i) {
+    Operation *op = readOp(cursor, scope, inDeferredBody, regionBlocks);
+    if (!op)
+      cursor.failed = true;
+    else
+      block->getOperations().insert(insertPt, op);
+    if (cursor.failed)
+      return false;
+  }
+  return !cursor.failed;
+}
+
+OwningModuleRef FIRRTLCacheReader::Impl::loadModuleShells() {
+  Cursor cursor(buffer.getBuffer());
+  if (failed(readTables(cursor)))
+    return {};
+  StringRef top = cursor.readBytes(cursor.readVarInt());
+  sections = StringRef(reinterpret_cast<const char *>(cursor.ptr),
+                       cursor.end - cursor.ptr);
+
+  Cursor topCursor(top);
+  LocationAttr loc = topCursor.readEntry(locations);
+  if (cursor.failed || topCursor.failed || !loc) {
+    emitError("malformed FIRRTL cache");
+    return {};
+  }
+  OwningModuleRef module(ModuleOp::create(loc));
+
+  if (uint64_t index = topCursor.readVarInt()) {
+    auto dict = index <= attributes.size()
+                    ? attributes[index - 1].dyn_cast<DictionaryAttr>()
+                    : DictionaryAttr();
+    if (!dict) {
+      emitError("malformed FIRRTL cache");
+      return {};
+    }
+    for (auto attr : dict)
+      module->setAttr(attr.first, attr.second);
+  }
+
+  ValueScope scope(placeholderName);
+  if (!readBlockOps(topCursor, module->getBody(), scope,
+                    /*inDeferredBody=*/false, {}) ||
+      !topCursor.atEnd() || !scope.forwardRefs.empty()) {
+    emitError("malformed FIRRTL cache");
+    return {};
+  }
+  return module;
+}
+
+/// Load the deferred body of an operation.  This only touches the operation
+/// itself, such that bodies can be read concurrently.
+LogicalResult FIRRTLCacheReader::Impl::readDeferredBody(Operation *op,
+                                                        StringRef data) {
+  Cursor cursor(data);
+  ValueScope scope(placeholderName);
+  for (Region &region : op->getRegions())
+    for (Block &block : region)
+      for (auto arg : block.getArguments())
+        scope.define(arg);
+
+  for (Region &region : op->getRegions()) {
+    SmallVector<Block *, 4> blocks;
+    for (Block &block : region)
+      blocks.push_back(&block);
+    for (Block *block : blocks)
+      if (!readBlockOps(cursor, block, scope, /*inDeferredBody=*/true, blocks))
+        return failure();
+  }
+  return success(cursor.atEnd() && scope.forwardRefs.empty());
+}
+
+LogicalResult FIRRTLCacheReader::Impl::loadModuleBody(Operation *module) {
+  auto it = pendingBodyIndices.find(module);
+  if (it == pendingBodyIndices.end())
+    return success();
+  auto &pending = pendingBodies[it->second];
+  pendingBodyIndices.erase(it);
+
+  StringRef data = pending.second;
+  pending.first = nullptr;
+  if (failed(readDeferredBody(module, data)))
+    return emitError("malformed FIRRTL cache");
+  return success();
+}
+
+LogicalResult FIRRTLCacheReader::Impl::loadAllModuleBodies() {
+  SmallVector<std::pair<Operation *, StringRef>, 0> work;
+  for (auto &pending : pendingBodies)
+    if (pending.first)
+      work.push_back(pending);
+  pendingBodies.clear();
+  pendingBodyIndices.clear();
+
+  std::vector<char> failures(work.size());
+  auto load = [&](size_t i) {
+    failures[i] = failed(readDeferredBody(work[i].first, work[i].second));
+  };
+  if (context->isMultithreadingEnabled())
+    llvm::parallelForEachN(0, work.size(), load);
+  else
+    for (size_t i = 0, e = work.size(); i != e; ++i)
+      load(i);
+
+  if (llvm::is_contained(failures, true))
+    return emitError("malformed FIRRTL cache");
+  return success();
+}
+
+FIRRTLCacheReader::FIRRTLCacheReader(const llvm::MemoryBuffer &buffer,
+                                     MLIRContext *context)
+    : impl(std::make_unique<Impl>(buffer, context)) {}
+
+FIRRTLCacheReader::~FIRRTLCacheReader() {}
+
+OwningModuleRef FIRRTLCacheReader::loadModuleShells() {
+  return impl->loadModuleShells();
+}
+
+LogicalResult FIRRTLCacheReader::loadModuleBody(Operation *module) {
+  return impl->loadModuleBody(module);
+}
+
+LogicalResult FIRRTLCacheReader::loadAllModuleBodies() {
+  return impl->loadAllModuleBodies();
+}
+
+OwningModuleRef circt::readFIRRTLCache(llvm::SourceMgr &sourceMgr,
+                                       MLIRContext *context) {
+  FIRRTLCacheReader reader(
+      *sourceMgr.getMemoryBuffer(sourceMgr.getMainFileID()), context);
+  OwningModuleRef module = reader.loadModuleShells();
+  if (!module || failed(reader.loadAllModuleBodies()))
+    return {};
+
+  // The cache is not trusted to hold valid IR.
+  if (failed(verify(*module)))
+    return {};
+  return module;
+}
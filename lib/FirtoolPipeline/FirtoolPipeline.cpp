@@ -0,0 +1,38 @@
+//===- FirtoolPipeline.cpp - The firtool pass pipeline --------------------===//
+//
+// This file builds the pass pipeline that firtool runs on a parsed circuit.
+//
+//===----------------------------------------------------------------------===//
+
+#include "circt/FirtoolPipeline.h"
+#include "circt/Dialect/FIRRTL/Ops.h"
+#include "circt/Dialect/FIRRTL/Passes.h"
+#include "circt/Dialect/RTL/Ops.h"
+#include "mlir/Pass/PassManager.h"
+#include "mlir/Transforms/Passes.h"
+
+using namespace circt;
+
+void circt::buildFirtoolPassPipeline(mlir::OpPassManager &pm,
+                                     const FirtoolPipelineOptions &options) {
+  // The lowering to RTL only handles ground types.
+  mlir::OpPassManager &circuitPM = pm.nest<firrtl::CircuitOp>();
+  if (options.lowerTypes || options.lowerToRTL)
+    circuitPM.addPass(firrtl::createLowerFIRRTLTypesPass());
+
+  // Modules are isolated from above, so the pass manager processes them in
+  // parallel.
+  mlir::OpPassManager &modulePM = circuitPM.nest<firrtl::FModuleOp>();
+  modulePM.addPass(mlir::createCSEPass());
+  modulePM.addPass(mlir::createCanonicalizerPass());
+
+  // Run the lower-to-rtl pass if requested.
+  if (options.lowerToRTL)
+    modulePM.addPass(firrtl::createLowerFIRRTLToRTLPass());
+
+  // An .mlir input may hold modules that are lowered to RTL already, they get
+  // the same cleanups.
+  mlir::OpPassManager &rtlModulePM = pm.nest<rtl::RTLModuleOp>();
+  rtlModulePM.addPass(mlir::createCSEPass());
+  rtlModulePM.addPass(mlir::createCanonicalizerPass());
+}
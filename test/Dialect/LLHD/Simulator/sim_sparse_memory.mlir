@@ -0,0 +1,23 @@
+// RUN: llhd-sim %s -sparse-threshold=4096 | FileCheck %s
+
+// CHECK-NOT: root/mem
+// CHECK: 1000ps 0d 0e  root/mem[7]  0x0000002a
+// CHECK-NEXT: 1000ps 0d 0e  root/mem[4095]  0xffffffff
+// CHECK-NOT: root/mem
+llhd.entity @root () -> () {
+  %0 = llhd.const 0 : i32
+  %init = llhd.array_uniform %0 : !llhd.array<4096 x i32>
+  %mem = llhd.sig "mem" %init : !llhd.array<4096 x i32>
+  %c0 = llhd.const 42 : i32
+  %c1 = llhd.const -1 : i32
+  %t1 = llhd.const #llhd.time<1ns, 0d, 0e> : !llhd.time
+  %t2 = llhd.const #llhd.time<2ns, 0d, 0e> : !llhd.time
+  %e0 = llhd.extract_element %mem, 7 : !llhd.sig<!llhd.array<4096 x i32>> -> !llhd.sig<i32>
+  %e1 = llhd.extract_element %mem, 3000 : !llhd.sig<!llhd.array<4096 x i32>> -> !llhd.sig<i32>
+  %e2 = llhd.extract_element %mem, 4095 : !llhd.sig<!llhd.array<4096 x i32>> -> !llhd.sig<i32>
+  llhd.drv %e0, %c0 after %t1 : !llhd.sig<i32>
+  // Driving the current value of an element does not produce a trace entry.
+  llhd.drv %e1, %0 after %t1 : !llhd.sig<i32>
+  llhd.drv %e2, %c1 after %t1 : !llhd.sig<i32>
+  llhd.drv %e0, %c0 after %t2 : !llhd.sig<i32>
+}
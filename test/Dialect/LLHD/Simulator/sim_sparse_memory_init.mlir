@@ -0,0 +1,18 @@
+// RUN: llhd-sim %s -sparse-threshold=16 | FileCheck %s
+
+// The non-zero elements of the initial value of a sparse memory are stored.
+// CHECK: 0ps 0d 0e  root/mem[1]  0x00000005
+// CHECK-NEXT: 0ps 0d 0e  root/mem[3]  0x00000007
+// CHECK-NEXT: 1000ps 0d 0e  root/mem[0]  0x0000002a
+// CHECK-NOT: root/mem
+llhd.entity @root () -> () {
+  %0 = llhd.const 0 : i32
+  %1 = llhd.const 5 : i32
+  %2 = llhd.const 7 : i32
+  %init = llhd.array %0, %1, %0, %2 : !llhd.array<4 x i32>
+  %mem = llhd.sig "mem" %init : !llhd.array<4 x i32>
+  %c = llhd.const 42 : i32
+  %t = llhd.const #llhd.time<1ns, 0d, 0e> : !llhd.time
+  %e = llhd.extract_element %mem, 0 : !llhd.sig<!llhd.array<4 x i32>> -> !llhd.sig<i32>
+  llhd.drv %e, %c after %t : !llhd.sig<i32>
+}
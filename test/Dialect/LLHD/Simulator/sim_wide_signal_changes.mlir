@@ -0,0 +1,23 @@
+// RUN: llhd-sim %s | FileCheck %s
+
+// CHECK: 0ps 0d 0e  root/wide  0x00000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000
+// CHECK-NEXT: 1000ps 0d 0e  root/wide  0x0000000000000000000000000000000000000000000000000000000000000ff00000000000000000000000000000000000000000000000000000000000000000
+// CHECK-NEXT: 3000ps 0d 0e  root/wide  0x8000000000000000000000000000000000000000000000000000000000000ff00000000000000000000000000000000000000000000000000000000000000001
+// CHECK-NOT: root/wide
+llhd.entity @root () -> () {
+  %0 = llhd.const 0 : i512
+  %s = llhd.sig "wide" %0 : i512
+  %ones = llhd.const 0xff : i8
+  %one = llhd.const 1 : i1
+  %t1 = llhd.const #llhd.time<1ns, 0d, 0e> : !llhd.time
+  %t2 = llhd.const #llhd.time<2ns, 0d, 0e> : !llhd.time
+  %t3 = llhd.const #llhd.time<3ns, 0d, 0e> : !llhd.time
+  %slice = llhd.extract_slice %s, 260 : !llhd.sig<i512> -> !llhd.sig<i8>
+  %low = llhd.extract_slice %s, 0 : !llhd.sig<i512> -> !llhd.sig<i1>
+  %high = llhd.extract_slice %s, 511 : !llhd.sig<i512> -> !llhd.sig<i1>
+  llhd.drv %slice, %ones after %t1 : !llhd.sig<i8>
+  // Re-driving the same value does not produce a trace entry.
+  llhd.drv %slice, %ones after %t2 : !llhd.sig<i8>
+  llhd.drv %low, %one after %t3 : !llhd.sig<i1>
+  llhd.drv %high, %one after %t3 : !llhd.sig<i1>
+}
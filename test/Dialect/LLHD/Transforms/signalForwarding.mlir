@@ -0,0 +1,110 @@
+// RUN: circt-opt %s -llhd-signal-forwarding | FileCheck %s
+
+// CHECK-LABEL: llhd.entity @forwardChain
+// CHECK-SAME: (%[[IN:.*]] : !llhd.sig<i32>) -> (%[[OUT:.*]] : !llhd.sig<i32>) {
+// CHECK-NEXT: %[[TIME:.*]] = llhd.const #llhd.time<0s, 1d, 0e> : !llhd.time
+// CHECK-NEXT: %[[PRB:.*]] = llhd.prb %[[IN]] : !llhd.sig<i32>
+// CHECK-NEXT: %[[NOT:.*]] = llhd.not %[[PRB]] : i32
+// CHECK-NEXT: llhd.drv %[[OUT]], %[[NOT]] after %[[TIME]] : !llhd.sig<i32>
+// CHECK-NEXT: }
+llhd.entity @forwardChain (%in : !llhd.sig<i32>) -> (%out : !llhd.sig<i32>) {
+  %c0 = llhd.const 0 : i32
+  %time = llhd.const #llhd.time<0s, 1d, 0e> : !llhd.time
+  %true = llhd.const 1 : i1
+  %a = llhd.sig "a" %c0 : i32
+  %b = llhd.sig "b" %c0 : i32
+  %0 = llhd.prb %in : !llhd.sig<i32>
+  llhd.drv %a, %0 after %time : !llhd.sig<i32>
+  %1 = llhd.prb %a : !llhd.sig<i32>
+  %2 = llhd.not %1 : i32
+  llhd.drv %b, %2 after %time if %true : !llhd.sig<i32>
+  %3 = llhd.prb %b : !llhd.sig<i32>
+  llhd.drv %out, %3 after %time : !llhd.sig<i32>
+}
+
+// CHECK-LABEL: llhd.entity @deadSignals
+// CHECK-NOT: llhd.sig
+// CHECK-NOT: llhd.prb
+// CHECK-NOT: llhd.drv
+// CHECK: }
+llhd.entity @deadSignals (%in : !llhd.sig<i8>) -> () {
+  %c0 = llhd.const 0 : i8
+  %time = llhd.const #llhd.time<0s, 1d, 0e> : !llhd.time
+  %a = llhd.sig "a" %c0 : i8
+  %b = llhd.sig "b" %c0 : i8
+  %0 = llhd.prb %in : !llhd.sig<i8>
+  llhd.drv %a, %0 after %time : !llhd.sig<i8>
+  %1 = llhd.extract_slice %a, 4 : !llhd.sig<i8> -> !llhd.sig<i4>
+  %2 = llhd.extract_slice %0, 0 : i8 -> i4
+  llhd.drv %1, %2 after %time : !llhd.sig<i4>
+  // Only observed by the dead signal %a.
+  %3 = llhd.prb %b : !llhd.sig<i8>
+  llhd.drv %a, %3 after %time : !llhd.sig<i8>
+}
+
+// CHECK-LABEL: llhd.entity @keepSignals
+// CHECK-SAME: (%[[IN:.*]] : !llhd.sig<i8>, %[[EN:.*]] : !llhd.sig<i1>) -> (%[[OUT:.*]] : !llhd.sig<i8>) {
+// CHECK: %[[DELAYED:.*]] = llhd.sig "delayed"
+// CHECK: %[[COND:.*]] = llhd.sig "cond"
+// CHECK: %[[MULTI:.*]] = llhd.sig "multi"
+// CHECK: %[[LOOP:.*]] = llhd.sig "loop"
+// CHECK: %[[SLICED:.*]] = llhd.sig "sliced"
+// CHECK-NOT: llhd.sig
+llhd.entity @keepSignals (%in : !llhd.sig<i8>, %en : !llhd.sig<i1>) -> (%out : !llhd.sig<i8>) {
+  %c0 = llhd.const 0 : i8
+  %delta = llhd.const #llhd.time<0s, 1d, 0e> : !llhd.time
+  %ns = llhd.const #llhd.time<1ns, 0d, 0e> : !llhd.time
+  %0 = llhd.prb %in : !llhd.sig<i8>
+  %1 = llhd.prb %en : !llhd.sig<i1>
+
+  // Driven after a real time delay.
+  %delayed = llhd.sig "delayed" %c0 : i8
+  llhd.drv %delayed, %0 after %ns : !llhd.sig<i8>
+  %2 = llhd.prb %delayed : !llhd.sig<i8>
+  llhd.drv %out, %2 after %delta : !llhd.sig<i8>
+
+  // Conditionally driven, keeps its value otherwise.
+  %cond = llhd.sig "cond" %c0 : i8
+  llhd.drv %cond, %0 after %delta if %1 : !llhd.sig<i8>
+  %3 = llhd.prb %cond : !llhd.sig<i8>
+  llhd.drv %out, %3 after %delta : !llhd.sig<i8>
+
+  // Driven more than once.
+  %multi = llhd.sig "multi" %c0 : i8
+  llhd.drv %multi, %0 after %delta : !llhd.sig<i8>
+  llhd.drv %multi, %c0 after %delta : !llhd.sig<i8>
+  %4 = llhd.prb %multi : !llhd.sig<i8>
+  llhd.drv %out, %4 after %delta : !llhd.sig<i8>
+
+  // Feeds back into its own driven value.
+  %loop = llhd.sig "loop" %c0 : i8
+  %5 = llhd.prb %loop : !llhd.sig<i8>
+  %6 = llhd.not %5 : i8
+  llhd.drv %loop, %6 after %delta : !llhd.sig<i8>
+  llhd.drv %out, %5 after %delta : !llhd.sig<i8>
+
+  // Partially driven through a sub-signal.
+  %sliced = llhd.sig "sliced" %c0 : i8
+  %7 = llhd.extract_slice %sliced, 0 : !llhd.sig<i8> -> !llhd.sig<i4>
+  %8 = llhd.extract_slice %0, 0 : i8 -> i4
+  llhd.drv %7, %8 after %delta : !llhd.sig<i4>
+  %9 = llhd.prb %sliced : !llhd.sig<i8>
+  llhd.drv %out, %9 after %delta : !llhd.sig<i8>
+}
+
+// Operations that were unused before forwarding are left to the canonicalizer.
+// CHECK-LABEL: llhd.entity @keepUnrelatedDeadOps
+// CHECK-SAME: (%[[IN:.*]] : !llhd.sig<i32>) -> () {
+// CHECK-NEXT: %[[C42:.*]] = llhd.const 42 : i32
+// CHECK-NEXT: %[[PRB:.*]] = llhd.prb %[[IN]] : !llhd.sig<i32>
+// CHECK-NEXT: %{{.*}} = llhd.not %[[PRB]] : i32
+// CHECK-NEXT: }
+llhd.entity @keepUnrelatedDeadOps (%in : !llhd.sig<i32>) -> () {
+  %c42 = llhd.const 42 : i32
+  %c0 = llhd.const 0 : i32
+  %time = llhd.const #llhd.time<0s, 1d, 0e> : !llhd.time
+  %a = llhd.sig "a" %c0 : i32
+  %0 = llhd.prb %in : !llhd.sig<i32>
+  %1 = llhd.not %0 : i32
+  llhd.drv %a, %c0 after %time : !llhd.sig<i32>
+}
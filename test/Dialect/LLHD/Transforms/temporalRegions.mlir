@@ -0,0 +1,66 @@
+// RUN: circt-opt %s -test-llhd-temporal-regions -o /dev/null 2>&1 | FileCheck %s
+
+// CHECK-LABEL: Temporal regions of @single: 0
+// CHECK-NEXT:    TR -1:
+// CHECK-NEXT:      blocks: ^bb0
+// CHECK-NEXT:      entry: ^bb0
+// CHECK-NEXT:      exiting: {{$}}
+// CHECK-NEXT:      successors: {{$}}
+// CHECK-NEXT:      is-successor:{{$}}
+llhd.proc @single() -> () {
+  llhd.halt
+}
+
+// CHECK-LABEL: Temporal regions of @loop: 1
+// CHECK-NEXT:    TR -1:
+// CHECK-NEXT:      blocks: ^bb0
+// CHECK-NEXT:      entry: ^bb0
+// CHECK-NEXT:      exiting: ^bb0
+// CHECK-NEXT:      successors: 0
+// CHECK-NEXT:      is-successor: 1
+// CHECK-NEXT:    TR 0:
+// CHECK-NEXT:      blocks: ^bb1
+// CHECK-NEXT:      entry: ^bb1
+// CHECK-NEXT:      exiting: ^bb1
+// CHECK-NEXT:      successors: 0
+// CHECK-NEXT:      is-successor: 1
+llhd.proc @loop() -> () {
+  br ^bb1
+^bb1:
+  llhd.wait ^bb1
+}
+
+// A TR spanning several blocks, with one exiting block that branches and one
+// that waits. The block after both is reached from a wait, so it starts a new
+// TR even though it is processed first.
+// CHECK-LABEL: Temporal regions of @diamond: 2
+// CHECK-NEXT:    TR -1:
+// CHECK-NEXT:      blocks: ^bb0
+// CHECK-NEXT:      entry: ^bb0
+// CHECK-NEXT:      exiting: ^bb0
+// CHECK-NEXT:      successors: 1
+// CHECK-NEXT:      is-successor: 0 1
+// CHECK-NEXT:    TR 0:
+// CHECK-NEXT:      blocks: ^bb4
+// CHECK-NEXT:      entry: ^bb4
+// CHECK-NEXT:      exiting: ^bb4
+// CHECK-NEXT:      successors: 1
+// CHECK-NEXT:      is-successor: 0 1
+// CHECK-NEXT:    TR 1:
+// CHECK-NEXT:      blocks: ^bb1, ^bb2, ^bb3
+// CHECK-NEXT:      entry: ^bb1
+// CHECK-NEXT:      exiting: ^bb2, ^bb3
+// CHECK-NEXT:      successors: 0
+// CHECK-NEXT:      is-successor: 1 0
+llhd.proc @diamond(%sig : !llhd.sig<i1>) -> () {
+  br ^bb1
+^bb1:
+  %cond = llhd.prb %sig : !llhd.sig<i1>
+  cond_br %cond, ^bb2, ^bb3
+^bb2:
+  br ^bb4
+^bb3:
+  llhd.wait ^bb4
+^bb4:
+  llhd.wait ^bb1
+}
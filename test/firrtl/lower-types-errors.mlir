@@ -0,0 +1,10 @@
+// RUN: circt-opt -pass-pipeline='firrtl.circuit(firrtl-lower-types)' %s -verify-diagnostics
+
+firrtl.circuit "Subaccess" {
+  firrtl.module @Subaccess(%v: !firrtl.vector<uint<1>, 4>, %i: !firrtl.uint<2>,
+                           %out: !firrtl.flip<uint<1>>) {
+    // expected-error @+1 {{'firrtl.subaccess' op cannot lower a dynamic access to a vector, it has to be removed before lowering types}}
+    %0 = firrtl.subaccess %v[%i] : (!firrtl.vector<uint<1>, 4>, !firrtl.uint<2>) -> !firrtl.uint<1>
+    firrtl.connect %out, %0 : !firrtl.flip<uint<1>>, !firrtl.uint<1>
+  }
+}
@@ -0,0 +1,126 @@
+// RUN: circt-opt -pass-pipeline='firrtl.circuit(firrtl-lower-types)' %s | FileCheck %s
+
+firrtl.circuit "Mux" {
+  // CHECK-LABEL: firrtl.module @Mux(%p: !firrtl.uint<1>, %a_x: !firrtl.uint<2>, %a_y: !firrtl.uint<3>, %b_x: !firrtl.uint<2>, %b_y: !firrtl.uint<3>, %c_x: !firrtl.flip<uint<2>>, %c_y: !firrtl.flip<uint<3>>) {
+  firrtl.module @Mux(%p: !firrtl.uint<1>,
+                     %a: !firrtl.bundle<x: uint<2>, y: uint<3>>,
+                     %b: !firrtl.bundle<x: uint<2>, y: uint<3>>,
+                     %c: !firrtl.flip<bundle<x: uint<2>, y: uint<3>>>) {
+    // CHECK-NEXT: [[MUXX:%.+]] = firrtl.mux(%p, %a_x, %b_x) : (!firrtl.uint<1>, !firrtl.uint<2>, !firrtl.uint<2>) -> !firrtl.uint<2>
+    // CHECK-NEXT: [[MUXY:%.+]] = firrtl.mux(%p, %a_y, %b_y) : (!firrtl.uint<1>, !firrtl.uint<3>, !firrtl.uint<3>) -> !firrtl.uint<3>
+    %0 = firrtl.mux(%p, %a, %b) : (!firrtl.uint<1>, !firrtl.bundle<x: uint<2>, y: uint<3>>, !firrtl.bundle<x: uint<2>, y: uint<3>>) -> !firrtl.bundle<x: uint<2>, y: uint<3>>
+
+    // CHECK-NEXT: [[NODEX:%.+]] = firrtl.node [[MUXX]] {name = "n_x"} : !firrtl.uint<2>
+    // CHECK-NEXT: [[NODEY:%.+]] = firrtl.node [[MUXY]] {name = "n_y"} : !firrtl.uint<3>
+    %n = firrtl.node %0 {name = "n"} : !firrtl.bundle<x: uint<2>, y: uint<3>>
+
+    // CHECK-NEXT: firrtl.connect %c_x, [[NODEX]] : !firrtl.flip<uint<2>>, !firrtl.uint<2>
+    // CHECK-NEXT: firrtl.connect %c_y, [[NODEY]] : !firrtl.flip<uint<3>>, !firrtl.uint<3>
+    firrtl.connect %c, %n : !firrtl.flip<bundle<x: uint<2>, y: uint<3>>>, !firrtl.bundle<x: uint<2>, y: uint<3>>
+  } // CHECK-NEXT: }
+
+  // CHECK-LABEL: firrtl.module @Flipped(%in_valid: !firrtl.uint<1>, %in_ready: !firrtl.flip<uint<1>>, %out_valid: !firrtl.flip<uint<1>>, %out_ready: !firrtl.uint<1>) {
+  firrtl.module @Flipped(%in: !firrtl.bundle<valid: uint<1>, ready: flip<uint<1>>>,
+                         %out: !firrtl.bundle<valid: flip<uint<1>>, ready: uint<1>>) {
+    // CHECK-NEXT: [[VALID:%.+]] = firrtl.wire {name = "w_valid"} : !firrtl.uint<1>
+    // CHECK-NEXT: [[READY:%.+]] = firrtl.wire {name = "w_ready"} : !firrtl.uint<1>
+    %w = firrtl.wire {name = "w"} : !firrtl.bundle<valid: uint<1>, ready: flip<uint<1>>>
+
+    // CHECK-NEXT: firrtl.connect [[VALID]], %in_valid
+    // CHECK-NEXT: firrtl.connect %in_ready, [[READY]]
+    firrtl.connect %w, %in : !firrtl.bundle<valid: uint<1>, ready: flip<uint<1>>>, !firrtl.bundle<valid: uint<1>, ready: flip<uint<1>>>
+
+    // CHECK-NEXT: firrtl.connect %out_valid, [[VALID]]
+    // CHECK-NEXT: firrtl.connect [[READY]], %out_ready
+    firrtl.connect %out, %w : !firrtl.bundle<valid: flip<uint<1>>, ready: uint<1>>, !firrtl.bundle<valid: uint<1>, ready: flip<uint<1>>>
+  } // CHECK-NEXT: }
+
+  // The reset value of a register is lowered along with the register.
+  // CHECK-LABEL: firrtl.module @RegReset(%clock: !firrtl.clock, %reset: !firrtl.uint<1>, %init_a: !firrtl.flip<uint<2>>, %init_b: !firrtl.flip<uint<3>>, %out_a: !firrtl.flip<uint<2>>, %out_b: !firrtl.flip<uint<3>>) {
+  firrtl.module @RegReset(%clock: !firrtl.clock, %reset: !firrtl.uint<1>,
+                          %init: !firrtl.flip<bundle<a: uint<2>, b: uint<3>>>,
+                          %out: !firrtl.flip<bundle<a: uint<2>, b: uint<3>>>) {
+    // CHECK-NEXT: [[INITA:%.+]] = firrtl.asPassive %init_a : (!firrtl.flip<uint<2>>) -> !firrtl.uint<2>
+    // CHECK-NEXT: [[INITB:%.+]] = firrtl.asPassive %init_b : (!firrtl.flip<uint<3>>) -> !firrtl.uint<3>
+    %0 = firrtl.asPassive %init : (!firrtl.flip<bundle<a: uint<2>, b: uint<3>>>) -> !firrtl.bundle<a: uint<2>, b: uint<3>>
+
+    // CHECK-NEXT: [[RA:%.+]] = firrtl.reginit %clock, %reset, [[INITA]] {name = "r_a"} : (!firrtl.clock, !firrtl.uint<1>, !firrtl.uint<2>) -> !firrtl.uint<2>
+    // CHECK-NEXT: [[RB:%.+]] = firrtl.reginit %clock, %reset, [[INITB]] {name = "r_b"} : (!firrtl.clock, !firrtl.uint<1>, !firrtl.uint<3>) -> !firrtl.uint<3>
+    %r = firrtl.reginit %clock, %reset, %0 {name = "r"} : (!firrtl.clock, !firrtl.uint<1>, !firrtl.bundle<a: uint<2>, b: uint<3>>) -> !firrtl.bundle<a: uint<2>, b: uint<3>>
+
+    // CHECK-NEXT: firrtl.connect %out_a, [[RA]]
+    // CHECK-NEXT: firrtl.connect %out_b, [[RB]]
+    firrtl.connect %out, %r : !firrtl.flip<bundle<a: uint<2>, b: uint<3>>>, !firrtl.bundle<a: uint<2>, b: uint<3>>
+  } // CHECK-NEXT: }
+
+  // Invalidating an aggregate invalidates each of its fields.
+  // CHECK-LABEL: firrtl.module @Invalid(%out_a: !firrtl.flip<uint<1>>, %out_b_0: !firrtl.flip<uint<2>>, %out_b_1: !firrtl.flip<uint<2>>) {
+  firrtl.module @Invalid(%out: !firrtl.flip<bundle<a: uint<1>, b: vector<uint<2>, 2>>>) {
+    // CHECK-NEXT: [[WA:%.+]] = firrtl.wire {name = "w_a"} : !firrtl.uint<1>
+    // CHECK-NEXT: [[WB:%.+]] = firrtl.wire {name = "w_b"} : !firrtl.uint<2>
+    %w = firrtl.wire {name = "w"} : !firrtl.bundle<a: uint<1>, b: uint<2>>
+
+    // CHECK-NEXT: firrtl.invalid [[WA]] : !firrtl.uint<1>
+    // CHECK-NEXT: firrtl.invalid [[WB]] : !firrtl.uint<2>
+    firrtl.invalid %w : !firrtl.bundle<a: uint<1>, b: uint<2>>
+
+    // CHECK-NEXT: firrtl.invalid %out_a : !firrtl.flip<uint<1>>
+    // CHECK-NEXT: firrtl.invalid %out_b_0 : !firrtl.flip<uint<2>>
+    // CHECK-NEXT: firrtl.invalid %out_b_1 : !firrtl.flip<uint<2>>
+    firrtl.invalid %out : !firrtl.flip<bundle<a: uint<1>, b: vector<uint<2>, 2>>>
+  } // CHECK-NEXT: }
+
+  // Partial connects only connect the fields that both sides have.
+  // CHECK-LABEL: firrtl.module @PartialConnect(%in_b: !firrtl.uint<2>, %in_c: !firrtl.uint<3>, %in_d: !firrtl.uint<4>, %out_a: !firrtl.flip<uint<1>>, %out_b: !firrtl.flip<uint<2>>, %out_c: !firrtl.flip<uint<3>>) {
+  firrtl.module @PartialConnect(%in: !firrtl.bundle<b: uint<2>, c: uint<3>, d: uint<4>>,
+                                %out: !firrtl.flip<bundle<a: uint<1>, b: uint<2>, c: uint<3>>>) {
+    // CHECK-NEXT: firrtl.partialconnect %out_b, %in_b : !firrtl.flip<uint<2>>, !firrtl.uint<2>
+    // CHECK-NEXT: firrtl.partialconnect %out_c, %in_c : !firrtl.flip<uint<3>>, !firrtl.uint<3>
+    firrtl.partialconnect %out, %in : !firrtl.flip<bundle<a: uint<1>, b: uint<2>, c: uint<3>>>, !firrtl.bundle<b: uint<2>, c: uint<3>, d: uint<4>>
+  } // CHECK-NEXT: }
+
+  // The fields of the bundles in a vector are named after their index first.
+  // CHECK-LABEL: firrtl.module @VectorOfBundles(%in_0_a: !firrtl.uint<1>, %in_0_b: !firrtl.flip<uint<2>>, %in_1_a: !firrtl.uint<1>, %in_1_b: !firrtl.flip<uint<2>>, %out: !firrtl.flip<uint<1>>, %x: !firrtl.uint<2>) {
+  firrtl.module @VectorOfBundles(%in: !firrtl.vector<bundle<a: uint<1>, b: flip<uint<2>>>, 2>,
+                                 %out: !firrtl.flip<uint<1>>, %x: !firrtl.uint<2>) {
+    %0 = firrtl.subindex %in[1] : (!firrtl.vector<bundle<a: uint<1>, b: flip<uint<2>>>, 2>) -> !firrtl.bundle<a: uint<1>, b: flip<uint<2>>>
+    %1 = firrtl.subfield %0("a") : (!firrtl.bundle<a: uint<1>, b: flip<uint<2>>>) -> !firrtl.uint<1>
+    %2 = firrtl.subfield %0("b") : (!firrtl.bundle<a: uint<1>, b: flip<uint<2>>>) -> !firrtl.flip<uint<2>>
+
+    // CHECK-NEXT: firrtl.connect %out, %in_1_a : !firrtl.flip<uint<1>>, !firrtl.uint<1>
+    firrtl.connect %out, %1 : !firrtl.flip<uint<1>>, !firrtl.uint<1>
+
+    // CHECK-NEXT: firrtl.connect %in_1_b, %x : !firrtl.flip<uint<2>>, !firrtl.uint<2>
+    firrtl.connect %2, %x : !firrtl.flip<uint<2>>, !firrtl.uint<2>
+
+    // CHECK-NEXT: firrtl.connect %in_0_b, %x : !firrtl.flip<uint<2>>, !firrtl.uint<2>
+    %3 = firrtl.subindex %in[0] : (!firrtl.vector<bundle<a: uint<1>, b: flip<uint<2>>>, 2>) -> !firrtl.bundle<a: uint<1>, b: flip<uint<2>>>
+    %4 = firrtl.subfield %3("b") : (!firrtl.bundle<a: uint<1>, b: flip<uint<2>>>) -> !firrtl.flip<uint<2>>
+    firrtl.connect %4, %x : !firrtl.flip<uint<2>>, !firrtl.uint<2>
+  } // CHECK-NEXT: }
+
+  // Memories keep their aggregate type, the fields of their data are
+  // extracted with subfields.
+  // CHECK-LABEL: firrtl.module @Memory(%clock: !firrtl.clock, %addr: !firrtl.uint<3>, %out_a: !firrtl.flip<uint<2>>, %out_b: !firrtl.flip<uint<3>>) {
+  firrtl.module @Memory(%clock: !firrtl.clock, %addr: !firrtl.uint<3>,
+                        %out: !firrtl.flip<bundle<a: uint<2>, b: uint<3>>>) {
+    // CHECK-NEXT: [[MEM:%.+]] = firrtl.mem "Undefined" {{.*}} : !firrtl.bundle<r: bundle<addr: uint<3>, en: uint<1>, clk: clock, data: flip<bundle<a: uint<2>, b: uint<3>>>>>
+    %m = firrtl.mem "Undefined" {depth = 8 : i64, name = "m", readLatency = 0 : i32, writeLatency = 1 : i32} : !firrtl.bundle<r: bundle<addr: uint<3>, en: uint<1>, clk: clock, data: flip<bundle<a: uint<2>, b: uint<3>>>>>
+
+    // CHECK-NEXT: [[R:%.+]] = firrtl.subfield [[MEM]]("r")
+    %r = firrtl.subfield %m("r") : (!firrtl.bundle<r: bundle<addr: uint<3>, en: uint<1>, clk: clock, data: flip<bundle<a: uint<2>, b: uint<3>>>>>) -> !firrtl.bundle<addr: uint<3>, en: uint<1>, clk: clock, data: flip<bundle<a: uint<2>, b: uint<3>>>>
+
+    // CHECK-NEXT: [[ADDR:%.+]] = firrtl.subfield [[R]]("addr")
+    // CHECK-NEXT: firrtl.connect [[ADDR]], %addr
+    %0 = firrtl.subfield %r("addr") : (!firrtl.bundle<addr: uint<3>, en: uint<1>, clk: clock, data: flip<bundle<a: uint<2>, b: uint<3>>>>) -> !firrtl.uint<3>
+    firrtl.connect %0, %addr : !firrtl.uint<3>, !firrtl.uint<3>
+
+    // CHECK-NEXT: [[DATA:%.+]] = firrtl.subfield [[R]]("data")
+    // CHECK-NEXT: [[DATAA:%.+]] = firrtl.subfield [[DATA]]("a")
+    // CHECK-NEXT: [[DATAB:%.+]] = firrtl.subfield [[DATA]]("b")
+    // CHECK-NEXT: firrtl.connect %out_a, [[DATAA]]
+    // CHECK-NEXT: firrtl.connect %out_b, [[DATAB]]
+    %1 = firrtl.subfield %r("data") : (!firrtl.bundle<addr: uint<3>, en: uint<1>, clk: clock, data: flip<bundle<a: uint<2>, b: uint<3>>>>) -> !firrtl.flip<bundle<a: uint<2>, b: uint<3>>>
+    firrtl.connect %out, %1 : !firrtl.flip<bundle<a: uint<2>, b: uint<3>>>, !firrtl.flip<bundle<a: uint<2>, b: uint<3>>>
+  } // CHECK-NEXT: }
+}
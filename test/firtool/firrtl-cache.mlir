@@ -0,0 +1,17 @@
+// RUN: firtool %s --format=mlir -firb -disable-opt -o %t.firb
+// RUN: firtool %t.firb -mlir -disable-opt | FileCheck %s
+
+// Values used before they are defined are restored as such.
+firrtl.circuit "Top" {
+  firrtl.module @Top(%in: !firrtl.uint<4>, %out: !firrtl.flip<uint<4>>) {
+    firrtl.connect %out, %w : !firrtl.flip<uint<4>>, !firrtl.uint<4>
+    %w = firrtl.wire {name = "w"} : !firrtl.uint<4>
+    firrtl.connect %w, %in : !firrtl.uint<4>, !firrtl.uint<4>
+  }
+}
+
+// CHECK-LABEL: firrtl.module @Top(%in: !firrtl.uint<4>, %out: !firrtl.flip<uint<4>>) {
+// CHECK-NEXT:    firrtl.connect %out, %w : !firrtl.flip<uint<4>>, !firrtl.uint<4>
+// CHECK-NEXT:    %w = firrtl.wire {name = "w"} : !firrtl.uint<4>
+// CHECK-NEXT:    firrtl.connect %w, %in : !firrtl.uint<4>, !firrtl.uint<4>
+// CHECK-NEXT:  }
@@ -0,0 +1,21 @@
+// RUN: firtool %s --format=mlir -mlir | FileCheck %s
+// RUN: firtool %s --format=mlir -mlir -disable-opt | FileCheck %s --check-prefix=NOOPT
+
+// Modules that are lowered to RTL already are optimized as well.
+rtl.module @Top(%a: i7) -> (i7, i7) {
+  %c10_i7 = rtl.constant(10 : i7) : i7
+  %c5_i7 = rtl.constant(5 : i7) : i7
+  %0 = rtl.add %a, %c10_i7, %c5_i7 : i7
+  %1 = rtl.add %a, %c10_i7, %c5_i7 : i7
+  rtl.output %0, %1 : i7, i7
+}
+
+// CHECK-LABEL: rtl.module @Top
+// CHECK-NEXT:    %c15_i7 = rtl.constant(15 : i7)
+// CHECK-NEXT:    %0 = rtl.add %arg0, %c15_i7 : i7
+// CHECK-NEXT:    rtl.output %0, %0 : i7, i7
+
+// NOOPT-LABEL: rtl.module @Top
+// NOOPT:         rtl.add
+// NOOPT:         rtl.add
+// NOOPT:         rtl.output
@@ -37,6 +37,10 @@ llvm_config.with_system_environment(
 
 llvm_config.use_default_substitutions()
 
+# Tests of compressed output require LLVM to be built with zlib.
+if config.have_zlib:
+    config.available_features.add('zlib')
+
 # excludes: A list of directories to exclude from the testsuite. The 'Inputs'
 # subdirectories contain auxiliary inputs for various tests in their parent
 # directories.
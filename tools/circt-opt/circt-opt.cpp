@@ -36,6 +36,13 @@ using namespace llvm;
 using namespace mlir;
 using namespace circt;
 
+// Test passes, they have no public header.
+namespace circt {
+namespace llhd {
+void registerTestTemporalRegionsPass();
+} // namespace llhd
+} // namespace circt
+
 static cl::opt<std::string>
     inputFilename(cl::Positional, cl::desc("<input file>"), cl::init("-"));
 
@@ -108,6 +115,7 @@ int main(int argc, char **argv) {
   registry.insert<sv::SVDialect>();
 
   llhd::initLLHDTransformationPasses();
+  llhd::registerTestTemporalRegionsPass();
   llhd::initLLHDToLLVMPass();
   llhd::registerFIRRTLToLLHDPasses();
 
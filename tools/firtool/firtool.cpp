@@ -7,37 +7,70 @@
 
 #include "circt/Dialect/FIRRTL/Dialect.h"
 #include "circt/Dialect/FIRRTL/Ops.h"
-#include "circt/Dialect/FIRRTL/Passes.h"
 #include "circt/Dialect/RTL/Dialect.h"
 #include "circt/Dialect/SV/Dialect.h"
 #include "circt/EmitVerilog.h"
 #include "circt/FIRParser.h"
+#include "circt/FIRRTLCache.h"
+#include "circt/FirtoolPipeline.h"
 #include "mlir/Dialect/StandardOps/IR/Ops.h"
+#include "mlir/IR/AsmState.h"
 #include "mlir/IR/Module.h"
+#include "mlir/IR/Verifier.h"
 #include "mlir/Parser.h"
 #include "mlir/Pass/Pass.h"
 #include "mlir/Pass/PassManager.h"
 #include "mlir/Support/FileUtilities.h"
-#include "mlir/Transforms/Passes.h"
+#include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Compression.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/Endian.h"
+#include "llvm/Support/FileSystem.h"
 #include "llvm/Support/InitLLVM.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/Parallel.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/Threading.h"
 #include "llvm/Support/ToolOutputFile.h"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#if LLVM_ON_UNIX
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 using namespace llvm;
 using namespace mlir;
 using namespace circt;
 
+#define DEBUG_TYPE "firtool"
+
 /// Allow the user to specify the input file format.  This can be used to
 /// override the input, and can be used to specify ambiguous cases like standard
 /// input.
-enum InputFormatKind { InputUnspecified, InputFIRFile, InputMLIRFile };
+enum InputFormatKind {
+  InputUnspecified,
+  InputFIRFile,
+  InputMLIRFile,
+  InputFIRRTLCache
+};
 
 static cl::opt<InputFormatKind> inputFormat(
     "format", cl::desc("Specify input file format:"),
     cl::values(clEnumValN(InputUnspecified, "autodetect",
                           "Autodetect input format"),
                clEnumValN(InputFIRFile, "fir", "Parse as .fir file"),
-               clEnumValN(InputMLIRFile, "mlir", "Parse as .mlir file")),
+               clEnumValN(InputMLIRFile, "mlir", "Parse as .mlir file"),
+               clEnumValN(InputFIRRTLCache, "firb",
+                          "Load as binary FIRRTL cache")),
     cl::init(InputUnspecified));
 
 static cl::opt<std::string>
@@ -53,25 +86,602 @@ static cl::opt<bool> disableOptimization("disable-opt",
 static cl::opt<bool> lowerToRTL("lower-to-rtl",
                                 cl::desc("run the lower-to-rtl pass"));
 
+static cl::opt<bool> lowerTypes(
+    "lower-types",
+    cl::desc("lower bundle and vector types to ground types, this is implied "
+             "by -lower-to-rtl"),
+    cl::init(false));
+
 static cl::opt<bool>
     ignoreFIRLocations("ignore-fir-locators",
                        cl::desc("ignore the @info locations in the .fir file"),
                        cl::init(false));
 
-enum OutputFormatKind { OutputMLIR, OutputVerilog, OutputDisabled };
+static cl::opt<bool> parseModulesInParallel(
+    "parse-modules-in-parallel",
+    cl::desc("parse the modules of a .fir file concurrently"),
+    cl::init(false));
+
+static cl::opt<bool> dropFIRLocations(
+    "drop-fir-locations",
+    cl::desc("locate operations in the .fir file without a line and column, "
+             "only parser diagnostics keep them"),
+    cl::init(false));
+
+static cl::opt<bool> releaseInputAfterParse(
+    "release-input-after-parse",
+    cl::desc("drop the input file from memory once it is parsed, it is only "
+             "read back for diagnostics"),
+    cl::init(false));
+
+static cl::opt<bool> streamModules(
+    "stream-modules",
+    cl::desc("optimize, lower and emit each module of a .fir file or FIRRTL "
+             "cache as soon as it is loaded, and drop its body afterwards"),
+    cl::init(false));
+
+static cl::opt<std::string> incrementalCache(
+    "incremental-cache",
+    cl::desc("reuse the Verilog of the modules that did not change since a "
+             "previous run, which is kept in the specified directory"),
+    cl::value_desc("directory"), cl::init(""));
+
+static cl::opt<bool> dropVerilogLocations(
+    "drop-verilog-locations",
+    cl::desc("do not emit the source locations of Verilog statements as "
+             "comments"),
+    cl::init(false));
+
+static cl::opt<unsigned> verilogMaxExprSize(
+    "verilog-max-expr-size",
+    cl::desc("split Verilog expressions with more operations than this into "
+             "wires, or 0 for no limit"),
+    cl::init(VerilogEmitterOptions().maxExpressionSize));
+
+static cl::opt<unsigned> verilogMaxExprDepth(
+    "verilog-max-expr-depth",
+    cl::desc("split Verilog expressions that are deeper than this into wires, "
+             "or 0 for no limit"),
+    cl::init(VerilogEmitterOptions().maxExpressionDepth));
+
+static cl::opt<unsigned>
+    numThreads("j",
+               cl::desc("number of threads to use, or 0 to use all cores"),
+               cl::value_desc("N"), cl::init(0));
+
+enum OutputFormatKind {
+  OutputMLIR,
+  OutputVerilog,
+  OutputSplitVerilog,
+  OutputFIRRTLCache,
+  OutputDisabled
+};
 
 static cl::opt<OutputFormatKind> outputFormat(
     cl::desc("Specify output format:"),
     cl::values(clEnumValN(OutputMLIR, "mlir", "Emit MLIR dialect"),
                clEnumValN(OutputVerilog, "verilog", "Emit Verilog"),
+               clEnumValN(OutputSplitVerilog, "split-verilog",
+                          "Emit Verilog, one file per module in the "
+                          "directory specified by -o"),
+               clEnumValN(OutputFIRRTLCache, "firb",
+                          "Emit binary FIRRTL cache"),
                clEnumValN(OutputDisabled, "disable-output",
                           "Do not output anything")),
     cl::init(OutputMLIR));
 
-/// Process a single buffer of the input.
+namespace {
+/// A read-only memory mapping of an input file.  MemoryBuffer::getFile reads
+/// a file into memory instead of mapping it if the size of the file is a
+/// multiple of the page size, because there is no room for the nul terminator
+/// the parsers rely on.  This mapping is followed by a zero page in that case,
+/// such that even huge inputs are never copied.
+class MappedInputBuffer : public llvm::MemoryBuffer {
+public:
+  /// Map the specified file, or return null if it is not a regular file or
+  /// cannot be mapped.
+  static std::unique_ptr<MappedInputBuffer> create(StringRef filename);
+  ~MappedInputBuffer() override;
+
+  StringRef getBufferIdentifier() const override { return identifier; }
+  BufferKind getBufferKind() const override { return MemoryBuffer_MMap; }
+
+  /// Tell the kernel that the parser is about to read the file front to back,
+  /// such that it reads ahead aggressively.
+  void adviseSequential();
+
+  /// Tell the kernel that the parser is done.  If `release` is set, the pages
+  /// of the file are dropped from memory.  The mapping stays valid and reads
+  /// them back from the file if a diagnostic needs to show a line of it.
+  void adviseDoneParsing(bool release);
+
+private:
+  MappedInputBuffer(StringRef filename, void *mapping, size_t mappingSize)
+      : identifier(filename), mapping(mapping), mappingSize(mappingSize) {}
+
+  std::string identifier;
+  void *mapping;
+  size_t mappingSize;
+};
+} // end anonymous namespace
+
+#if LLVM_ON_UNIX
+std::unique_ptr<MappedInputBuffer>
+MappedInputBuffer::create(StringRef filename) {
+  int fd = ::open(filename.str().c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return nullptr;
+
+  struct stat status;
+  if (::fstat(fd, &status) != 0 || !S_ISREG(status.st_mode) ||
+      status.st_size == 0) {
+    ::close(fd);
+    return nullptr;
+  }
+
+  // Reserve zeroed memory for the file and its nul terminator, then map the
+  // file over the start of it.
+  size_t size = status.st_size;
+  size_t mappingSize = alignTo(size + 1, sys::Process::getPageSizeEstimate());
+  void *mapping = ::mmap(nullptr, mappingSize, PROT_READ,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (mapping != MAP_FAILED &&
+      ::mmap(mapping, size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) ==
+          MAP_FAILED) {
+    ::munmap(mapping, mappingSize);
+    mapping = MAP_FAILED;
+  }
+  ::close(fd);
+  if (mapping == MAP_FAILED)
+    return nullptr;
+
+  std::unique_ptr<MappedInputBuffer> buffer(
+      new MappedInputBuffer(filename, mapping, mappingSize));
+  const char *start = static_cast<const char *>(mapping);
+  buffer->init(start, start + size, /*RequiresNullTerminator=*/true);
+  LLVM_DEBUG(llvm::dbgs() << "mapped " << size << " bytes of input file '"
+                          << filename << "'\n");
+  return buffer;
+}
+
+MappedInputBuffer::~MappedInputBuffer() { ::munmap(mapping, mappingSize); }
+
+void MappedInputBuffer::adviseSequential() {
+  ::madvise(mapping, mappingSize, MADV_SEQUENTIAL);
+}
+
+void MappedInputBuffer::adviseDoneParsing(bool release) {
+  ::madvise(mapping, mappingSize, release ? MADV_DONTNEED : MADV_NORMAL);
+  LLVM_DEBUG(if (release) llvm::dbgs()
+             << "released the pages of input file '" << identifier << "'\n");
+}
+#else
+std::unique_ptr<MappedInputBuffer>
+MappedInputBuffer::create(StringRef filename) {
+  return nullptr;
+}
+
+MappedInputBuffer::~MappedInputBuffer() {}
+void MappedInputBuffer::adviseSequential() {}
+void MappedInputBuffer::adviseDoneParsing(bool release) {}
+#endif
+
+namespace {
+/// The output stream firtool writes to.  Output is collected in a large buffer
+/// and every full buffer is handed to a background thread, which compresses
+/// it if requested and writes it to the output file.  This overlaps emission
+/// with compression and file IO.
+class OutputSink : public raw_ostream {
+public:
+  enum class Compression { None, Gzip };
+
+  OutputSink(raw_ostream &os, Compression compression);
+  ~OutputSink() override;
+
+  /// Write out all pending output and wait for the background thread.  This
+  /// fails if the output could not be compressed.
+  LogicalResult finish();
+
+private:
+  void write_impl(const char *ptr, size_t size) override;
+  uint64_t current_pos() const override { return pos; }
+
+  /// Write chunks to the output until `finish` is called.  This runs on the
+  /// background thread.
+  void runWriter();
+
+  /// Compress a chunk and write it as a gzip member.  A gzip file may consist
+  /// of any number of members, which decompress to their concatenation.
+  void writeGzipMember(StringRef data);
+
+  /// The size of the buffer, and the most chunks waiting to be written before
+  /// the emitter has to wait for the background thread.
+  static constexpr size_t chunkSize = 8 << 20;
+  static constexpr size_t maxPendingChunks = 4;
+
+  raw_ostream &os;
+  Compression compression;
+  uint64_t pos = 0;
+  bool wroteGzipMember = false;
+  bool finished = false;
+  std::string error;
+
+  std::mutex mutex;
+  std::condition_variable changed;
+  std::deque<std::string> pendingChunks;
+  bool done = false;
+  std::thread writer;
+};
+} // end anonymous namespace
+
+OutputSink::OutputSink(raw_ostream &os, Compression compression)
+    : os(os), compression(compression) {
+  SetBufferSize(chunkSize);
+  writer = std::thread([this] { runWriter(); });
+}
+
+OutputSink::~OutputSink() { (void)finish(); }
+
+LogicalResult OutputSink::finish() {
+  if (!finished) {
+    finished = true;
+    flush();
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      done = true;
+    }
+    changed.notify_all();
+    writer.join();
+
+    // An empty file is not a valid gzip file.
+    if (compression == Compression::Gzip && !wroteGzipMember)
+      writeGzipMember("");
+    os.flush();
+  }
+
+  if (error.empty())
+    return success();
+  llvm::errs() << "cannot compress output: " << error << "\n";
+  error.clear();
+  return failure();
+}
+
+void OutputSink::write_impl(const char *ptr, size_t size) {
+  pos += size;
+  std::unique_lock<std::mutex> lock(mutex);
+  changed.wait(lock, [&] { return pendingChunks.size() < maxPendingChunks; });
+  pendingChunks.emplace_back(ptr, size);
+  changed.notify_all();
+}
+
+void OutputSink::runWriter() {
+  while (true) {
+    std::string chunk;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      changed.wait(lock, [&] { return done || !pendingChunks.empty(); });
+      if (pendingChunks.empty())
+        return;
+      chunk = std::move(pendingChunks.front());
+      pendingChunks.pop_front();
+    }
+    changed.notify_all();
+
+    if (compression == Compression::Gzip)
+      writeGzipMember(chunk);
+    else
+      os << chunk;
+  }
+}
+
+void OutputSink::writeGzipMember(StringRef data) {
+  wroteGzipMember = true;
+  if (!error.empty())
+    return;
+
+  // zlib produces a zlib stream, which is a two byte header, the deflate data
+  // and an Adler-32 checksum.  The deflate data is reused as is.
+  SmallVector<char, 0> compressed;
+  if (auto err = zlib::compress(data, compressed)) {
+    error = toString(std::move(err));
+    return;
+  }
+  StringRef deflateData(compressed.data(), compressed.size());
+  deflateData = deflateData.drop_front(2).drop_back(4);
+
+  // The member header: magic, deflate, no flags, no time, no extra flags and
+  // an unknown operating system.
+  static const char header[] = {'\x1f', '\x8b', 8, 0, 0, 0, 0, 0, 0, '\xff'};
+  os.write(header, sizeof(header));
+  os << deflateData;
+  char trailer[8];
+  support::endian::write32le(trailer, zlib::crc32(data));
+  support::endian::write32le(trailer + 4, uint32_t(data.size()));
+  os.write(trailer, sizeof(trailer));
+}
+
+/// Return the Verilog emitter options requested on the command line.
+static VerilogEmitterOptions getVerilogEmitterOptions() {
+  VerilogEmitterOptions options;
+  options.dropLocationInfo = dropVerilogLocations;
+  options.maxExpressionSize = verilogMaxExprSize;
+  options.maxExpressionDepth = verilogMaxExprDepth;
+  return options;
+}
+
+/// Add the optimizations and lowerings requested on the command line to the
+/// specified pass manager.
+static void buildPassPipeline(PassManager &pm) {
+  // Apply any pass manager command line options.
+  applyPassManagerCLOptions(pm);
+
+  FirtoolPipelineOptions options;
+  options.lowerTypes = lowerTypes;
+  options.lowerToRTL = lowerToRTL;
+  buildFirtoolPassPipeline(pm, options);
+}
+
+namespace {
+/// Runs the pass pipeline on the modules of a .fir file and emits them while
+/// the file is being parsed, or while a FIRRTL cache is being loaded, such that
+/// only one module body is alive at a time.  Each module is moved into a
+/// staging circuit together with copies of the modules it instantiates, which
+/// only provide their ports.  Its body is dropped once it is emitted, the
+/// parser only needs the ports of a module to check later instances of it.
+/// The staging circuit is named after the module it holds, such that it
+/// verifies as a circuit of its own.
+class ModuleStreamer {
+public:
+  ModuleStreamer(MLIRContext &context, raw_ostream &os)
+      : context(context), os(os) {}
+
+  /// Process a module or extmodule that was just parsed or loaded.
+  LogicalResult processModule(Operation *op);
+
+private:
+  MLIRContext &context;
+  raw_ostream &os;
+  OwningModuleRef stage;
+  firrtl::CircuitOp stageCircuit;
+  std::unique_ptr<PassManager> pm;
+};
+} // end anonymous namespace
+
+LogicalResult ModuleStreamer::processModule(Operation *op) {
+  // The header is only emitted once the parser got to the first module, such
+  // that a circuit that fails to parse produces no output.
+  auto circuit = op->getParentOfType<firrtl::CircuitOp>();
+  if (!stage) {
+    if (outputFormat == OutputVerilog)
+      emitVerilogCircuitHeader(os);
+    stage = ModuleOp::create(circuit.getLoc());
+    OpBuilder builder(stage->getBodyRegion());
+    stageCircuit =
+        builder.create<firrtl::CircuitOp>(circuit.getLoc(), circuit.nameAttr());
+    if (!disableOptimization) {
+      pm = std::make_unique<PassManager>(&context, /*verifyPasses:*/ true);
+      buildPassPipeline(*pm);
+    }
+  }
+
+  // Extmodules have nothing to process, they are copied into the staging
+  // circuit when they are instantiated.
+  auto module = dyn_cast<firrtl::FModuleOp>(op);
+  if (!module)
+    return success();
+  stageCircuit.setAttr("name", StringAttr::get(module.getName(), &context));
+
+  // All modules parsed before this one are shells already, copying them is
+  // cheap.
+  auto stageBuilder = stageCircuit.getBodyBuilder();
+  SmallPtrSet<Operation *, 8> instantiated;
+  module.walk([&](firrtl::InstanceOp instance) {
+    auto *referenced = circuit.lookupSymbol(instance.moduleName());
+    if (referenced && instantiated.insert(referenced).second)
+      stageBuilder.clone(*referenced);
+  });
+
+  Block *parentBlock = module->getBlock();
+  auto nextOp = std::next(Block::iterator(module.getOperation()));
+  module->moveBefore(stageCircuit.getBody()->getTerminator());
+
+  // Passes may rewrite the ports of the module, e.g. when lowering aggregate
+  // types, but the parser checks later instances against the original ports.
+  SmallVector<NamedAttribute, 8> originalAttrs(module->getAttrs().begin(),
+                                               module->getAttrs().end());
+  auto originalType = module.getType();
+
+  // The parser does not verify the modules it hands out, so verify the staged
+  // circuit before the passes or the emitter get to see it.
+  LogicalResult result = verify(stage.get());
+  if (succeeded(result) && pm)
+    result = pm->run(stage.get());
+  if (succeeded(result) && outputFormat == OutputVerilog)
+    result = emitVerilogModule(module, os, getVerilogEmitterOptions());
+
+  // Put the module back as a shell with its ports, and clear the staging
+  // circuit for the next one.
+  Block *body = module.getBodyBlock();
+  body->dropAllReferences();
+  body->getOperations().erase(body->begin(), std::prev(body->end()));
+  if (module.getType() != originalType) {
+    module->setAttrs(originalAttrs);
+    while (body->getNumArguments())
+      body->eraseArgument(0);
+    for (auto type : originalType.getInputs())
+      body->addArgument(type);
+  }
+  module->moveBefore(parentBlock, nextOp);
+
+  Block *stageBody = stageCircuit.getBody();
+  stageBody->getOperations().erase(stageBody->begin(),
+                                   std::prev(stageBody->end()));
+  return result;
+}
+
+namespace {
+/// A stream that hashes everything written to it.
+class HashingStream : public raw_ostream {
+public:
+  ~HashingStream() override { flush(); }
+
+  /// Return the hash of everything written so far as a hex string.
+  std::string getHash() {
+    flush();
+    llvm::MD5::MD5Result result;
+    md5.final(result);
+    return result.digest().str().str();
+  }
+
+private:
+  void write_impl(const char *ptr, size_t size) override {
+    md5.update(StringRef(ptr, size));
+    pos += size;
+  }
+  uint64_t current_pos() const override { return pos; }
+
+  llvm::MD5 md5;
+  uint64_t pos = 0;
+};
+
+/// Reuses the Verilog of the modules that did not change since a previous run.
+/// The Verilog of a module only depends on its IR, the ports, defname and
+/// parameters of the modules it instantiates, and the pipeline options.  Their
+/// hash identifies the module, and names the file that holds its Verilog in
+/// the cache directory.
+class IncrementalCache {
+public:
+  explicit IncrementalCache(StringRef directory) : directory(directory) {}
+
+  /// Hash the modules of all circuits and look them up in the cache.  The
+  /// bodies of the modules that are found are dropped, such that the pass
+  /// pipeline only processes the changed modules.
+  LogicalResult loadModules(ModuleOp module);
+
+  /// Emit Verilog like `emitVerilog` does, reusing the cached modules and
+  /// adding the others to the cache.
+  LogicalResult emitVerilog(ModuleOp module, raw_ostream &os);
+
+private:
+  void storeModule(StringRef hash, StringRef verilog);
+
+  std::string directory;
+
+  struct CachedModule {
+    std::string hash;
+    /// The Verilog of the module, if it was found in the cache.
+    std::unique_ptr<llvm::MemoryBuffer> verilog;
+  };
+  DenseMap<Operation *, CachedModule> modules;
+};
+} // end anonymous namespace
+
+LogicalResult IncrementalCache::loadModules(ModuleOp module) {
+  if (auto error = sys::fs::create_directories(directory))
+    return emitError(module.getLoc(), "cannot create incremental cache '")
+           << directory << "': " << error.message();
+
+  OpPrintingFlags printingFlags;
+  printingFlags.enableDebugInfo();
+  for (auto circuit : module.getBody()->getOps<firrtl::CircuitOp>()) {
+    SymbolTable symbolTable(circuit);
+    for (auto fmodule : circuit.getBody()->getOps<firrtl::FModuleOp>()) {
+      HashingStream hash;
+      hash << "firtool incremental cache 1, disable-opt="
+           << static_cast<bool>(disableOptimization)
+           << ", lower-to-rtl=" << static_cast<bool>(lowerToRTL)
+           << ", lower-types=" << static_cast<bool>(lowerTypes)
+           << ", drop-verilog-locations="
+           << static_cast<bool>(dropVerilogLocations)
+           << ", verilog-max-expr-size=" << unsigned(verilogMaxExprSize)
+           << ", verilog-max-expr-depth=" << unsigned(verilogMaxExprDepth)
+           << '\n';
+      fmodule.getOperation()->print(hash, printingFlags);
+      fmodule.walk([&](firrtl::InstanceOp instance) {
+        if (auto *referenced = symbolTable.lookup(instance.moduleName()))
+          for (auto attr : referenced->getAttrs())
+            hash << attr.first << '=' << attr.second << '\n';
+      });
+
+      auto &cached = modules[fmodule];
+      cached.hash = hash.getHash();
+      auto verilog =
+          MemoryBuffer::getFile(directory + "/" + cached.hash + ".v");
+      if (!verilog)
+        continue;
+      cached.verilog = std::move(*verilog);
+
+      // Only the ports are needed by the modules that instantiate it.
+      Block *body = fmodule.getBodyBlock();
+      body->dropAllReferences();
+      body->getOperations().erase(body->begin(), std::prev(body->end()));
+    }
+  }
+  return success();
+}
+
+/// Add the Verilog of a module to the cache.  The file is created under a
+/// temporary name and then renamed, such that concurrent runs never see a
+/// partial file.  The cache is best effort, failing to update it is ignored.
+void IncrementalCache::storeModule(StringRef hash, StringRef verilog) {
+  int fd;
+  SmallString<128> tempPath;
+  if (sys::fs::createUniqueFile(directory + "/" + hash + "-%%%%%%.tmp", fd,
+                                tempPath))
+    return;
+  {
+    raw_fd_ostream os(fd, /*shouldClose=*/true);
+    os << verilog;
+    if (os.has_error()) {
+      os.clear_error();
+      sys::fs::remove(tempPath);
+      return;
+    }
+  }
+  if (sys::fs::rename(tempPath, directory + "/" + hash + ".v"))
+    sys::fs::remove(tempPath);
+}
+
+LogicalResult IncrementalCache::emitVerilog(ModuleOp module, raw_ostream &os) {
+  auto options = getVerilogEmitterOptions();
+  bool encounteredError = false;
+  auto emitModule = [&](Operation *op) {
+    auto it = modules.find(op);
+    if (it != modules.end() && it->second.verilog) {
+      os << it->second.verilog->getBuffer();
+      return;
+    }
+
+    std::string verilog;
+    llvm::raw_string_ostream verilogStream(verilog);
+    if (failed(emitVerilogModule(op, verilogStream, options))) {
+      encounteredError = true;
+      return;
+    }
+    os << verilogStream.str();
+    if (it != modules.end())
+      storeModule(it->second.hash, verilog);
+  };
+
+  for (auto &op : *module.getBody()) {
+    if (auto circuit = dyn_cast<firrtl::CircuitOp>(op)) {
+      emitVerilogCircuitHeader(os);
+      for (auto &moduleOp : *circuit.getBody())
+        if (!isa<firrtl::DoneOp>(moduleOp) &&
+            !isa<firrtl::FExtModuleOp>(moduleOp))
+          emitModule(&moduleOp);
+    } else if (!isa<ModuleTerminatorOp>(op)) {
+      emitModule(&op);
+    }
+  }
+  return failure(encounteredError);
+}
+
+/// Process a single buffer of the input.  If the input is a mapped file,
+/// `mappedInput` points to it.
 static LogicalResult
 processBuffer(std::unique_ptr<llvm::MemoryBuffer> ownedBuffer,
-              raw_ostream &os) {
+              MappedInputBuffer *mappedInput, raw_ostream &os) {
   MLIRContext context;
 
   // Register our dialects.
@@ -81,39 +691,90 @@ processBuffer(std::unique_ptr<llvm::MemoryBuffer> ownedBuffer,
   sourceMgr.AddNewSourceBuffer(std::move(ownedBuffer), llvm::SMLoc());
   SourceMgrDiagnosticHandler sourceMgrHandler(sourceMgr, &context);
 
-  // Nothing in the parser is threaded.  Disable synchronization overhead.
-  context.disableMultithreading();
+  // Nothing in the parser is threaded, unless the modules of a .fir file are
+  // parsed in parallel.  Disable synchronization overhead otherwise.  A cache
+  // loads its modules in parallel.
+  if (numThreads == 1 || inputFormat == InputMLIRFile ||
+      (inputFormat == InputFIRFile && !parseModulesInParallel))
+    context.disableMultithreading();
+
+  if (mappedInput)
+    mappedInput->adviseSequential();
+
+  // Once the input is parsed the IR holds no references into it, all strings
+  // were copied into the context.
+  auto doneParsing = [&] {
+    if (mappedInput)
+      mappedInput->adviseDoneParsing(releaseInputAfterParse);
+  };
 
   OwningModuleRef module;
   if (inputFormat == InputFIRFile) {
     FIRParserOptions options;
     options.ignoreInfoLocators = ignoreFIRLocations;
+    options.parseModulesInParallel = parseModulesInParallel;
+    options.dropFIRLocations = dropFIRLocations;
+
+    // In streaming mode the output is produced by the parser callback, and
+    // the parsed circuit only holds the ports of the modules.
+    if (streamModules) {
+      ModuleStreamer streamer(context, os);
+      options.moduleCallback = [&](Operation *op) {
+        return streamer.processModule(op);
+      };
+      module = parseFIRFile(sourceMgr, &context, options);
+      if (!module)
+        return failure();
+      doneParsing();
+      return success();
+    }
+
     module = parseFIRFile(sourceMgr, &context, options);
+  } else if (inputFormat == InputFIRRTLCache) {
+    // In streaming mode the module bodies are loaded one at a time, in the
+    // order of the cache, such that modules are defined before they are
+    // instantiated just like in a .fir file.
+    if (streamModules) {
+      FIRRTLCacheReader reader(
+          *sourceMgr.getMemoryBuffer(sourceMgr.getMainFileID()), &context);
+      module = reader.loadModuleShells();
+      if (!module)
+        return failure();
+      ModuleStreamer streamer(context, os);
+      for (auto circuit : module->getBody()->getOps<firrtl::CircuitOp>())
+        for (auto &op : llvm::make_early_inc_range(*circuit.getBody()))
+          if (isa<firrtl::FModuleOp, firrtl::FExtModuleOp>(op))
+            if (failed(reader.loadModuleBody(&op)) ||
+                failed(streamer.processModule(&op)))
+              return failure();
+      doneParsing();
+      return success();
+    }
+
+    module = readFIRRTLCache(sourceMgr, &context);
   } else {
     assert(inputFormat == InputMLIRFile);
     module = parseSourceFile(sourceMgr, &context);
   }
   if (!module)
     return failure();
+  doneParsing();
 
   // Allow optimizations to run multithreaded.
-  context.disableMultithreading(false);
+  context.disableMultithreading(numThreads == 1);
+
+  // Reuse the modules that did not change since the previous run.
+  std::unique_ptr<IncrementalCache> cache;
+  if (!incrementalCache.empty()) {
+    cache = std::make_unique<IncrementalCache>(incrementalCache);
+    if (failed(cache->loadModules(module.get())))
+      return failure();
+  }
 
   // If enabled, run the optimizer.
   if (!disableOptimization) {
-    // Apply any pass manager command line options.
     PassManager pm(&context, /*verifyPasses:*/ true);
-    applyPassManagerCLOptions(pm);
-
-    pm.addPass(createCSEPass());
-    pm.addPass(createCanonicalizerPass());
-
-    // Run the lower-to-rtl pass if requested.
-    if (lowerToRTL) {
-      OpPassManager &nestedPM = pm.nest<firrtl::CircuitOp>();
-      nestedPM.addPass(firrtl::createLowerFIRRTLToRTLPass());
-    }
-
+    buildPassPipeline(pm);
     if (failed(pm.run(module.get())))
       return failure();
   }
@@ -126,7 +787,14 @@ processBuffer(std::unique_ptr<llvm::MemoryBuffer> ownedBuffer,
   case OutputDisabled:
     return success();
   case OutputVerilog:
-    return emitVerilog(module.get(), os);
+    if (cache)
+      return cache->emitVerilog(module.get(), os);
+    return emitVerilog(module.get(), os, getVerilogEmitterOptions());
+  case OutputSplitVerilog:
+    return emitSplitVerilog(module.get(), outputFilename,
+                            getVerilogEmitterOptions());
+  case OutputFIRRTLCache:
+    return writeFIRRTLCache(module.get(), os);
   }
 };
 
@@ -137,37 +805,107 @@ int main(int argc, char **argv) {
   registerMLIRContextCLOptions();
   registerPassManagerCLOptions();
 
+  // Register printer command line options.
+  registerAsmPrinterCLOptions();
+
   // Parse pass names in main to ensure static initialization completed.
   cl::ParseCommandLineOptions(argc, argv, "circt modular optimizer driver\n");
 
+  // Limit the threads used by parallel algorithms, which is what the pass
+  // manager and the parsers use to process modules concurrently.
+  if (numThreads)
+    llvm::parallel::strategy = llvm::hardware_concurrency(numThreads);
+
   // Figure out the input format if unspecified.
   if (inputFormat == InputUnspecified) {
     if (StringRef(inputFilename).endswith(".fir"))
       inputFormat = InputFIRFile;
     else if (StringRef(inputFilename).endswith(".mlir"))
       inputFormat = InputMLIRFile;
+    else if (StringRef(inputFilename).endswith(".firb"))
+      inputFormat = InputFIRRTLCache;
     else {
       llvm::errs() << "unknown input format: "
-                      "specify with -format=fir or -format=mlir\n";
+                      "specify with -format=fir, -format=mlir or "
+                      "-format=firb\n";
       exit(1);
     }
   }
 
-  // Set up the input file.
+  if (streamModules &&
+      (inputFormat == InputMLIRFile ||
+       (outputFormat != OutputVerilog && outputFormat != OutputDisabled))) {
+    llvm::errs() << "-stream-modules requires a .fir or .firb input and "
+                    "-verilog or -disable-output\n";
+    exit(1);
+  }
+
+  if (outputFormat == OutputSplitVerilog && outputFilename == "-") {
+    llvm::errs() << "-split-verilog requires an output directory, specify "
+                    "with -o\n";
+    exit(1);
+  }
+
+  if (!incrementalCache.empty() &&
+      (streamModules || outputFormat != OutputVerilog)) {
+    llvm::errs() << "-incremental-cache requires -verilog and does not "
+                    "support -stream-modules\n";
+    exit(1);
+  }
+
+  // The output is compressed if its name asks for it, unless it names the
+  // directory of split Verilog.
+  auto compression = OutputSink::Compression::None;
+  StringRef outputExtension = outputFormat == OutputSplitVerilog
+                                  ? StringRef()
+                                  : sys::path::extension(outputFilename);
+  if (outputExtension == ".gz") {
+    if (!zlib::isAvailable()) {
+      llvm::errs() << "gzip output requires LLVM to be built with zlib\n";
+      exit(1);
+    }
+    compression = OutputSink::Compression::Gzip;
+  } else if (outputExtension == ".zst") {
+    llvm::errs() << "zstd output is not supported, use a .gz output file\n";
+    exit(1);
+  }
+
+  // Set up the input file.  Files are mapped into memory where possible, and
+  // everything else, e.g. standard input, is read into memory.
   std::string errorMessage;
-  auto input = openInputFile(inputFilename, &errorMessage);
+  std::unique_ptr<llvm::MemoryBuffer> input;
+  MappedInputBuffer *mappedInput = nullptr;
+  if (inputFilename != "-") {
+    auto mapped = MappedInputBuffer::create(inputFilename);
+    mappedInput = mapped.get();
+    input = std::move(mapped);
+  }
+  if (!input) {
+    LLVM_DEBUG(llvm::dbgs() << "reading input file '" << inputFilename
+                            << "' into memory\n");
+    input = openInputFile(inputFilename, &errorMessage);
+  }
   if (!input) {
     llvm::errs() << errorMessage << "\n";
     return 1;
   }
 
+  // In split mode the output names a directory, which the emitter fills.
+  if (outputFormat == OutputSplitVerilog) {
+    if (failed(processBuffer(std::move(input), mappedInput, llvm::nulls())))
+      return 1;
+    return 0;
+  }
+
   auto output = openOutputFile(outputFilename, &errorMessage);
   if (!output) {
     llvm::errs() << errorMessage << "\n";
     return 1;
   }
 
-  if (failed(processBuffer(std::move(input), output->os())))
+  OutputSink sink(output->os(), compression);
+  auto result = processBuffer(std::move(input), mappedInput, sink);
+  if (failed(sink.finish()) || failed(result))
     return 1;
 
   output->keep();
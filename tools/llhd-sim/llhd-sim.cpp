@@ -45,6 +45,13 @@ static cl::opt<bool> dumpMLIR("dump-mlir",
 static cl::opt<bool> dumpLayout("dump-layout",
                                 cl::desc("Dump the gathered instance layout"));
 
+static cl::opt<uint64_t> sparseThreshold(
+    "sparse-threshold",
+    cl::desc("Store array signals of at least this many bytes sparsely, with "
+             "per-element traces instead of full values (0, the default, "
+             "disables sparse storage)"),
+    cl::value_desc("bytes"), cl::init(0));
+
 static cl::opt<std::string> root(
     "root",
     cl::desc("Specify the name of the entity to use as root of the design"),
@@ -115,7 +122,8 @@ int main(int argc, char **argv) {
     return 0;
   }
 
-  llhd::sim::Engine engine(output->os(), *module, context, root);
+  llhd::sim::Engine engine(output->os(), *module, context, root,
+                           sparseThreshold);
 
   if (dumpLLVMDialect || dumpLLVMIR) {
     return dumpLLVM(engine.getModule(), context);